@@ -0,0 +1,83 @@
+/*
+Board traits
+
+Compile-time description of the board the firmware is built for. It is
+picked by the IDF target of the PlatformIO environment (sdkconfig's
+CONFIG_IDF_TARGET_*), so each env in platformio.ini gets its own traits
+without extra flags. Code reads Board::X; everything is constexpr, so
+unused branches fold away.
+
+  LED_01/LED_02/PUSH_01/PUSH_02  pins (defaults of the fixed config entries)
+  LIGHT_WARM/LIGHT_COOL          lamp PWM outputs (include/light.h)
+  MAX_GPIO                       highest usable GPIO number
+  CORES                          1 on ESP32-C3
+  LEDC_CHANNELS                  PWM channels
+  LEDC_MAX_BITS                  widest LEDC duty resolution
+  RTC_SLOW_BYTES                 RTC slow memory (RTC_NOINIT_ATTR / RTC_DATA_ATTR)
+
+Pins of the C3 and S3 boards are the next bulb revision's (ModuLux rev B
+on ESP32-C3-DevKitM-1 and ESP32-S3-DevKitC-1), chosen away from strapping,
+flash and USB pins.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct BoardEsp32Devkit {
+  static constexpr const char *NAME = "esp32doit-devkit-v1";
+  static constexpr uint8_t LED_01 = 22;
+  static constexpr uint8_t LED_02 = 23;
+  static constexpr uint8_t PUSH_01 = 19;
+  static constexpr uint8_t PUSH_02 = 18;
+  static constexpr uint8_t LIGHT_WARM = 25;
+  static constexpr uint8_t LIGHT_COOL = 26;
+  static constexpr uint8_t MAX_GPIO = 39;
+  static constexpr uint8_t CORES = 2;
+  static constexpr uint8_t LEDC_CHANNELS = 16;
+  static constexpr uint8_t LEDC_MAX_BITS = 20;
+  static constexpr uint16_t RTC_SLOW_BYTES = 8192;
+};
+
+struct BoardEsp32C3 {
+  static constexpr const char *NAME = "esp32-c3-devkitm-1";
+  static constexpr uint8_t LED_01 = 4;
+  static constexpr uint8_t LED_02 = 5;
+  static constexpr uint8_t PUSH_01 = 6;
+  static constexpr uint8_t PUSH_02 = 7;
+  static constexpr uint8_t LIGHT_WARM = 3;
+  static constexpr uint8_t LIGHT_COOL = 10;
+  static constexpr uint8_t MAX_GPIO = 21;
+  static constexpr uint8_t CORES = 1;
+  static constexpr uint8_t LEDC_CHANNELS = 6;
+  static constexpr uint8_t LEDC_MAX_BITS = 14;
+  static constexpr uint16_t RTC_SLOW_BYTES = 8192;
+};
+
+struct BoardEsp32S3 {
+  static constexpr const char *NAME = "esp32-s3-devkitc-1";
+  static constexpr uint8_t LED_01 = 10;
+  static constexpr uint8_t LED_02 = 11;
+  static constexpr uint8_t PUSH_01 = 12;
+  static constexpr uint8_t PUSH_02 = 13;
+  static constexpr uint8_t LIGHT_WARM = 14;
+  static constexpr uint8_t LIGHT_COOL = 21;
+  static constexpr uint8_t MAX_GPIO = 48;
+  static constexpr uint8_t CORES = 2;
+  static constexpr uint8_t LEDC_CHANNELS = 8;
+  static constexpr uint8_t LEDC_MAX_BITS = 14;
+  static constexpr uint16_t RTC_SLOW_BYTES = 8192;
+};
+
+#if defined(CONFIG_IDF_TARGET_ESP32C3)
+typedef BoardEsp32C3 Board;
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+typedef BoardEsp32S3 Board;
+#else
+typedef BoardEsp32Devkit Board;
+#endif
+
+static_assert(Board::LED_01 <= Board::MAX_GPIO && Board::LED_02 <= Board::MAX_GPIO &&
+              Board::PUSH_01 <= Board::MAX_GPIO && Board::PUSH_02 <= Board::MAX_GPIO &&
+              Board::LIGHT_WARM <= Board::MAX_GPIO && Board::LIGHT_COOL <= Board::MAX_GPIO,
+              "board pin outside the chip's GPIO range");
@@ -0,0 +1,59 @@
+/*
+Captive DNS for the setup portal
+
+Answers every A query with the portal's address, so whatever a phone
+looks up (its connectivity check first) lands on the setup page. Replaces
+the core's DNSServer, so the parsing of what any client on the softAP
+sends is the repo's own and fuzzed.
+
+captiveDnsReply() is the whole protocol: one query datagram in, one reply
+out, no I/O, so test/fuzz/fuzz_dns.cpp runs it as is. It reads only inside
+the query and writes only inside the reply buffer, which may be the query
+buffer itself:
+
+  query                              reply
+  shorter than a header, a response  none (dropped)
+  opcode other than QUERY            header only, NOTIMP
+  not exactly one question; a name   header only, FORMERR
+  with a compression pointer, over
+  the RFC 1035 limits or cut short
+  A or ANY, class IN                 the question and one A record
+                                     (TTL CAPTIVE_DNS_TTL_S)
+  any other type (AAAA, HTTPS, ...)  the question, no records: the phone
+                                     falls back to A
+
+Additional records (EDNS) are never copied. CaptiveDns serves the port
+over WiFiUDP, up to CAPTIVE_DNS_BURST queries per processNextRequest():
+a phone asks A and AAAA for several names at once.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#ifndef CAPTIVE_DNS_TTL_S
+#define CAPTIVE_DNS_TTL_S 60
+#endif
+#ifndef CAPTIVE_DNS_BURST
+#define CAPTIVE_DNS_BURST 4
+#endif
+
+const size_t DNS_HEADER_LEN = 12;
+const size_t DNS_MAX_DATAGRAM = 512; // plain DNS over UDP, no EDNS
+
+// Reply to one query in reply[0..cap); returns its length, 0 = send nothing
+size_t captiveDnsReply(const uint8_t *query, size_t len, const uint8_t ip[4], uint8_t *reply, size_t cap);
+
+class CaptiveDns {
+public:
+  bool start(uint16_t port, const IPAddress &ip);
+  void stop();
+  void processNextRequest();
+
+private:
+  WiFiUDP udp;
+  uint8_t ip[4];
+  bool running = false;
+  uint8_t buf[DNS_MAX_DATAGRAM];
+};
@@ -0,0 +1,93 @@
+/*
+Input coalescing
+
+A slider dragged in an app sends 50-100 commands per second. Applying each
+one as it arrives redoes the output work every time and shows up as
+visible steps. Network handlers therefore only submit() a target per
+attribute. Once per output frame, flush() hands over the latest target of
+each attribute that changed and drops the ones it superseded. The output
+stage then fades to the new targets over one frame.
+
+  Coalescer<LAMP_ATTR_COUNT> input;
+  handler:  input.submit(ATTR_BRIGHTNESS, v);
+  loop():   if (frame due) input.flush([](uint8_t a, uint16_t v) { ... });
+
+The added latency of an applied value is its arrival to the flush that
+applies it, so at most one frame. Stats count commands received vs
+attribute updates applied.
+
+Not thread-safe: submit() and flush() both run on the loop task (HTTP
+handlers run from loop()).
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct CoalescerStats {
+  uint32_t received;
+  uint32_t applied;
+  uint32_t frames;       // flushes that applied something
+  uint32_t latencyAvgUs; // arrival of the applied value -> flush
+  uint32_t latencyMaxUs;
+};
+
+template <size_t N>
+class Coalescer {
+public:
+  void submit(uint8_t attr, uint16_t value) {
+    if (attr >= N) return;
+    slots[attr].value = value;
+    slots[attr].atUs = micros();
+    pendingMask |= 1UL << attr;
+    received++;
+  }
+
+  bool pending() const { return pendingMask != 0; }
+
+  // fn(attr, value) for each attribute with a new target, lowest attr first
+  template <typename Fn>
+  uint8_t flush(Fn fn) {
+    if (pendingMask == 0) return 0;
+    uint32_t now = micros();
+    uint32_t mask = pendingMask;
+    pendingMask = 0;
+    uint8_t n = 0;
+    for (uint8_t a = 0; a < N; ++a) {
+      if (!(mask & (1UL << a))) continue;
+      uint32_t lat = now - slots[a].atUs;
+      latencyTotalUs += lat;
+      if (lat > latencyMaxUs) latencyMaxUs = lat;
+      fn(a, slots[a].value);
+      n++;
+    }
+    applied += n;
+    frames++;
+    return n;
+  }
+
+  CoalescerStats stats() const {
+    CoalescerStats s;
+    s.received = received;
+    s.applied = applied;
+    s.frames = frames;
+    s.latencyAvgUs = applied ? (uint32_t)(latencyTotalUs / applied) : 0;
+    s.latencyMaxUs = latencyMaxUs;
+    return s;
+  }
+
+private:
+  static_assert(N <= 32, "pendingMask holds one bit per attribute");
+
+  struct Slot {
+    uint16_t value;
+    uint32_t atUs; // arrival of value
+  };
+  Slot slots[N] = {};
+  uint32_t pendingMask = 0;
+  uint32_t received = 0;
+  uint32_t applied = 0;
+  uint32_t frames = 0;
+  uint64_t latencyTotalUs = 0;
+  uint32_t latencyMaxUs = 0;
+};
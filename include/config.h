@@ -0,0 +1,116 @@
+/*
+Typed configuration registry
+
+Every tunable is one line of CONFIG_SETTINGS: its name, NVS key, C type,
+compile-time default, allowed range, and whether it may be overridden at
+run time. That one line produces:
+
+  Cfg::NAME                 the setting's id
+  cfg<Cfg::NAME>()          its current value, as its own type
+  cfgDefault<Cfg::NAME>()   its default, constexpr
+
+cfg<K>() indexes a fixed array with a constant, so it compiles to one load
+from a fixed address. A fixed (non-overridable) setting folds to an
+immediate. Defaults are range-checked and type-checked by static_assert.
+
+Overrides are stored in NVS (namespace "cfg", key = the NVS key). They
+are applied by configBegin() at boot and by configSet() at run time; the
+latter is reached through the authenticated POST /config. Pins are fixed:
+a wrong pin can drive the flash bus or a strapping pin, so pins change
+only by reflashing. Their defaults come from include/board.h.
+
+The i_*_ma settings are the energy model's current per radio mode (see
+include/energy.h), averaged over the mode; calibrate them per board.
+
+Name lookup for HTTP (configFind) is a linear scan over CFG_COUNT entries.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <limits>
+
+#include "board.h"
+
+// name, NVS key (<= 15 chars), type, default, min, max, overridable
+#define CONFIG_SETTINGS(X)                                                              \
+  X(MAX_RETRIES,          "max_retries",     uint8_t,  5,      1,     20,       true)   \
+  X(CONNECT_TIMEOUT_MS,   "connect_ms",      uint32_t, 10000,  2000,  60000,    true)   \
+  X(AP_IDLE_TIMEOUT_MS,   "ap_idle_ms",      uint32_t, 600000, 60000, 86400000, true)   \
+  X(AP_SHUTDOWN_DELAY_MS, "ap_shutdown_ms",  uint32_t, 40000,  0,     600000,   true)   \
+  X(FACTORY_HOLD_MS,      "factory_hold_ms", uint32_t, 10000,  3000,  60000,    true)   \
+  X(BLINK_CONNECT_MS,     "blink_conn_ms",   uint16_t, 200,    50,    2000,     true)   \
+  X(BLINK_ON_MS,          "blink_on_ms",     uint16_t, 200,    50,    2000,     true)   \
+  X(BLINK_OFF_MS,         "blink_off_ms",    uint16_t, 200,    50,    2000,     true)   \
+  X(BLINK_PAUSE_MS,       "blink_pause_ms",  uint16_t, 1200,   100,   10000,    true)   \
+  X(I_BASE_MA,            "i_base_ma",       uint16_t, 40,     1,     1000,     true)   \
+  X(I_STA_MA,             "i_sta_ma",        uint16_t, 100,    1,     1000,     true)   \
+  X(I_STA_SLEEP_MA,       "i_sta_sleep_ma",  uint16_t, 30,     1,     1000,     true)   \
+  X(I_AP_MA,              "i_ap_ma",         uint16_t, 120,    1,     1000,     true)   \
+  X(I_AP_STA_MA,          "i_ap_sta_ma",     uint16_t, 130,    1,     1000,     true)   \
+  X(I_SCAN_MA,            "i_scan_ma",       uint16_t, 115,    1,     1000,     true)   \
+  X(SUPPLY_MV,            "supply_mv",       uint16_t, 3300,   1800,  24000,    true)   \
+  X(PIN_LED_01,           "pin_led_01",      uint8_t,  Board::LED_01,  0, Board::MAX_GPIO, false) \
+  X(PIN_LED_02,           "pin_led_02",      uint8_t,  Board::LED_02,  0, Board::MAX_GPIO, false) \
+  X(PIN_PUSH_01,          "pin_push_01",     uint8_t,  Board::PUSH_01, 0, Board::MAX_GPIO, false) \
+  X(PIN_PUSH_02,          "pin_push_02",     uint8_t,  Board::PUSH_02, 0, Board::MAX_GPIO, false) \
+  X(PIN_LIGHT_WARM,       "pin_light_warm",  uint8_t,  Board::LIGHT_WARM, 0, Board::MAX_GPIO, false) \
+  X(PIN_LIGHT_COOL,       "pin_light_cool",  uint8_t,  Board::LIGHT_COOL, 0, Board::MAX_GPIO, false)
+
+#define CFG_ENUM_(name, key, type, def, lo, hi, ovr) name,
+enum class Cfg : uint8_t { CONFIG_SETTINGS(CFG_ENUM_) COUNT };
+#undef CFG_ENUM_
+
+const size_t CFG_COUNT = (size_t)Cfg::COUNT;
+
+struct CfgSpec {
+  const char *key;
+  uint32_t def;
+  uint32_t min;
+  uint32_t max;
+  bool overridable;
+};
+
+#define CFG_SPEC_(name, key, type, def, lo, hi, ovr) {key, def, lo, hi, ovr},
+constexpr CfgSpec CFG_SPECS[CFG_COUNT] = { CONFIG_SETTINGS(CFG_SPEC_) };
+#undef CFG_SPEC_
+
+template <Cfg K> struct CfgType;
+#define CFG_TYPE_(name, key, type, def, lo, hi, ovr)                                          \
+  template <> struct CfgType<Cfg::name> { typedef type T; };                                 \
+  static_assert((def) >= (lo) && (def) <= (hi), "config " #name ": default out of range");   \
+  static_assert((hi) <= std::numeric_limits<type>::max(), "config " #name ": max does not fit its type"); \
+  static_assert(sizeof(key) <= 16, "config " #name ": NVS key longer than 15 chars");
+CONFIG_SETTINGS(CFG_TYPE_)
+#undef CFG_TYPE_
+
+// Current values, indexed by Cfg; written only by configBegin()/configSet()
+extern uint32_t cfgValues[CFG_COUNT];
+
+template <Cfg K>
+constexpr typename CfgType<K>::T cfgDefault() {
+  return (typename CfgType<K>::T)CFG_SPECS[(size_t)K].def;
+}
+
+template <Cfg K>
+inline typename CfgType<K>::T cfg() {
+  return CFG_SPECS[(size_t)K].overridable ? (typename CfgType<K>::T)cfgValues[(size_t)K] : cfgDefault<K>();
+}
+
+// Load NVS overrides (out-of-range or stale ones are dropped); call once in setup()
+void configBegin();
+// Index of the setting with this NVS key, or -1
+int configFind(const char *key);
+// Validate, apply and persist; nullptr on success, else a message for the client
+const char* configSet(size_t i, uint32_t value);
+// Back to the default and drop the NVS override
+void configReset(size_t i);
+// Drop every override (factory reset)
+void configClear();
+bool configIsOverridden(size_t i);
+// {"key":{"value":..,"default":..,"min":..,"max":..,"fixed":bool},...}
+String configJson();
+// True if the Authorization header carries the device's config token
+bool configAuthorized(const String &authorization);
+// The token, generated by the first configBegin() (before the radio is up) and kept in NVS
+const String& configToken();
@@ -0,0 +1,127 @@
+/*
+Cooperative coroutines on the main loop
+
+Protothread-style stackless coroutines. Use these for flows that read as
+sequential code but must not block loop(). A coroutine is a step function
+plus a statically allocated frame. The frame holds the resume point and
+every value that has to survive an await. Each step runs up to the next
+await and returns, so loop() keeps servicing LEDs, DNS and HTTP between
+steps.
+
+  struct BlinkFrame : CoroFrame { uint8_t i; };
+  BlinkFrame blink;
+
+  bool blinkStep(BlinkFrame &f) {
+    CORO_BEGIN(f);
+    for (f.i = 0; f.i < 3; ++f.i) {
+      digitalWrite(LED_01, HIGH);
+      CORO_SLEEP(f, 200);
+      digitalWrite(LED_01, LOW);
+      CORO_SLEEP(f, 200);
+    }
+    CORO_END(f);
+  }
+
+  coroStart(blink);              // once
+  coroRun(blink, blinkStep);     // every loop(); false once finished
+
+Awaitables:
+  CORO_AWAIT(f, cond)                      until cond holds (re-checked every step)
+  CORO_SLEEP(f, ms)                        until ms have passed
+  CORO_AWAIT_EVENT(f, mask, deadline)      until coroPost() sets a bit in mask, or
+                                           millis() reaches deadline; f.events holds
+                                           the bits taken (0 = timed out)
+  CORO_YIELD(f)                            one loop() pass
+
+Rules that come with the switch/__LINE__ implementation:
+  - function locals do not survive an await; keep state in the frame
+  - no local with an initializer may be in scope across an await
+  - at most one await per source line, and no switch statement around one
+
+C++20 co_await would hide all of this but needs GCC 10; the arduino-esp32
+toolchain is GCC 8.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct CoroFrame {
+  uint16_t resume = 0;      // __LINE__ of the await to continue at, 0 = top
+  bool running = false;
+  uint32_t events = 0;      // set by CORO_AWAIT_EVENT
+  unsigned long wakeAt = 0; // deadline of the current sleep / event wait
+
+  // Step cost, measured by coroRun()
+  uint32_t steps = 0;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+};
+
+// Post event bits; callable from any task (e.g. the Wi-Fi event task).
+// Bits stay latched until a CORO_AWAIT_EVENT or coroTakeEvents() takes them.
+void coroPost(uint32_t bits);
+// Clear and return the posted bits in mask
+uint32_t coroTakeEvents(uint32_t mask);
+
+inline void coroStart(CoroFrame &f) {
+  f.resume = 0;
+  f.running = true;
+}
+
+inline void coroStop(CoroFrame &f) {
+  f.resume = 0;
+  f.running = false;
+}
+
+// One step of f; returns false once it has finished (or was never started)
+template <typename Frame>
+bool coroRun(Frame &f, bool (*step)(Frame &)) {
+  if (!f.running) return false;
+  uint32_t t0 = ESP.getCycleCount();
+  bool more = step(f);
+  uint32_t dt = ESP.getCycleCount() - t0;
+  f.steps++;
+  f.totalCycles += dt;
+  if (dt > f.maxCycles) f.maxCycles = dt;
+  if (!more) f.running = false;
+  return more;
+}
+
+inline uint32_t coroCyclesToNs(uint64_t cycles) {
+  return (uint32_t)(cycles * 1000ULL / ESP.getCpuFreqMHz());
+}
+
+#define CORO_BEGIN(f) switch ((f).resume) { case 0:
+
+#define CORO_END(f) } (f).resume = 0; return false
+
+#define CORO_EXIT(f) do { (f).resume = 0; return false; } while (0)
+
+#define CORO_AWAIT(f, cond)                     \
+  do {                                          \
+    (f).resume = __LINE__;                      \
+    __attribute__((fallthrough));               \
+    case __LINE__:                              \
+    if (!(cond)) return true;                   \
+  } while (0)
+
+#define CORO_YIELD(f)                           \
+  do {                                          \
+    (f).resume = __LINE__;                      \
+    return true;                                \
+    case __LINE__:;                             \
+  } while (0)
+
+#define CORO_SLEEP(f, ms)                                         \
+  do {                                                            \
+    (f).wakeAt = millis() + (ms);                                 \
+    CORO_AWAIT(f, (long)(millis() - (f).wakeAt) >= 0);            \
+  } while (0)
+
+#define CORO_AWAIT_EVENT(f, mask, deadline)                                       \
+  do {                                                                            \
+    (f).wakeAt = (deadline);                                                      \
+    CORO_AWAIT(f, ((f).events = coroTakeEvents(mask)) != 0 ||                     \
+                  (long)(millis() - (f).wakeAt) >= 0);                            \
+  } while (0)
@@ -0,0 +1,57 @@
+/*
+Energy accounting
+
+Integrates time spent per RunState and per radio mode, and turns it into
+an energy estimate with the per-mode current model in the config
+registry (i_*_ma at supply_mv):
+
+  OFF        radio off, CPU running        i_base_ma
+  STA        station, radio listening      i_sta_ma
+  STA_SLEEP  station connected, modem sleep (DTIM wakeups)  i_sta_sleep_ma
+  AP         softAP only                   i_ap_ma
+  AP_STA     softAP + station              i_ap_sta_ma
+  SCAN       a portal scan owns the radio  i_scan_ma
+
+loop() calls energyTick() with the current state and mode. Each tick
+charges the time since the previous one to that state and mode, so the
+totals add up to uptime; the model is only as fine as the loop period.
+Time before energyBegin() is charged to the first tick.
+
+Totals live in RTC memory (magic + checksum), so they survive software
+resets, watchdog resets and deep sleep, but not a power cycle. The
+firmware does not use light sleep yet, so it has no mode of its own.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+enum class RadioMode : uint8_t { OFF, STA, STA_SLEEP, AP, AP_STA, SCAN, COUNT };
+
+const size_t RADIO_MODE_COUNT = (size_t)RadioMode::COUNT;
+const size_t ENERGY_RUN_SLOTS = 4; // RunState values accounted; larger ones go to the last slot
+
+struct EnergyTotals {
+  uint32_t boots;                      // boots counted since the record was (re)created
+  uint64_t runMs[ENERGY_RUN_SLOTS];
+  uint64_t radioMs[RADIO_MODE_COUNT];
+  uint64_t nJ;                         // mA * ms * mV
+};
+
+// Validate or reset the RTC record and count this boot; call once in setup()
+void energyBegin();
+void energyTick(uint8_t runState, RadioMode radio);
+
+// Since the record was created, and since this boot
+EnergyTotals energyTotal();
+EnergyTotals energySinceBoot();
+// Model current for a mode, from the config registry
+uint16_t energyCurrentMa(RadioMode radio);
+
+const char* radioModeName(RadioMode m);
+
+inline double energyMwh(uint64_t nJ) { return nJ / 3.6e9; }
+
+// {"supply_mv":..,"boots":..,"boot":{"ms":..,"mwh":..},"total":{..},"run_ms":{..},"radio_ms":{..}}
+// run_ms and radio_ms are totals; runName names the first runStates RunState slots
+String energyJson(const char *(*runName)(uint8_t), uint8_t runStates);
@@ -0,0 +1,140 @@
+/*
+Event bus between the Wi-Fi event task, ISRs and the main loop
+
+Producers on any task or in interrupt context call eventPost(). The event
+goes into a bounded lock-free MPSC ring (Vyukov-style per-slot sequence
+numbers), so a producer never waits on a lock or on another producer. An
+ISR that preempts a half-finished push just claims the next slot. The main
+loop is the only consumer: eventDrain<Subscribers>() pops everything
+pending and hands each event to every handler in a compile-time list.
+
+  typedef EventHandlers<connectionOnEvent, ledOnEvent> Subscribers;
+  loop(): eventDrain<Subscribers>();
+
+Shared state therefore changes on the loop task only; other tasks just
+describe what happened. When the ring is full, new events are dropped and
+counted (eventStats()), never blocked on.
+
+The ESP32-C3 (RV32IMC) has no atomic instructions; there the __atomic
+builtins are IDF helpers that mask interrupts for a few cycles. That is
+still safe from an ISR and on one core still never waits.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef EVENT_QUEUE_LEN
+#define EVENT_QUEUE_LEN 32 // power of two
+#endif
+
+enum class EventType : uint8_t {
+  STA_GOT_IP,       // Wi-Fi task
+  STA_DISCONNECTED, // Wi-Fi task; code = WIFI_REASON_*
+  AP_CLIENT_JOINED, // Wi-Fi task; a phone joined the softAP
+  BUTTON,           // GPIO ISR; code = pin, level = pin level (LOW = pressed)
+  RUN_STATE,        // loop; code = new RunState
+  COUNT
+};
+
+struct Event {
+  EventType type;
+  uint8_t code;
+  uint8_t level;
+  uint32_t atMs; // millis() when posted
+};
+
+// Bounded multi-producer / single-consumer ring, no locks, no allocation
+template <typename T, uint16_t N>
+class MpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+  MpscRing() : head(0), tail(0), dropped(0) {
+    for (uint16_t i = 0; i < N; ++i) cells[i].seq = i;
+  }
+
+  // Any task or ISR. False (and counted) when full.
+  inline __attribute__((always_inline)) bool push(const T &v) {
+    uint32_t pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+    for (;;) {
+      Cell &c = cells[pos & (N - 1)];
+      uint32_t seq = __atomic_load_n(&c.seq, __ATOMIC_ACQUIRE);
+      int32_t diff = (int32_t)(seq - pos);
+      if (diff == 0) {
+        // slot free at our position: claim it; on failure pos is reloaded
+        if (__atomic_compare_exchange_n(&tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          c.value = v;
+          __atomic_store_n(&c.seq, pos + 1, __ATOMIC_RELEASE);
+          return true;
+        }
+      } else if (diff < 0) {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        return false;
+      } else {
+        pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  // Consumer only. False when empty or the next slot is still being written.
+  bool pop(T &out) {
+    Cell &c = cells[head & (N - 1)];
+    uint32_t seq = __atomic_load_n(&c.seq, __ATOMIC_ACQUIRE);
+    if ((int32_t)(seq - (head + 1)) < 0) return false;
+    out = c.value;
+    __atomic_store_n(&c.seq, head + N, __ATOMIC_RELEASE);
+    head++;
+    return true;
+  }
+
+  // Consumer only; claimed slots, including ones not yet published
+  uint16_t depth() const { return (uint16_t)(__atomic_load_n(&tail, __ATOMIC_RELAXED) - head); }
+  uint32_t droppedCount() const { return __atomic_load_n(&dropped, __ATOMIC_RELAXED); }
+
+private:
+  struct Cell {
+    uint32_t seq;
+    T value;
+  };
+
+  Cell cells[N];
+  uint32_t head; // consumer
+  uint32_t tail; // producers
+  uint32_t dropped;
+};
+
+typedef void (*EventHandler)(const Event &e);
+
+// Compile-time subscriber list: dispatch() calls each handler in order
+template <EventHandler... Handlers>
+struct EventHandlers {
+  static void dispatch(const Event &e) {
+    int expand[] = {0, (Handlers(e), 0)...};
+    (void)expand;
+  }
+};
+
+struct EventStats {
+  uint32_t posted;
+  uint32_t dropped;
+  uint16_t maxDepth; // deepest backlog seen by eventDrain()
+};
+
+// Any task or ISR (lives in IRAM). False if the ring was full.
+bool eventPost(EventType type, uint8_t code = 0, uint8_t level = 0);
+
+// Consumer side, main loop only
+bool eventPop(Event &e);
+uint16_t eventDepth();
+EventStats eventStats();
+
+template <typename Subscribers>
+void eventDrain() {
+  eventDepth(); // records the backlog for eventStats()
+  Event e;
+  // bounded, so a storm of events cannot starve the rest of loop()
+  for (uint16_t n = 0; n < EVENT_QUEUE_LEN && eventPop(e); ++n) {
+    Subscribers::dispatch(e);
+  }
+}
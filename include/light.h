@@ -0,0 +1,84 @@
+/*
+Lamp output stage
+
+Two LEDC PWM channels, warm and cool white, on the board's LIGHT_WARM and
+LIGHT_COOL pins. Levels are 0..65535 and perceptually spaced: the duty is
+level^2 scaled to the PWM resolution, so equal level steps look like
+equal brightness steps.
+
+lightSet() starts a linear fade from the current output to the target.
+With fadeMs = 0 the duty is written before it returns. loop() calls
+lightService() to advance a running fade; it writes the PWM only when the
+duty changes.
+
+LampState is the lamp as apps see it: power, brightness and the warm/cool
+mix (0 = warm only, 65535 = cool only). Mid-mix both channels run at the
+brightness; off the middle, one channel is dimmed. lampFromLevels() is the
+inverse (up to rounding), so a scene's levels map back to attributes.
+
+The lamp state and the output are shared by loop() and the local control
+task (include/local_control.h). Every function takes a FreeRTOS mutex
+(priority inheritance), held for a few microseconds; none is ISR-safe.
+
+Power-on restore: every change is copied to RTC memory at once and to NVS
+(namespace "lamp") once the lamp has been left alone for 5 s, so a slider
+drag costs one flash write. lightRestore(), the first thing setup() does,
+takes the RTC copy after a soft reset (watchdog, OTA, panic) and puts the
+lamp back exactly as it was. After a power cycle it takes the NVS copy,
+switched on, since the power coming back means the wall switch went on.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct LightLevels {
+  uint16_t warm;
+  uint16_t cool;
+};
+
+struct LampState {
+  bool on;
+  uint16_t brightness;
+  uint16_t mix;
+};
+
+LightLevels lampLevels(const LampState &s);
+LampState lampFromLevels(LightLevels l);
+
+// Set up LEDC and drive both channels off; call once, early in setup(), before anything else here
+void lightBegin();
+void lightSet(LightLevels target, uint16_t fadeMs);
+void lightService();
+
+// What the fade is heading to, and what is on the pins now
+LightLevels lightTarget();
+LightLevels lightOutput();
+bool lightIsOn();
+
+// Lamp attributes. lightSet() also updates them from the levels.
+const uint8_t LAMP_ON = 1 << 0;
+const uint8_t LAMP_BRIGHTNESS = 1 << 1;
+const uint8_t LAMP_MIX = 1 << 2;
+
+struct LampPatch {
+  uint8_t mask; // LAMP_* fields to take
+  bool on;
+  uint16_t brightness;
+  uint16_t mix;
+};
+
+LampState lampGet();
+void lampPatch(const LampPatch &p, uint16_t fadeMs);
+// Returns the new power state
+bool lampToggle(uint16_t fadeMs);
+// Brightness += delta, kept within minBrightness..65535; turns the lamp on
+uint16_t lampStep(int32_t delta, uint16_t minBrightness, uint16_t fadeMs);
+
+enum class LampRestore : uint8_t { RTC, NVS, DEFAULT_ON };
+
+// Right after lightBegin(); writes the restored output before returning
+LampRestore lightRestore();
+// From loop(): writes the lamp to NVS once it has settled
+void lightPersistService();
+const char* lampRestoreName(LampRestore r);
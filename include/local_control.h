@@ -0,0 +1,45 @@
+/*
+Local control on PUSH_02
+
+The button drives the lamp without going near the network. The GPIO ISR
+timestamps the edge and notifies a small task that runs above lwIP and
+loop(). The task writes the output right away, so neither a busy loop()
+pass nor a connect in progress delays it.
+
+  press, lamp off        on, at the press edge
+  short press, lamp on   off, at the release edge
+  hold LOCAL_HOLD_MS     ramp brightness until release; the direction
+                         flips on every hold and at either end of the range
+
+Edges are debounced on the leading edge: the first edge acts, and the
+bounces within LOCAL_DEBOUNCE_MS after it are ignored. While the button
+is down the task re-reads the pin every ramp step, so a tap shorter than
+the debounce time still gets released.
+
+Latency is the ISR's esp_timer timestamp of the edge to the moment the
+output write returns. localControlStats() reports it, with a count of
+actions over the LOCAL_BUDGET_US budget.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const uint32_t LOCAL_HOLD_MS = 500;
+const uint32_t LOCAL_DEBOUNCE_MS = 30;
+const uint32_t LOCAL_BUDGET_US = 10000;
+
+struct LocalControlStats {
+  uint32_t actions;    // on/off toggles done by the button
+  uint32_t holds;      // dimming ramps started
+  uint32_t lastUs;     // edge -> output, last action
+  uint32_t maxUs;
+  uint32_t avgUs;
+  uint32_t overBudget; // actions slower than LOCAL_BUDGET_US
+};
+
+// Start the task; call from setup() after lightBegin(), before attaching the ISR
+void localControlBegin(uint8_t pin);
+// From the pin's CHANGE ISR, with the level it read
+void localControlEdgeFromISR(int level);
+LocalControlStats localControlStats();
@@ -0,0 +1,29 @@
+/*
+Portal input checks
+
+Everything here reads bytes an unauthenticated client or a neighbour's
+access point chose: the /save form fields and the SSIDs a scan returns.
+The functions have no side effects and no Wi-Fi dependency beyond the
+ScanEntry type, so the native fuzz targets in test/fuzz/ run them as is.
+
+  credentialError()    /save ssid/pass against the 802.11 limits and what
+                       the last scan saw for that SSID
+  appendJsonEscaped()  SSIDs and other raw bytes into a JSON string
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "scan_results.h"
+
+const uint8_t SSID_MAX_LEN = 32; // 802.11 SSID limit (bytes)
+const uint8_t PASS_MIN_LEN = 8;  // WPA2 passphrase 8..63 printable chars,
+const uint8_t PASS_MAX_LEN = 64; // or exactly 64 hex digits (raw PSK)
+
+// Append s as JSON string contents (no surrounding quotes)
+void appendJsonEscaped(String &out, const String &s);
+
+// Validate /save form input against what the last scan saw for this SSID
+// (seen may be null); returns nullptr if ok, else a message for the client
+const char* credentialError(const String &ssid, const String &pass, const ScanEntry *seen);
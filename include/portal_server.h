@@ -0,0 +1,142 @@
+/*
+PortalServer — minimal HTTP/1.1 server for the captive portal
+
+Covers the subset of WebServer that main.cpp uses (on / onNotFound / arg /
+send / send_P / sendHeader), so handlers did not change. Connections are
+kept alive. The portal page, /scan and the 1s /status poll share one TCP
+connection, so each request no longer pays its own handshake over the
+softAP link.
+
+Limits (compile-time, all memory is static):
+  PORTAL_MAX_CONNS        connections held open at once; when full, a new
+                          connection evicts the least recently active one
+  PORTAL_IDLE_TIMEOUT_MS  keep-alive connections idle this long are closed
+  PORTAL_MAX_REQUESTS     requests served on one connection before closing
+  PORTAL_MAX_REQUEST_LEN  request line + headers + body; larger gets 413
+
+The same instance serves the local API on the station link once the
+portal closes: clearRoutes() drops the portal's routes and setMaxConns()
+lowers the connection cap below PORTAL_MAX_CONNS, so the API costs no RAM
+beyond the portal's.
+
+A handler that cannot answer right away (e.g. /save waiting on a connect
+attempt) calls defer() and later respond() with the returned ticket. Until
+then the connection is parked: not read, not timed out, not evicted.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h> // HTTPMethod / HTTP_GET / HTTP_POST / HTTP_ANY
+#include <functional>
+
+#ifndef PORTAL_MAX_CONNS
+#define PORTAL_MAX_CONNS 3
+#endif
+#ifndef PORTAL_IDLE_TIMEOUT_MS
+#define PORTAL_IDLE_TIMEOUT_MS 5000UL
+#endif
+#ifndef PORTAL_MAX_REQUESTS
+#define PORTAL_MAX_REQUESTS 100
+#endif
+#ifndef PORTAL_MAX_REQUEST_LEN
+#define PORTAL_MAX_REQUEST_LEN 1536
+#endif
+#ifndef PORTAL_MAX_ROUTES
+#define PORTAL_MAX_ROUTES 16
+#endif
+
+class PortalServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit PortalServer(uint16_t port);
+
+  void begin();
+  void stop();
+  void handleClient();
+
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn);
+  void onNotFound(THandlerFunction fn);
+  // Forget every route and the not-found handler
+  void clearRoutes();
+  // Connections held open at once, 1..PORTAL_MAX_CONNS; call while stopped
+  void setMaxConns(uint8_t n);
+
+  // Current request (valid inside a handler only)
+  String uri() const;
+  HTTPMethod method() const { return reqMethod; }
+  String arg(const char *name) const;
+  bool hasArg(const char *name) const;
+  String header(const char *name) const;
+
+  // Response; sendHeader() must come before send()
+  void sendHeader(const char *name, const String &value);
+  void send(int code, const char *contentType, const String &content);
+  void send(int code, const char *contentType, const char *content);
+  void send_P(int code, const char *contentType, PGM_P content);
+  void send_P(int code, const char *contentType, PGM_P content, size_t contentLength); // may hold NULs
+
+  // Park the current request's connection and answer it later with
+  // respond(); returns the ticket (never 0). respond() returns false if the
+  // client has gone away meanwhile.
+  uint32_t defer();
+  bool respond(uint32_t ticket, int code, const char *contentType, const String &content);
+
+  // Stats since begin(): accepted TCP connections vs requests served
+  uint32_t connectionCount() const { return statConnections; }
+  uint32_t requestCount() const { return statRequests; }
+
+private:
+  struct Conn {
+    WiFiClient client;
+    bool inUse;
+    uint16_t len;       // bytes buffered
+    uint16_t headerEnd; // offset just past "\r\n\r\n", 0 = not seen yet
+    uint16_t requests;  // served on this connection
+    uint16_t serial;    // per accept, so a ticket outliving its connection is stale
+    bool parked;        // waiting for respond()
+    bool parkedKeepAlive;
+    bool parkedHead;
+    unsigned long lastActivityMs;
+    char buf[PORTAL_MAX_REQUEST_LEN];
+  };
+
+  struct Route {
+    const char *uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  void acceptNew();
+  void pump(Conn &c, unsigned long now);
+  bool parseAndDispatch(Conn &c);
+  void writeResponse(int code, const char *contentType, const char *body, size_t len);
+  void closeConn(Conn &c);
+  bool findParam(const char *start, uint16_t len, const char *name, String *out) const;
+
+  WiFiServer listener;
+  bool running;
+  Conn conns[PORTAL_MAX_CONNS];
+  Route routes[PORTAL_MAX_ROUTES];
+  uint8_t routeCount;
+  uint8_t maxConns;
+  THandlerFunction notFound;
+
+  // Request being dispatched; offsets into cur->buf
+  Conn *cur;
+  HTTPMethod reqMethod;
+  bool reqHead;
+  bool reqKeepAlive;
+  bool responded;
+  uint16_t pathStart, pathLen;
+  uint16_t queryStart, queryLen;
+  uint16_t headersStart, headersLen;
+  uint16_t bodyStart, bodyLen;
+  String extraHeaders;
+
+  uint16_t nextSerial;
+  uint32_t statConnections;
+  uint32_t statRequests;
+};
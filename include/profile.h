@@ -0,0 +1,52 @@
+/*
+Handler profiling (PROFILE_HTTP builds only)
+
+PROFILE_SCOPE("name") measures the rest of the enclosing block and prints one
+JSON line to Serial when the block exits:
+
+  {"prof":"scan_json","ns":812345,"allocs":124,"bytes":5120}
+
+"allocs"/"bytes" count every malloc/calloc/realloc that the scope's own task
+made while it was open (see the -Wl,--wrap flags in
+env:esp32doit-devkit-v1-profile); other tasks' allocations are left out.
+Grep the monitor log for '{"prof":' and diff the numbers between builds.
+test/bench_handlers/ times the same handlers on the host, no board needed;
+this env confirms a change on the device.
+
+Without PROFILE_HTTP the macro expands to nothing.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifdef PROFILE_HTTP
+
+struct AllocCounters {
+  uint32_t allocs;
+  uint32_t bytes;
+};
+
+AllocCounters profileAllocSnapshot();
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name);
+  ~ProfileScope();
+
+private:
+  const char *name;
+  uint32_t startCycles;
+  AllocCounters startAlloc;
+  TaskHandle_t prevOwner; // scope this one is nested in, if any
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+
+#endif
@@ -0,0 +1,113 @@
+/*
+Reason-aware station retry policy
+
+Every failed connect attempt is classified from the driver's disconnect
+reason (WIFI_REASON_*). Each class has its own attempt budget and backoff,
+taken from a RetryTable indexed by FailClass. Hopeless cases such as a wrong
+password fail fast. Transient ones such as beacon loss retry sooner.
+
+  RetryPolicy policy(BOOT_RETRY_RULES);
+  ...attempt fails with reason r...
+  int32_t wait = policy.onFailure(classifyReason(r));
+  if (wait < 0) give up; else delay(wait) and retry
+
+The tables themselves are in include/retry_rules.h.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+enum class FailClass : uint8_t {
+  NONE,              // not a failure (e.g. our own disconnect), keep waiting
+  AUTH_FAIL,         // AUTH_FAIL, MIC_FAILURE, 802_1X_AUTH_FAILED
+  HANDSHAKE_TIMEOUT, // 4WAY_HANDSHAKE_TIMEOUT, HANDSHAKE_TIMEOUT (mostly wrong password)
+  NO_AP_FOUND,       // SSID not seen by the driver's connect scan
+  ASSOC_FAIL,        // association/authentication rejected or expired by the AP
+  BEACON_TIMEOUT,    // BEACON_TIMEOUT, CONNECTION_FAIL (link lost, weak signal)
+  CONNECT_TIMEOUT,   // attempt timed out without any disconnect reason
+  OTHER,
+  COUNT
+};
+
+const size_t FAIL_CLASS_COUNT = (size_t)FailClass::COUNT;
+
+struct RetryRule {
+  uint8_t maxAttempts;   // failures of this class before giving up
+  uint16_t firstDelayMs; // wait after the first failure, doubled after each one
+  uint16_t maxDelayMs;
+};
+
+typedef RetryRule RetryTable[FAIL_CLASS_COUNT];
+
+inline FailClass classifyReason(uint8_t reason) {
+  switch (reason) {
+    case 0:
+      return FailClass::CONNECT_TIMEOUT;
+    case WIFI_REASON_ASSOC_LEAVE:
+      // reported for our own WiFi.disconnect(); may arrive after the next begin()
+      return FailClass::NONE;
+    case WIFI_REASON_AUTH_FAIL:
+    case WIFI_REASON_MIC_FAILURE:
+    case WIFI_REASON_802_1X_AUTH_FAILED:
+      return FailClass::AUTH_FAIL;
+    case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case WIFI_REASON_HANDSHAKE_TIMEOUT:
+      return FailClass::HANDSHAKE_TIMEOUT;
+    case WIFI_REASON_NO_AP_FOUND:
+      return FailClass::NO_AP_FOUND;
+    case WIFI_REASON_ASSOC_FAIL:
+    case WIFI_REASON_ASSOC_TOOMANY:
+    case WIFI_REASON_ASSOC_EXPIRE:
+    case WIFI_REASON_AUTH_EXPIRE:
+    case WIFI_REASON_NOT_AUTHED:
+    case WIFI_REASON_NOT_ASSOCED:
+      return FailClass::ASSOC_FAIL;
+    case WIFI_REASON_BEACON_TIMEOUT:
+    case WIFI_REASON_CONNECTION_FAIL:
+      return FailClass::BEACON_TIMEOUT;
+    default:
+      return FailClass::OTHER;
+  }
+}
+
+inline const char* failClassName(FailClass c) {
+  switch (c) {
+    case FailClass::NONE: return "NONE";
+    case FailClass::AUTH_FAIL: return "AUTH_FAIL";
+    case FailClass::HANDSHAKE_TIMEOUT: return "HANDSHAKE_TIMEOUT";
+    case FailClass::NO_AP_FOUND: return "NO_AP_FOUND";
+    case FailClass::ASSOC_FAIL: return "ASSOC_FAIL";
+    case FailClass::BEACON_TIMEOUT: return "BEACON_TIMEOUT";
+    case FailClass::CONNECT_TIMEOUT: return "CONNECT_TIMEOUT";
+    case FailClass::OTHER: return "OTHER";
+    default: return "?";
+  }
+}
+
+class RetryPolicy {
+public:
+  explicit RetryPolicy(const RetryTable &table) : rules(table) {
+    reset();
+  }
+
+  void reset() { memset(counts, 0, sizeof(counts)); }
+
+  // Record a failure; returns the delay before the next attempt, or -1 to give up
+  int32_t onFailure(FailClass c) {
+    size_t i = (size_t)c;
+    if (i >= FAIL_CLASS_COUNT) i = (size_t)FailClass::OTHER;
+    uint8_t n = ++counts[i];
+    const RetryRule &r = rules[i];
+    if (n >= r.maxAttempts) return -1;
+    uint32_t d = (uint32_t)r.firstDelayMs << min<uint8_t>(n - 1, 4);
+    return d > r.maxDelayMs ? r.maxDelayMs : d;
+  }
+
+  uint8_t failures(FailClass c) const { return counts[(size_t)c]; }
+
+private:
+  const RetryRule *rules;
+  uint8_t counts[FAIL_CLASS_COUNT];
+};
@@ -0,0 +1,36 @@
+/*
+Station retry tables
+
+Budgets and backoff per failure class for the two kinds of station
+attempt (see include/retry_policy.h). Each table is indexed by FailClass:
+{max attempts, first delay ms, max delay ms}. Kept apart from main.cpp so
+test/test_retry_policy can walk every class of both tables.
+*/
+
+#pragma once
+
+#include "retry_policy.h"
+
+// Boot: stored credentials, nobody waiting on a page
+const RetryTable BOOT_RETRY_RULES = {
+  {1, 0, 0},       // NONE (never recorded)
+  {2, 2000, 2000}, // AUTH_FAIL: stored password is most likely stale
+  {2, 1000, 1000}, // HANDSHAKE_TIMEOUT
+  {4, 2000, 8000}, // NO_AP_FOUND: router may still be booting after a power cut
+  {5, 500, 4000},  // ASSOC_FAIL
+  {5, 500, 4000},  // BEACON_TIMEOUT
+  {5, 1000, 8000}, // CONNECT_TIMEOUT: same 1s,2s,4s,8s as before
+  {3, 1000, 8000}, // OTHER
+};
+
+// /save: the user is waiting on the page, so credential problems fail fast
+const RetryTable SAVE_RETRY_RULES = {
+  {1, 0, 0},       // NONE
+  {1, 0, 0},       // AUTH_FAIL
+  {1, 0, 0},       // HANDSHAKE_TIMEOUT
+  {1, 0, 0},       // NO_AP_FOUND
+  {3, 500, 2000},  // ASSOC_FAIL
+  {3, 500, 2000},  // BEACON_TIMEOUT
+  {2, 500, 500},   // CONNECT_TIMEOUT
+  {2, 500, 500},   // OTHER
+};
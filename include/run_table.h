@@ -0,0 +1,29 @@
+/*
+RunState transition table
+
+The states the bulb's run loop moves through, the events that move it, and
+the table runFsm in main.cpp is built from (see include/state_machine.h).
+Kept apart from main.cpp so test/test_state_machine can fire every event
+from every state against the real table. The guard and actions are defined
+in main.cpp.
+*/
+
+#pragma once
+
+#include "state_machine.h"
+
+enum class RunState { CONNECTING, AP_SETUP, CONNECTED };
+enum class RunEvent { PORTAL_UP, STA_UP };
+
+bool staLinkUp();         // guard: station has an IP
+void enterSetupPattern(); // action: start the setup blink
+void showConnected();     // action: status LED: connected pattern
+
+// from, event, to, guard, action
+template <RunState F, RunEvent E, RunState T, FsmGuard G = nullptr, FsmAction A = nullptr>
+using RunRow = FsmRow<RunState, RunEvent, F, E, T, G, A>;
+typedef FsmTable<RunState, RunEvent,
+  RunRow<RunState::CONNECTING, RunEvent::PORTAL_UP, RunState::AP_SETUP, nullptr, enterSetupPattern>,
+  RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED, staLinkUp, showConnected>,
+  RunRow<RunState::AP_SETUP, RunEvent::STA_UP, RunState::CONNECTED, staLinkUp, showConnected>
+> RunTable;
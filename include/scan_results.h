@@ -0,0 +1,164 @@
+/*
+Scan post-processing
+
+The driver returns one entry per BSSID in driver order, so mesh systems
+and multi-AP buildings list the same SSID many times. ScanTopK keeps one
+entry per SSID (the strongest BSSID) and only the K strongest SSIDs. It
+uses a fixed-size min-heap on RSSI, with no allocation and O(n*K) work
+for n driver entries.
+
+Usage:
+  results.clear();
+  for (i < n) results.add(WiFi.SSID(i), WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i));
+  uint8_t order[K];
+  results.strongestFirst(order); // indices, strongest first
+
+add() may keep being called after strongestFirst(); a progressive scan
+reports partial results between channels that way.
+
+Hidden networks (empty SSID) are not kept, only noted: rulesOut() cannot
+say an SSID is out of range when a hidden network may be the one.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+struct ScanEntry {
+  char ssid[33]; // 32 bytes + NUL
+  int8_t rssi;
+  uint8_t channel;
+  wifi_auth_mode_t auth;
+};
+
+// Short label for the portal; OPEN/WEP/WPA/WPA2/WPA3 etc. instead of OPEN/WPA2 only
+inline const char* securityName(wifi_auth_mode_t auth) {
+  switch (auth) {
+    case WIFI_AUTH_OPEN: return "OPEN";
+    case WIFI_AUTH_WEP: return "WEP";
+    case WIFI_AUTH_WPA_PSK: return "WPA";
+    case WIFI_AUTH_WPA2_PSK: return "WPA2";
+    case WIFI_AUTH_WPA_WPA2_PSK: return "WPA/WPA2";
+    case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2-EAP";
+    case WIFI_AUTH_WPA3_PSK: return "WPA3";
+    case WIFI_AUTH_WPA2_WPA3_PSK: return "WPA2/WPA3";
+    case WIFI_AUTH_WAPI_PSK: return "WAPI";
+    default: return "UNKNOWN";
+  }
+}
+
+template <uint8_t K>
+class ScanTopK {
+public:
+  void clear() {
+    count = 0;
+    hidden = false;
+  }
+
+  void add(const String &ssid, int32_t rssi, int32_t channel, wifi_auth_mode_t auth) {
+    if (ssid.length() == 0) {
+      hidden = true;
+      return;
+    }
+    if (ssid.length() > 32) return;
+
+    int8_t r = (int8_t)constrain(rssi, -128, 127);
+    int idx = indexOf(ssid.c_str());
+    if (idx >= 0) {
+      // same SSID from another BSSID: keep the stronger one
+      if (r <= heap[idx].rssi) return;
+      heap[idx].rssi = r;
+      heap[idx].channel = (uint8_t)channel;
+      heap[idx].auth = auth;
+      siftDown(idx); // key grew in a min-heap
+      return;
+    }
+
+    if (count < K) {
+      fill(heap[count], ssid, r, channel, auth);
+      siftUp(count);
+      count++;
+    } else if (r > heap[0].rssi) {
+      // stronger than the weakest kept SSID: replace the root
+      fill(heap[0], ssid, r, channel, auth);
+      siftDown(0);
+    }
+  }
+
+  // Fill order[0..size()) with entry indices, strongest first; returns size()
+  uint8_t strongestFirst(uint8_t *order) const {
+    // insertion sort on indices, K is small and the heap stays intact
+    for (uint8_t i = 0; i < count; ++i) {
+      int j = i - 1;
+      while (j >= 0 && heap[order[j]].rssi < heap[i].rssi) {
+        order[j + 1] = order[j];
+        --j;
+      }
+      order[j + 1] = i;
+    }
+    return count;
+  }
+
+  uint8_t size() const { return count; }
+  const ScanEntry &operator[](uint8_t i) const { return heap[i]; }
+
+  const ScanEntry* find(const char *ssid) const {
+    int idx = indexOf(ssid);
+    return idx >= 0 ? &heap[idx] : nullptr;
+  }
+
+  bool sawHidden() const { return hidden; }
+
+  // True if a complete scan shows ssid is not in range: not seen, no hidden
+  // network that could be it, and no SSID dropped for the K strongest
+  bool rulesOut(const char *ssid) const { return !hidden && count < K && indexOf(ssid) < 0; }
+
+private:
+  int indexOf(const char *ssid) const {
+    for (uint8_t i = 0; i < count; ++i) {
+      if (strcmp(heap[i].ssid, ssid) == 0) return i;
+    }
+    return -1;
+  }
+
+  static void fill(ScanEntry &e, const String &ssid, int8_t rssi, int32_t channel, wifi_auth_mode_t auth) {
+    strncpy(e.ssid, ssid.c_str(), sizeof(e.ssid) - 1);
+    e.ssid[sizeof(e.ssid) - 1] = '\0';
+    e.rssi = rssi;
+    e.channel = (uint8_t)channel;
+    e.auth = auth;
+  }
+
+  void siftUp(uint8_t i) {
+    while (i > 0) {
+      uint8_t parent = (i - 1) / 2;
+      if (heap[parent].rssi <= heap[i].rssi) break;
+      swap(i, parent);
+      i = parent;
+    }
+  }
+
+  void siftDown(uint8_t i) {
+    for (;;) {
+      uint8_t smallest = i;
+      uint8_t l = 2 * i + 1;
+      uint8_t r = l + 1;
+      if (l < count && heap[l].rssi < heap[smallest].rssi) smallest = l;
+      if (r < count && heap[r].rssi < heap[smallest].rssi) smallest = r;
+      if (smallest == i) return;
+      swap(i, smallest);
+      i = smallest;
+    }
+  }
+
+  void swap(uint8_t a, uint8_t b) {
+    ScanEntry t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+  }
+
+  ScanEntry heap[K];
+  uint8_t count = 0;
+  bool hidden = false; // a BSS with an empty SSID answered
+};
@@ -0,0 +1,84 @@
+/*
+Scene library in a memory-mapped flash partition
+
+The "scenes" data partition (subtype 0x40, see partitions.csv) is mapped
+read-only into the address space once at boot with esp_partition_mmap.
+The active scene table is a pointer into that mapping, so a recall is
+sceneGet(i): one dereference, with no NVS lookup and no copy.
+
+Layout: the partition is an array of SCENE_SLOT_BYTES slots, each able to
+hold one complete SceneTable:
+
+  magic   "SCN1", written last, so a torn write never looks valid
+  seq     +1 per update; the valid slot with the highest seq is active
+  count, format, crc (CRC-32 over scenes[0..count)), scenes[SCENE_MAX]
+
+Updates are append-only. sceneStore() writes a whole new table into the
+slot after the active one. Flash is erased only when the write reaches
+the first slot of a sector, and that sector holds nothing but superseded
+tables. Every sector is therefore erased once per lap of
+SCENE_SLOTS updates, evenly.
+
+The erase (~40 ms) stalls both cores while flash cache is off. IDF flushes
+the cache for the written range, so the mapping shows new data at once.
+
+Without a valid table (empty partition, or no partition on an old
+partition table) the built-in defaults are used. They are const, so they
+are also read straight from flash.
+
+tools/scene_pack.py builds a partition image from a JSON scene list on
+the host; see the script for how to flash it.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t SCENE_MAX = 16;
+const uint8_t SCENE_NAME_LEN = 16; // including the NUL padding
+const uint16_t SCENE_FORMAT = 1;
+const size_t SCENE_SLOT_BYTES = 512;
+const uint32_t SCENE_MAGIC = 0x314e4353; // "SCN1" little-endian
+
+struct Scene {
+  char name[SCENE_NAME_LEN]; // NUL-padded, not necessarily NUL-terminated at 16
+  uint16_t warm;             // 0..65535, see include/light.h
+  uint16_t cool;
+  uint16_t fadeMs;
+  uint16_t reserved;         // 0
+};
+
+struct SceneTable {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t count;
+  uint16_t format;
+  uint32_t crc;
+  Scene scenes[SCENE_MAX];
+};
+
+static_assert(sizeof(Scene) == 24, "Scene layout is shared with tools/scene_pack.py");
+static_assert(sizeof(SceneTable) == 16 + 24 * SCENE_MAX, "SceneTable layout is shared with tools/scene_pack.py");
+static_assert(sizeof(SceneTable) <= SCENE_SLOT_BYTES, "scene table does not fit a slot");
+static_assert(4096 % SCENE_SLOT_BYTES == 0, "slots must tile a flash sector");
+
+// Map the partition and find the active table; call once in setup()
+void scenesBegin();
+
+uint8_t sceneCount();
+// nullptr if i >= sceneCount()
+const Scene* sceneGet(uint8_t i);
+// Index of the scene with this name, or -1
+int sceneFind(const char *name);
+// Replace scene i (i == sceneCount() appends) and persist; nullptr on success, else a message
+const char* sceneStore(uint8_t i, const Scene &s);
+
+struct SceneStoreStats {
+  bool mapped;     // false: no scenes partition, built-ins only
+  uint32_t seq;    // of the active table, 0 = built-ins
+  uint16_t slot;   // of the active table
+  uint16_t slots;
+  uint32_t writes; // since boot
+  uint32_t erases; // since boot
+};
+SceneStoreStats sceneStoreStats();
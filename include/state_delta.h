@@ -0,0 +1,62 @@
+/*
+Change tracking for state reports
+
+Every attribute remembers the version at which it last changed. The
+version is one counter for the whole tracker, bumped by each real change,
+so a subscriber only has to keep the last version it saw. changedSince()
+then gives the attributes its next report needs; the rest are left out.
+
+  DeltaTracker<REPORT_ATTR_COUNT> report;
+  loop():   report.set(ATTR_BRIGHTNESS, lamp.brightness);  // no-op if equal
+  publish:  uint32_t mask = report.changedSince(seen);
+            ... one field per set bit, then seen = report.version()
+
+since = 0 means "never seen" and returns every attribute, as does a since
+newer than the tracker (the subscriber's number is from an earlier boot).
+Callers that must tell boots apart send a boot id next to the version.
+
+Not thread-safe: set() and the publishers all run on the loop task.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+template <size_t N>
+class DeltaTracker {
+public:
+  // Returns true if value differs from the attribute's last one
+  bool set(uint8_t attr, uint32_t value) {
+    if (attr >= N || ((seeded & (1UL << attr)) && values[attr] == value)) return false;
+    seeded |= 1UL << attr;
+    values[attr] = value;
+    versions[attr] = ++current;
+    return true;
+  }
+
+  uint32_t version() const { return current; }
+  uint32_t value(uint8_t attr) const { return attr < N ? values[attr] : 0; }
+
+  // Attributes changed after version since, one bit per attribute
+  uint32_t changedSince(uint32_t since) const {
+    if (since == 0 || since > current) return ALL;
+    uint32_t mask = 0;
+    for (uint8_t a = 0; a < N; ++a) {
+      if (versions[a] > since) mask |= 1UL << a;
+    }
+    return mask;
+  }
+
+  static const uint32_t ALL = N >= 32 ? 0xffffffffUL : (1UL << (N % 32)) - 1;
+
+private:
+  static_assert(N <= 32, "change masks hold one bit per attribute");
+
+  uint32_t values[N] = {};
+  uint32_t versions[N] = {};
+  uint32_t seeded = 0;
+  uint32_t current = 0;
+};
+
+template <size_t N>
+const uint32_t DeltaTracker<N>::ALL;
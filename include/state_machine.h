@@ -0,0 +1,163 @@
+/*
+Compile-time state machine
+
+The transition table is a list of types. Each row is state x event ->
+guard / action / next state:
+
+  template <RunState F, RunEvent E, RunState T, FsmGuard G = nullptr, FsmAction A = nullptr>
+  using Row = FsmRow<RunState, RunEvent, F, E, T, G, A>;
+
+  typedef FsmTable<RunState, RunEvent,
+    Row<RunState::CONNECTING, RunEvent::PORTAL_UP, RunState::AP_SETUP>,
+    Row<RunState::AP_SETUP,   RunEvent::STA_UP,    RunState::CONNECTED, staLinkUp>
+  > RunTable;
+
+  StateMachine<RunState, RunEvent, RunTable> fsm(runState, stateName, eventName, onChange);
+  fsm.fire<RunEvent::STA_UP>();
+
+fire() walks the rows in order. The first row matching the current state
+and event whose guard passes (or has no guard) runs its action and moves
+to the next state. The rows are template arguments, so the walk is a chain
+of constant compares the compiler folds much like a switch. No heap is
+used. Checked at compile time:
+  - fire<E>() with an event that no row handles
+  - a row that can never match because an unguarded row for the same state
+    and event comes before it
+An event the table handles, but not in the current state, is rejected at
+run time. It is traced like any other transition.
+
+Every fire() is recorded with millis() in a small trace ring (trace()).
+With DEBUG defined it is also logged on Serial.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef FSM_TRACE_LEN
+#define FSM_TRACE_LEN 8
+#endif
+
+typedef bool (*FsmGuard)();
+typedef void (*FsmAction)();
+
+template <typename S, typename E, S From, E On, S To, FsmGuard G = nullptr, FsmAction A = nullptr>
+struct FsmRow {
+  static constexpr S from = From;
+  static constexpr E on = On;
+  static constexpr S to = To;
+  static constexpr FsmGuard guard = G;
+  static constexpr FsmAction action = A;
+};
+
+template <typename S, typename E, typename... Rows>
+struct FsmTable;
+
+template <typename S, typename E>
+struct FsmTable<S, E> {
+  static constexpr bool handles(E) { return false; }
+  static constexpr bool hasRow(S, E) { return false; }
+  static constexpr bool reachable() { return true; }
+  static bool step(S, E, S *) { return false; }
+};
+
+template <typename S, typename E, typename R, typename... Rest>
+struct FsmTable<S, E, R, Rest...> {
+  typedef FsmTable<S, E, Rest...> Next;
+
+  static constexpr bool handles(E on) { return R::on == on || Next::handles(on); }
+  static constexpr bool hasRow(S from, E on) { return (R::from == from && R::on == on) || Next::hasRow(from, on); }
+  // an unguarded row shadows every later row for the same state and event
+  static constexpr bool reachable() {
+    return (R::guard != nullptr || !Next::hasRow(R::from, R::on)) && Next::reachable();
+  }
+
+  // First matching row whose guard passes: run its action, set *to
+  static bool step(S from, E on, S *to) {
+    if (R::from == from && R::on == on && (R::guard == nullptr || R::guard())) {
+      if (R::action != nullptr) R::action();
+      *to = R::to;
+      return true;
+    }
+    return Next::step(from, on, to);
+  }
+};
+
+template <typename S, typename E>
+struct FsmTrace {
+  uint32_t atMs;
+  S from;
+  E on;
+  S to;          // == from when rejected
+  bool accepted; // false: no row matched in this state (or every guard failed)
+};
+
+template <typename S, typename E, typename Table>
+class StateMachine {
+  static_assert(Table::reachable(), "transition table has a row shadowed by an earlier unguarded row");
+
+public:
+  typedef const char *(*StateName)(S);
+  typedef const char *(*EventName)(E);
+  typedef void (*OnChange)(S from, S to);
+
+  // state is the storage the rest of the code reads; only fire() writes it
+  StateMachine(S &state, StateName stateName, EventName eventName, OnChange onChange)
+    : cur(state), stateName(stateName), eventName(eventName), onChange(onChange), traceCount(0) {}
+
+  template <E On>
+  bool fire() {
+    static_assert(Table::handles(On), "no transition in the table handles this event");
+    return fire(On);
+  }
+
+  // Runtime form, for events only known at run time
+  bool fire(E on) {
+    S from = cur;
+    S to = from;
+    bool ok = Table::step(from, on, &to);
+    FsmTrace<S, E> &t = traceRing[traceCount % FSM_TRACE_LEN];
+    t.atMs = millis();
+    t.from = from;
+    t.on = on;
+    t.to = to;
+    t.accepted = ok;
+    traceCount++;
+#ifdef DEBUG
+    if (ok) Serial.printf("FSM %lu ms: %s --%s--> %s\n", (unsigned long)t.atMs, stateName(from), eventName(on), stateName(to));
+    else Serial.printf("FSM %lu ms: %s --%s--> rejected\n", (unsigned long)t.atMs, stateName(from), eventName(on));
+#endif
+    if (!ok) return false;
+    cur = to;
+    if (to != from && onChange) onChange(from, to);
+    return true;
+  }
+
+  S state() const { return cur; }
+
+  // i = 0 is the oldest kept entry; count() <= FSM_TRACE_LEN
+  uint8_t count() const { return traceCount < FSM_TRACE_LEN ? traceCount : FSM_TRACE_LEN; }
+  const FsmTrace<S, E> &trace(uint8_t i) const {
+    uint32_t first = traceCount < FSM_TRACE_LEN ? 0 : traceCount - FSM_TRACE_LEN;
+    return traceRing[(first + i) % FSM_TRACE_LEN];
+  }
+
+private:
+  S &cur;
+  StateName stateName;
+  EventName eventName;
+  OnChange onChange;
+  FsmTrace<S, E> traceRing[FSM_TRACE_LEN];
+  uint32_t traceCount;
+};
+
+template <typename S, typename E, S From, E On, S To, FsmGuard G, FsmAction A>
+constexpr S FsmRow<S, E, From, On, To, G, A>::from;
+template <typename S, typename E, S From, E On, S To, FsmGuard G, FsmAction A>
+constexpr E FsmRow<S, E, From, On, To, G, A>::on;
+template <typename S, typename E, S From, E On, S To, FsmGuard G, FsmAction A>
+constexpr S FsmRow<S, E, From, On, To, G, A>::to;
+template <typename S, typename E, S From, E On, S To, FsmGuard G, FsmAction A>
+constexpr FsmGuard FsmRow<S, E, From, On, To, G, A>::guard;
+template <typename S, typename E, S From, E On, S To, FsmGuard G, FsmAction A>
+constexpr FsmAction FsmRow<S, E, From, On, To, G, A>::action;
@@ -0,0 +1,89 @@
+/*
+Input trace: record + HTTP replay (TRACE_RECORD builds only)
+
+Records what came into the firmware from outside, with millis()
+timestamps: bus events (Wi-Fi connect/disconnect with the reason code,
+softAP joins, button edges), HTTP requests, each network a scan found and
+the end of each channel's scan. Together with the boot's reset reason,
+plan, failed-boot count and config overrides that is what drives setup()
+and loop(), so a trace taken in the field tells what the bulb saw and when.
+
+The trace is one static RAM buffer of TRACE_BUFFER_BYTES, filled from the
+start of the boot. When it is full, later records are counted and dropped;
+connect-timing problems happen early, so the start is the part to keep.
+GET /trace (config token needed, see include/config.h) downloads it as is;
+add clear=1 to start over once it has been fetched.
+tools/trace_replay.py prints it as a timeline and replays its HTTP
+requests against a bulb; the other records (Wi-Fi events, button edges,
+scans) are only shown, as nothing feeds them back into a device.
+test/replay/ feeds all of them back into the firmware on the host and
+checks that it goes through the same RunState changes (see its Makefile).
+
+Buffer layout, little endian:
+  header   "TRC1", u16 format, u16 header size, u32 bytes used (header
+           included), u32 records dropped, u32 boot reset reason,
+           u32 boot plan, u32 failed boots before this one, u32 millis()
+           at traceBegin()
+  records  u32 atMs, u8 kind, u8 payload length, u16 arg, payload
+
+  kind       arg                      payload
+  EVENT      EventType | code << 8    level
+  HTTP       method (HTTPMethod)      path ["?" query] [" " body]; each
+                                      (decoded) character of a pass= value
+                                      is replaced by "*"
+  SCAN       channel | rssi << 8      auth mode, SSID
+  CONFIG     setting index (Cfg)      u32 value; one per NVS override,
+                                      written by traceBegin()
+  SCAN_DONE  channel                  u8 networks found (0 if it failed)
+
+Format 1 (before CONFIG, SCAN_DONE, the failed-boot count and the start
+time) had a 24-byte header and a pass= value of a single "*".
+
+Payloads are cut at TRACE_MAX_PAYLOAD bytes. Recording runs on the loop
+task only (bus subscriber, HTTP dispatch, scan fold); no locks.
+
+Without TRACE_RECORD every function here is an empty inline.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "event_bus.h"
+
+#ifndef TRACE_BUFFER_BYTES
+#define TRACE_BUFFER_BYTES 16384
+#endif
+#ifndef TRACE_MAX_PAYLOAD
+#define TRACE_MAX_PAYLOAD 96
+#endif
+
+enum class TraceKind : uint8_t { EVENT = 1, HTTP = 2, SCAN = 3, CONFIG = 4, SCAN_DONE = 5 };
+
+#ifdef TRACE_RECORD
+
+// From setup(), once the boot plan is known (after configBegin())
+void traceBegin(uint8_t bootPlan, uint8_t bootFails);
+// Bus subscriber: put it first in the Subscribers list
+void traceOnEvent(const Event &e);
+void traceHttp(uint8_t method, const char *path, uint16_t pathLen, const char *query, uint16_t queryLen,
+               const char *body, uint16_t bodyLen);
+void traceScan(const String &ssid, int32_t rssi, uint8_t channel, uint8_t auth);
+// After one channel's results were folded; found < 0 is a failed scan
+void traceScanDone(uint8_t channel, int16_t found);
+
+// The buffer as downloaded: header and records
+const uint8_t* traceData();
+size_t traceSize();
+uint32_t traceDropped();
+void traceClear();
+
+#else
+
+inline void traceBegin(uint8_t, uint8_t) {}
+inline void traceOnEvent(const Event &) {}
+inline void traceHttp(uint8_t, const char *, uint16_t, const char *, uint16_t, const char *, uint16_t) {}
+inline void traceScan(const String &, int32_t, uint8_t, uint8_t) {}
+inline void traceScanDone(uint8_t, int16_t) {}
+
+#endif
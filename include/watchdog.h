@@ -0,0 +1,41 @@
+/*
+Subsystem watchdog
+
+Each subsystem registers a deadline and kicks a heartbeat whenever it makes
+progress. A small supervisor task checks the heartbeats every
+WDT_CHECK_PERIOD_MS. It feeds the ESP-IDF task watchdog only while every
+registered subsystem is within its deadline. When one misses its deadline,
+the supervisor:
+  1. writes the subsystem and its gap into RTC memory (survives the reset);
+     with several late, the one kicked longest ago, where loop() stalled,
+  2. logs it on Serial,
+  3. stops feeding the task watchdog, which then resets the chip.
+The task watchdog also resets the chip if the supervisor itself hangs.
+
+Deadlines cover the longest legitimate stall of a loop() pass. Connect
+attempts run as coroutines (include/coro.h) rather than blocking, so a
+missed deadline means a hung driver call or handler, not a slow network.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+enum class Subsystem : uint8_t { NETWORK, HTTP, DNS, LED, BUTTONS, COUNT };
+
+const size_t SUBSYSTEM_COUNT = (size_t)Subsystem::COUNT;
+
+// Subscribe the supervisor task to the task watchdog (timeout in seconds, panics on expiry)
+void watchdogBegin(uint32_t twdtTimeoutS);
+
+void watchdogRegister(Subsystem s, uint32_t deadlineMs);
+void watchdogUnregister(Subsystem s);
+void watchdogKick(Subsystem s);
+
+// Longest gap between two kicks since registration, in ms
+uint32_t watchdogMaxGapMs(Subsystem s);
+
+// True if the previous boot was reset by the supervisor; fills in who and how late
+bool watchdogLastReset(Subsystem *s, uint32_t *gapMs);
+
+const char* subsystemName(Subsystem s);
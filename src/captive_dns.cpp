@@ -0,0 +1,114 @@
+#include "captive_dns.h"
+
+// Header flags, byte 2 and 3
+const uint8_t DNS_QR = 0x80;
+const uint8_t DNS_OPCODE = 0x78;
+const uint8_t DNS_AA = 0x04;
+const uint8_t DNS_RD = 0x01;
+const uint8_t DNS_FORMERR = 1;
+const uint8_t DNS_NOTIMP = 4;
+
+const uint16_t DNS_TYPE_A = 1;
+const uint16_t DNS_TYPE_ANY = 255;
+const uint16_t DNS_CLASS_IN = 1;
+const size_t DNS_MAX_LABEL = 63;
+const size_t DNS_MAX_NAME = 255; // wire form, length bytes included
+const size_t DNS_A_RECORD_LEN = 16;
+
+static uint16_t be16(const uint8_t *p) {
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void putBe16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+// Reply with no sections, only an error code
+static size_t headerOnly(uint8_t *reply, size_t cap, uint8_t id0, uint8_t id1, uint8_t flags, uint8_t rcode) {
+  if (cap < DNS_HEADER_LEN) return 0;
+  reply[0] = id0;
+  reply[1] = id1;
+  reply[2] = DNS_QR | (flags & (DNS_OPCODE | DNS_RD));
+  reply[3] = rcode;
+  memset(reply + 4, 0, DNS_HEADER_LEN - 4);
+  return DNS_HEADER_LEN;
+}
+
+size_t captiveDnsReply(const uint8_t *query, size_t len, const uint8_t ip[4], uint8_t *reply, size_t cap) {
+  if (len < DNS_HEADER_LEN || (query[2] & DNS_QR)) return 0;
+  // read before writing anything: reply may be the query buffer
+  uint8_t id0 = query[0], id1 = query[1], flags = query[2];
+  if (flags & DNS_OPCODE) return headerOnly(reply, cap, id0, id1, flags, DNS_NOTIMP);
+  if (be16(query + 4) != 1) return headerOnly(reply, cap, id0, id1, flags, DNS_FORMERR);
+
+  // QNAME: length-prefixed labels up to the root label; a query has no
+  // reason to compress its only name
+  size_t pos = DNS_HEADER_LEN;
+  size_t nameLen = 0;
+  for (;;) {
+    if (pos >= len) return headerOnly(reply, cap, id0, id1, flags, DNS_FORMERR);
+    uint8_t label = query[pos];
+    nameLen += 1 + label;
+    if (label > DNS_MAX_LABEL || nameLen > DNS_MAX_NAME) return headerOnly(reply, cap, id0, id1, flags, DNS_FORMERR);
+    pos += 1 + label;
+    if (label == 0) break;
+  }
+  if (pos + 4 > len) return headerOnly(reply, cap, id0, id1, flags, DNS_FORMERR);
+  uint16_t qtype = be16(query + pos);
+  uint16_t qclass = be16(query + pos + 2);
+  size_t questionEnd = pos + 4;
+
+  bool answer = (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) && qclass == DNS_CLASS_IN;
+  size_t n = questionEnd + (answer ? DNS_A_RECORD_LEN : 0);
+  if (n > cap) return 0;
+
+  if (reply != query) memcpy(reply + DNS_HEADER_LEN, query + DNS_HEADER_LEN, questionEnd - DNS_HEADER_LEN);
+  reply[0] = id0;
+  reply[1] = id1;
+  reply[2] = DNS_QR | DNS_AA | (flags & DNS_RD);
+  reply[3] = 0; // no recursion available, NOERROR
+  putBe16(reply + 4, 1);
+  putBe16(reply + 6, answer ? 1 : 0);
+  putBe16(reply + 8, 0);
+  putBe16(reply + 10, 0);
+  if (answer) {
+    uint8_t *a = reply + questionEnd;
+    putBe16(a, 0xC000 | DNS_HEADER_LEN); // name: pointer to the question's
+    putBe16(a + 2, DNS_TYPE_A);
+    putBe16(a + 4, DNS_CLASS_IN);
+    putBe16(a + 6, (uint16_t)(CAPTIVE_DNS_TTL_S >> 16));
+    putBe16(a + 8, (uint16_t)CAPTIVE_DNS_TTL_S);
+    putBe16(a + 10, 4);
+    memcpy(a + 12, ip, 4);
+  }
+  return n;
+}
+
+bool CaptiveDns::start(uint16_t port, const IPAddress &addr) {
+  for (int i = 0; i < 4; ++i) ip[i] = addr[i];
+  running = udp.begin(port) == 1;
+  return running;
+}
+
+void CaptiveDns::stop() {
+  udp.stop();
+  running = false;
+}
+
+void CaptiveDns::processNextRequest() {
+  if (!running) return;
+  for (int i = 0; i < CAPTIVE_DNS_BURST; ++i) {
+    int size = udp.parsePacket();
+    if (size <= 0) return;
+    int len = udp.read(buf, sizeof(buf));
+    // over plain DNS size: not a query from a phone; the rest is discarded
+    // by the next parsePacket()
+    if (len <= 0 || (size_t)size > sizeof(buf)) continue;
+    size_t n = captiveDnsReply(buf, (size_t)len, ip, buf, sizeof(buf));
+    if (n == 0) continue;
+    udp.beginPacket(udp.remoteIP(), udp.remotePort());
+    udp.write(buf, n);
+    udp.endPacket();
+  }
+}
@@ -0,0 +1,120 @@
+#include "config.h"
+
+#include <Preferences.h>
+#include <bootloader_random.h>
+#include <esp_system.h>
+
+#define CFG_VALUE_(name, key, type, def, lo, hi, ovr) def,
+uint32_t cfgValues[CFG_COUNT] = { CONFIG_SETTINGS(CFG_VALUE_) };
+#undef CFG_VALUE_
+
+static Preferences cfgPrefs;
+static uint32_t overriddenMask = 0; // bit i: cfgValues[i] came from NVS
+static String token;
+
+static_assert(CFG_COUNT <= 32, "overriddenMask holds one bit per setting");
+
+void configBegin() {
+  cfgPrefs.begin("cfg", false);
+  for (size_t i = 0; i < CFG_COUNT; ++i) {
+    const CfgSpec &s = CFG_SPECS[i];
+    if (!cfgPrefs.isKey(s.key)) continue;
+    uint32_t v = cfgPrefs.getULong(s.key, s.def);
+    if (!s.overridable || v < s.min || v > s.max) {
+      // written by an older firmware with other limits: fall back to the default
+      cfgPrefs.remove(s.key);
+      continue;
+    }
+    cfgValues[i] = v;
+    overriddenMask |= 1UL << i;
+#ifdef DEBUG
+    Serial.printf("Config: %s = %lu (NVS override)\n", s.key, (unsigned long)v);
+#endif
+  }
+
+  token = cfgPrefs.getString("token", "");
+  if (token.length() != 16) {
+    // esp_random() is only a true RNG while the RF (or the SAR ADC noise
+    // source) runs; this is before Wi-Fi starts, so switch the ADC one on
+    uint8_t raw[8];
+    bootloader_random_enable();
+    esp_fill_random(raw, sizeof(raw));
+    bootloader_random_disable();
+    char buf[17];
+    for (size_t i = 0; i < sizeof(raw); ++i) snprintf(buf + 2 * i, 3, "%02x", raw[i]);
+    token = buf;
+    cfgPrefs.putString("token", token);
+  }
+}
+
+int configFind(const char *key) {
+  for (size_t i = 0; i < CFG_COUNT; ++i) {
+    if (strcmp(CFG_SPECS[i].key, key) == 0) return (int)i;
+  }
+  return -1;
+}
+
+const char* configSet(size_t i, uint32_t value) {
+  if (i >= CFG_COUNT) return "Unknown setting";
+  const CfgSpec &s = CFG_SPECS[i];
+  if (!s.overridable) return "Setting is fixed at build time";
+  if (value < s.min || value > s.max) return "Value out of range";
+  cfgValues[i] = value;
+  overriddenMask |= 1UL << i;
+  cfgPrefs.putULong(s.key, value);
+  return nullptr;
+}
+
+void configReset(size_t i) {
+  if (i >= CFG_COUNT) return;
+  cfgValues[i] = CFG_SPECS[i].def;
+  overriddenMask &= ~(1UL << i);
+  cfgPrefs.remove(CFG_SPECS[i].key);
+}
+
+void configClear() {
+  cfgPrefs.clear(); // the token goes too; configBegin() makes a new one after the restart
+  for (size_t i = 0; i < CFG_COUNT; ++i) cfgValues[i] = CFG_SPECS[i].def;
+  overriddenMask = 0;
+  token = "";
+}
+
+bool configIsOverridden(size_t i) {
+  return i < CFG_COUNT && (overriddenMask & (1UL << i));
+}
+
+String configJson() {
+  String s = "{";
+  for (size_t i = 0; i < CFG_COUNT; ++i) {
+    const CfgSpec &c = CFG_SPECS[i];
+    if (i) s += ",";
+    s += "\"";
+    s += c.key;
+    s += "\":{\"value\":";
+    s += String((unsigned long)cfgValues[i]);
+    s += ",\"default\":";
+    s += String((unsigned long)c.def);
+    s += ",\"min\":";
+    s += String((unsigned long)c.min);
+    s += ",\"max\":";
+    s += String((unsigned long)c.max);
+    s += c.overridable ? ",\"fixed\":false" : ",\"fixed\":true";
+    s += configIsOverridden(i) ? ",\"overridden\":true}" : ",\"overridden\":false}";
+  }
+  s += "}";
+  return s;
+}
+
+const String& configToken() {
+  return token;
+}
+
+bool configAuthorized(const String &authorization) {
+  const String &t = configToken();
+  if (t.length() == 0) return false; // cleared, not made yet
+  if (authorization.length() != 7 + t.length() || !authorization.startsWith("Bearer ")) return false;
+  // constant time over the token so timing does not leak a prefix
+  uint8_t diff = 0;
+  for (unsigned int i = 0; i < t.length(); ++i) diff |= (uint8_t)(authorization[7 + i] ^ t[i]);
+  return diff == 0;
+}
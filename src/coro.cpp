@@ -0,0 +1,12 @@
+#include "coro.h"
+
+// Posted from the Wi-Fi event task and HTTP handlers, taken on the loop task
+static uint32_t coroEventBits = 0;
+
+void coroPost(uint32_t bits) {
+  __atomic_fetch_or(&coroEventBits, bits, __ATOMIC_SEQ_CST);
+}
+
+uint32_t coroTakeEvents(uint32_t mask) {
+  return __atomic_fetch_and(&coroEventBits, ~mask, __ATOMIC_SEQ_CST) & mask;
+}
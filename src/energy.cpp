@@ -0,0 +1,136 @@
+#include "energy.h"
+
+#include "board.h"
+#include "config.h"
+
+const uint32_t ENERGY_RECORD_MAGIC = 0x454e5231; // "ENR1"
+
+struct EnergyRecord {
+  uint32_t magic;
+  EnergyTotals t;
+  uint32_t check; // over t; a reset in the middle of a tick fails it and starts over
+};
+
+static RTC_NOINIT_ATTR EnergyRecord record;
+static_assert(sizeof(EnergyRecord) <= Board::RTC_SLOW_BYTES / 16, "energy record should stay a small slice of RTC memory");
+
+static EnergyTotals atBoot;
+static uint32_t lastTickMs = 0;
+
+static uint32_t checksum(const EnergyTotals &t) {
+  // FNV-1a over the bytes
+  const uint8_t *p = (const uint8_t *)&t;
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < sizeof(t); ++i) h = (h ^ p[i]) * 16777619UL;
+  return h;
+}
+
+void energyBegin() {
+  if (record.magic != ENERGY_RECORD_MAGIC || record.check != checksum(record.t)) {
+    memset(&record, 0, sizeof(record));
+    record.magic = ENERGY_RECORD_MAGIC;
+  }
+  record.t.boots++;
+  record.check = checksum(record.t);
+  atBoot = record.t;
+  lastTickMs = 0; // the first tick also charges the time since power-on
+}
+
+uint16_t energyCurrentMa(RadioMode radio) {
+  switch (radio) {
+    case RadioMode::OFF: return cfg<Cfg::I_BASE_MA>();
+    case RadioMode::STA: return cfg<Cfg::I_STA_MA>();
+    case RadioMode::STA_SLEEP: return cfg<Cfg::I_STA_SLEEP_MA>();
+    case RadioMode::AP: return cfg<Cfg::I_AP_MA>();
+    case RadioMode::AP_STA: return cfg<Cfg::I_AP_STA_MA>();
+    case RadioMode::SCAN: return cfg<Cfg::I_SCAN_MA>();
+    case RadioMode::COUNT: break;
+  }
+  return 0;
+}
+
+void energyTick(uint8_t runState, RadioMode radio) {
+  uint32_t now = millis();
+  uint32_t dt = now - lastTickMs;
+  lastTickMs = now;
+  if (dt == 0) return;
+  if (runState >= ENERGY_RUN_SLOTS) runState = ENERGY_RUN_SLOTS - 1;
+  record.t.runMs[runState] += dt;
+  record.t.radioMs[(size_t)radio] += dt;
+  record.t.nJ += (uint64_t)energyCurrentMa(radio) * dt * cfg<Cfg::SUPPLY_MV>();
+  record.check = checksum(record.t);
+}
+
+EnergyTotals energyTotal() {
+  return record.t;
+}
+
+EnergyTotals energySinceBoot() {
+  EnergyTotals d = record.t;
+  d.boots = 1;
+  for (size_t i = 0; i < ENERGY_RUN_SLOTS; ++i) d.runMs[i] -= atBoot.runMs[i];
+  for (size_t i = 0; i < RADIO_MODE_COUNT; ++i) d.radioMs[i] -= atBoot.radioMs[i];
+  d.nJ -= atBoot.nJ;
+  return d;
+}
+
+const char* radioModeName(RadioMode m) {
+  switch (m) {
+    case RadioMode::OFF: return "OFF";
+    case RadioMode::STA: return "STA";
+    case RadioMode::STA_SLEEP: return "STA_SLEEP";
+    case RadioMode::AP: return "AP";
+    case RadioMode::AP_STA: return "AP_STA";
+    case RadioMode::SCAN: return "SCAN";
+    case RadioMode::COUNT: break;
+  }
+  return "?";
+}
+
+static String u64(uint64_t v) {
+  char buf[21];
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+  return String(buf);
+}
+
+static uint64_t uptimeMs(const EnergyTotals &t) {
+  uint64_t ms = 0;
+  for (size_t i = 0; i < ENERGY_RUN_SLOTS; ++i) ms += t.runMs[i];
+  return ms;
+}
+
+String energyJson(const char *(*runName)(uint8_t), uint8_t runStates) {
+  EnergyTotals total = energyTotal();
+  EnergyTotals boot = energySinceBoot();
+  String s = "{\"supply_mv\":";
+  s += String((unsigned long)cfg<Cfg::SUPPLY_MV>());
+  s += ",\"boots\":";
+  s += String((unsigned long)total.boots);
+  s += ",\"boot\":{\"ms\":";
+  s += u64(uptimeMs(boot));
+  s += ",\"mwh\":";
+  s += String(energyMwh(boot.nJ), 3);
+  s += "},\"total\":{\"ms\":";
+  s += u64(uptimeMs(total));
+  s += ",\"mwh\":";
+  s += String(energyMwh(total.nJ), 3);
+  s += "},\"run_ms\":{";
+  if (runStates > ENERGY_RUN_SLOTS) runStates = ENERGY_RUN_SLOTS;
+  for (uint8_t i = 0; i < runStates; ++i) {
+    if (i) s += ",";
+    s += "\"";
+    s += runName(i);
+    s += "\":";
+    s += u64(total.runMs[i]);
+  }
+  s += "},\"radio_ms\":{";
+  for (size_t i = 0; i < RADIO_MODE_COUNT; ++i) {
+    if (i) s += ",";
+    s += "\"";
+    s += radioModeName((RadioMode)i);
+    s += "\":";
+    s += u64(total.radioMs[i]);
+  }
+  s += "}}";
+  return s;
+}
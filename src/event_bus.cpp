@@ -0,0 +1,34 @@
+#include "event_bus.h"
+
+static MpscRing<Event, EVENT_QUEUE_LEN> bus;
+static uint32_t postedCount = 0;
+static uint16_t maxDepth = 0;
+
+bool IRAM_ATTR eventPost(EventType type, uint8_t code, uint8_t level) {
+  Event e;
+  e.type = type;
+  e.code = code;
+  e.level = level;
+  e.atMs = millis();
+  if (!bus.push(e)) return false;
+  __atomic_fetch_add(&postedCount, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool eventPop(Event &e) {
+  return bus.pop(e);
+}
+
+uint16_t eventDepth() {
+  uint16_t d = bus.depth();
+  if (d > maxDepth) maxDepth = d;
+  return d;
+}
+
+EventStats eventStats() {
+  EventStats s;
+  s.posted = __atomic_load_n(&postedCount, __ATOMIC_RELAXED);
+  s.dropped = bus.droppedCount();
+  s.maxDepth = maxDepth;
+  return s;
+}
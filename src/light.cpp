@@ -0,0 +1,246 @@
+#include "light.h"
+
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "board.h"
+#include "config.h"
+
+const uint8_t LIGHT_CH_WARM = 0;
+const uint8_t LIGHT_CH_COOL = 1;
+const uint32_t LIGHT_PWM_HZ = 19000; // above hearing, so the driver does not whine
+const uint8_t LIGHT_PWM_BITS = 12;
+const uint32_t LAMP_SAVE_DELAY_MS = 5000; // NVS write once the lamp has been left alone this long
+const uint32_t LAMP_RECORD_MAGIC = 0x4c4d5031; // "LMP1"
+
+static_assert(LIGHT_PWM_BITS <= Board::LEDC_MAX_BITS, "PWM resolution not supported by this board's LEDC");
+static_assert(LIGHT_CH_COOL < Board::LEDC_CHANNELS, "board has too few LEDC channels");
+static_assert((80000000UL >> LIGHT_PWM_BITS) >= LIGHT_PWM_HZ, "80 MHz LEDC clock cannot do this frequency at this resolution");
+
+static LightLevels target = {0, 0};
+static LightLevels output = {0, 0};
+static LightLevels fadeFrom = {0, 0};
+static unsigned long fadeStartMs = 0;
+static uint16_t fadeMs = 0; // 0 = no fade running
+static LampState lamp = {false, 65535, 32768};
+static SemaphoreHandle_t lock = nullptr;
+
+// Lamp state across resets: RTC memory for soft resets, NVS (written lazily) for power cycles
+struct LampRecord {
+  uint32_t magic;
+  LampState lamp;
+  uint32_t check;
+};
+static RTC_NOINIT_ATTR LampRecord rtcLamp;
+static Preferences lampPrefs;
+static bool prefsOpen = false;
+static LampState savedLamp = {false, 0, 0}; // what NVS holds
+static bool savedLampRead = false;           // false: savedLamp not loaded from NVS yet
+static unsigned long changedMs = 0;
+
+static uint32_t recordCheck(const LampState &l) {
+  return LAMP_RECORD_MAGIC ^ ((uint32_t)l.brightness << 16 | l.mix) ^ (l.on ? 0x80000001UL : 0);
+}
+
+static bool sameLamp(const LampState &a, const LampState &b) {
+  return a.on == b.on && a.brightness == b.brightness && a.mix == b.mix;
+}
+
+// Stored lamp into *s; false if NVS has none
+static bool readSaved(LampState *s) {
+  if (!prefsOpen) prefsOpen = lampPrefs.begin("lamp", false);
+  uint8_t b[5];
+  if (!prefsOpen || lampPrefs.getBytes("state", b, sizeof(b)) != sizeof(b)) return false;
+  s->on = b[0] != 0;
+  s->brightness = (uint16_t)(b[1] | b[2] << 8);
+  s->mix = (uint16_t)(b[3] | b[4] << 8);
+  return true;
+}
+
+// Everything below runs from loop() and from the local control task
+struct LightGuard {
+  LightGuard() { xSemaphoreTake(lock, portMAX_DELAY); }
+  ~LightGuard() { xSemaphoreGive(lock); }
+};
+
+static uint32_t duty(uint16_t level) {
+  return ((uint32_t)level * level) >> (32 - LIGHT_PWM_BITS);
+}
+
+static void write(LightLevels l) {
+  if (duty(l.warm) != duty(output.warm)) ledcWrite(LIGHT_CH_WARM, duty(l.warm));
+  if (duty(l.cool) != duty(output.cool)) ledcWrite(LIGHT_CH_COOL, duty(l.cool));
+  output = l;
+}
+
+static uint16_t lerp(uint16_t a, uint16_t b, uint32_t num, uint32_t den) {
+  return (uint16_t)((int32_t)a + ((int32_t)b - (int32_t)a) * (int64_t)num / (int64_t)den);
+}
+
+static void setLocked(LightLevels to, uint16_t ms) {
+  rtcLamp.lamp = lamp;
+  rtcLamp.check = recordCheck(lamp);
+  rtcLamp.magic = LAMP_RECORD_MAGIC;
+  changedMs = millis();
+  target = to;
+  if (ms == 0) {
+    fadeMs = 0;
+    write(to);
+    return;
+  }
+  fadeFrom = output;
+  fadeStartMs = millis();
+  fadeMs = ms;
+}
+
+void lightBegin() {
+  lock = xSemaphoreCreateMutex();
+  ledcSetup(LIGHT_CH_WARM, LIGHT_PWM_HZ, LIGHT_PWM_BITS);
+  ledcSetup(LIGHT_CH_COOL, LIGHT_PWM_HZ, LIGHT_PWM_BITS);
+  ledcAttachPin(cfgDefault<Cfg::PIN_LIGHT_WARM>(), LIGHT_CH_WARM);
+  ledcAttachPin(cfgDefault<Cfg::PIN_LIGHT_COOL>(), LIGHT_CH_COOL);
+  ledcWrite(LIGHT_CH_WARM, 0);
+  ledcWrite(LIGHT_CH_COOL, 0);
+}
+
+void lightSet(LightLevels to, uint16_t ms) {
+  LightGuard g;
+  LampState s = lampFromLevels(to);
+  if (s.on) lamp = s;
+  else lamp.on = false; // keep brightness and mix for the next power-on
+  setLocked(to, ms);
+}
+
+void lightService() {
+  LightGuard g;
+  if (fadeMs == 0) return;
+  uint32_t t = millis() - fadeStartMs;
+  if (t >= fadeMs) {
+    fadeMs = 0;
+    write(target);
+    return;
+  }
+  LightLevels l;
+  l.warm = lerp(fadeFrom.warm, target.warm, t, fadeMs);
+  l.cool = lerp(fadeFrom.cool, target.cool, t, fadeMs);
+  write(l);
+}
+
+LightLevels lightTarget() {
+  LightGuard g;
+  return target;
+}
+
+LightLevels lightOutput() {
+  LightGuard g;
+  return output;
+}
+
+bool lightIsOn() {
+  LightGuard g;
+  return lamp.on;
+}
+
+LampState lampGet() {
+  LightGuard g;
+  return lamp;
+}
+
+void lampPatch(const LampPatch &p, uint16_t ms) {
+  LightGuard g;
+  if (p.mask & LAMP_ON) lamp.on = p.on;
+  if (p.mask & LAMP_BRIGHTNESS) lamp.brightness = p.brightness;
+  if (p.mask & LAMP_MIX) lamp.mix = p.mix;
+  setLocked(lampLevels(lamp), ms);
+}
+
+bool lampToggle(uint16_t ms) {
+  LightGuard g;
+  lamp.on = !lamp.on;
+  setLocked(lampLevels(lamp), ms);
+  return lamp.on;
+}
+
+uint16_t lampStep(int32_t delta, uint16_t minBrightness, uint16_t ms) {
+  LightGuard g;
+  int32_t b = (int32_t)lamp.brightness + delta;
+  lamp.brightness = b < minBrightness ? minBrightness : (b > 65535 ? 65535 : b);
+  lamp.on = true;
+  setLocked(lampLevels(lamp), ms);
+  return lamp.brightness;
+}
+
+LightLevels lampLevels(const LampState &s) {
+  LightLevels l = {0, 0};
+  if (!s.on) return l;
+  uint32_t wf = min(65535UL, 2UL * (65535UL - s.mix));
+  uint32_t cf = min(65535UL, 2UL * s.mix);
+  l.warm = (uint32_t)s.brightness * wf / 65535;
+  l.cool = (uint32_t)s.brightness * cf / 65535;
+  return l;
+}
+
+LampState lampFromLevels(LightLevels l) {
+  LampState s = {l.warm != 0 || l.cool != 0, 0, 32768};
+  if (!s.on) return s;
+  if (l.warm >= l.cool) {
+    s.brightness = l.warm;
+    s.mix = ((uint32_t)l.cool * 65535 / l.warm + 1) / 2;
+  } else {
+    s.brightness = l.cool;
+    s.mix = 65535 - ((uint32_t)l.warm * 65535 / l.cool + 1) / 2;
+  }
+  return s;
+}
+
+LampRestore lightRestore() {
+  LampState s = {true, 65535, 32768};
+  LampRestore from = LampRestore::DEFAULT_ON;
+  if (rtcLamp.magic == LAMP_RECORD_MAGIC && rtcLamp.check == recordCheck(rtcLamp.lamp)) {
+    s = rtcLamp.lamp; // soft reset: carry on exactly as before
+    from = LampRestore::RTC;
+    // what NVS holds is read later by lightPersistService(), off the boot path
+  } else {
+    if (readSaved(&s)) from = LampRestore::NVS;
+    s.on = true; // power came back: someone flipped the wall switch on
+    // compared against the lamp as restored: a stored "off" is never used, so
+    // keeping it is no reason to write NVS on every power-on
+    savedLamp = s;
+    savedLampRead = true;
+  }
+  LightGuard g;
+  lamp = s;
+  setLocked(lampLevels(lamp), 0);
+  return from;
+}
+
+void lightPersistService() {
+  if (!savedLampRead) {
+    // after a soft reset: NVS may match the RTC copy already, or be up to
+    // LAMP_SAVE_DELAY_MS behind it; compare instead of rewriting every boot
+    LampState stored;
+    if (readSaved(&stored)) savedLamp = stored;
+    savedLampRead = true;
+  }
+  LampState now;
+  {
+    LightGuard g;
+    if (sameLamp(lamp, savedLamp) || millis() - changedMs < LAMP_SAVE_DELAY_MS) return;
+    now = lamp;
+  }
+  // outside the lock: an NVS write takes milliseconds and the button must not wait for it
+  if (!prefsOpen) prefsOpen = lampPrefs.begin("lamp", false);
+  uint8_t b[5] = {(uint8_t)now.on, (uint8_t)now.brightness, (uint8_t)(now.brightness >> 8),
+                  (uint8_t)now.mix, (uint8_t)(now.mix >> 8)};
+  if (prefsOpen && lampPrefs.putBytes("state", b, sizeof(b)) == sizeof(b)) savedLamp = now;
+}
+
+const char* lampRestoreName(LampRestore r) {
+  switch (r) {
+    case LampRestore::RTC: return "RTC";
+    case LampRestore::NVS: return "NVS";
+    case LampRestore::DEFAULT_ON: return "DEFAULT";
+  }
+  return "?";
+}
@@ -0,0 +1,136 @@
+#include "local_control.h"
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "board.h"
+#include "light.h"
+
+const UBaseType_t LOCAL_TASK_PRIORITY = 19; // above lwIP (18) and loop() (1), below the Wi-Fi task (23)
+const uint32_t LOCAL_RAMP_STEP_MS = 20;
+const int32_t LOCAL_RAMP_STEP = 520;         // full range in about 2.5 s
+const uint16_t LOCAL_RAMP_MIN = 1000;        // dimming stops short of off
+const uint16_t LOCAL_FADE_MS = 0;            // on/off is a step; the first duty write is the response
+
+static uint8_t buttonPin = 0;
+static TaskHandle_t task = nullptr;
+static portMUX_TYPE edgeMux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t edgeUs = 0;  // written by the ISR under edgeMux
+static int edgeLevel = HIGH;
+static uint32_t edgeSeq = 0;
+
+static LocalControlStats stats = {0, 0, 0, 0, 0, 0};
+static uint64_t totalUs = 0;
+
+static void record(int64_t fromUs) {
+  uint32_t us = (uint32_t)(esp_timer_get_time() - fromUs);
+  stats.actions++;
+  stats.lastUs = us;
+  if (us > stats.maxUs) stats.maxUs = us;
+  if (us > LOCAL_BUDGET_US) stats.overBudget++;
+  totalUs += us;
+  stats.avgUs = (uint32_t)(totalUs / stats.actions);
+}
+
+static void localTask(void *arg) {
+  const int64_t debounceUs = (int64_t)LOCAL_DEBOUNCE_MS * 1000;
+  const int64_t holdUs = (int64_t)LOCAL_HOLD_MS * 1000;
+  uint32_t seenSeq = 0;
+  bool down = false;
+  bool turnedOn = false; // this press switched the lamp on; its release does nothing
+  bool ramping = false;
+  int32_t dir = 1;
+  int64_t acceptedUs = -debounceUs;
+  int64_t downUs = 0;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, down ? pdMS_TO_TICKS(LOCAL_RAMP_STEP_MS) : portMAX_DELAY);
+
+    portENTER_CRITICAL(&edgeMux);
+    uint32_t seq = edgeSeq;
+    int level = edgeLevel;
+    int64_t us = edgeUs;
+    portEXIT_CRITICAL(&edgeMux);
+
+    bool release = false;
+    int64_t releaseUs = 0;
+    if (seq != seenSeq) {
+      seenSeq = seq;
+      bool isDown = level == LOW;
+      if (isDown != down && us - acceptedUs >= debounceUs) {
+        acceptedUs = us;
+        if (isDown) {
+          down = true;
+          downUs = us;
+          ramping = false;
+          turnedOn = !lightIsOn();
+          if (turnedOn) {
+            lampToggle(LOCAL_FADE_MS);
+            record(us);
+          }
+        } else {
+          release = true;
+          releaseUs = us;
+        }
+      }
+    }
+
+    int64_t now = esp_timer_get_time();
+    // a release lost in the debounce window: the pin is the truth
+    if (down && !release && now - acceptedUs >= debounceUs && digitalRead(buttonPin) != LOW) {
+      acceptedUs = now;
+      release = true;
+      releaseUs = now;
+    }
+
+    if (release) {
+      down = false;
+      if (!ramping && !turnedOn) {
+        lampToggle(LOCAL_FADE_MS);
+        record(releaseUs);
+      }
+      ramping = false;
+      continue;
+    }
+
+    if (down && !ramping && now - downUs >= holdUs) {
+      ramping = true;
+      stats.holds++;
+      LampState l = lampGet();
+      if (l.brightness >= 65535) dir = -1;
+      else if (l.brightness <= LOCAL_RAMP_MIN) dir = 1;
+      else dir = -dir;
+    }
+    if (ramping) {
+      uint16_t b = lampStep(dir * LOCAL_RAMP_STEP, LOCAL_RAMP_MIN, 0); // no fade: those advance in loop()
+      if (b >= 65535 || b <= LOCAL_RAMP_MIN) dir = -dir; // bounce off the ends while held
+    }
+  }
+}
+
+void localControlBegin(uint8_t pin) {
+  buttonPin = pin;
+  if (Board::CORES > 1) {
+    // beside loop(), which it preempts; the Wi-Fi task lives on the other core
+    xTaskCreatePinnedToCore(localTask, "local_ctl", 2048, nullptr, LOCAL_TASK_PRIORITY, &task, ARDUINO_RUNNING_CORE);
+  } else {
+    xTaskCreate(localTask, "local_ctl", 2048, nullptr, LOCAL_TASK_PRIORITY, &task);
+  }
+}
+
+void IRAM_ATTR localControlEdgeFromISR(int level) {
+  if (task == nullptr) return;
+  portENTER_CRITICAL_ISR(&edgeMux);
+  edgeUs = esp_timer_get_time();
+  edgeLevel = level;
+  edgeSeq++;
+  portEXIT_CRITICAL_ISR(&edgeMux);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(task, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+LocalControlStats localControlStats() {
+  return stats;
+}
@@ -1,12 +1,12 @@
 /*
 ESP32 Mode 01 (Fresh Device) — Implementation Spec with Pinout
 
-Pinout (current)
+Pinout (esp32doit-devkit-v1; ESP32-C3/S3 pins are in include/board.h)
 
 const uint8_t LED_01 = 22; // Status LED A (primary state indicator)
 const uint8_t LED_02 = 23; // Status LED B (secondary / double-blink)
 const uint8_t PUSH_01 = 19; // Factory reset button (hold >10s)
-const uint8_t PUSH_02 = 18; // Reserved (future: manual AP trigger or diagnostics)
+const uint8_t PUSH_02 = 18; // Lamp button (gestures below)
 
 LED behavior
 
@@ -17,7 +17,18 @@ Connected: LED_01 solid ON; LED_02 OFF.
 Button behavior
 
 PUSH_01 (factory reset): long-press >10s triggers full wipe of credentials (ssid/pass/provisioned) then reboot.
-PUSH_02: reserve for manual AP toggle or diagnostics; leave as INPUT with pull-up for now.
+PUSH_02: lamp. Click = on/off, hold = dim up/down (both handled locally, see
+include/local_control.h, and work in every RunState), double click = next scene.
+
+Local API
+
+Once the portal closes, the same HTTP server stays up on the station
+interface with the control routes only: /status, /metrics, /light, /scenes,
+/config. It holds at most API_MAX_CONNS connections, so it needs no RAM
+beyond what the portal already had. POST /light is the batched call: any of
+power, brightness, color (the warm/cool mix) and transition_ms in one request.
+GET /light?since=<v> returns only the attributes changed after version v,
+and with wait=1 holds the request up to LIGHT_WAIT_MS until one changes.
 
 Constants
 
@@ -29,7 +40,7 @@ const uint32_t CONNECT_TIMEOUT_MS = 10000; // 10s per attempt
 AP SSID template: "ModuLux-Setup-XXXX" // XXXX = last 4 hex of MAC
 AP_PASS: "modulux-setup"
 Static AP net: IP 192.168.4.1 / 24, GW 192.168.4.1
-AP_IDLE_TIMEOUT_MS: 10601000 (10 min)
+AP_IDLE_TIMEOUT_MS: 600000 (10 min)
 
 NVS keys
 
@@ -54,25 +65,78 @@ Startup sequence and all behavior implemented below.
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
-#include <DNSServer.h>
 #include <Preferences.h>
-
-#define DEBUG
-
-// Pinout
-const uint8_t LED_01 = 22; // Status LED A
-const uint8_t LED_02 = 23; // Status LED B
-const uint8_t PUSH_01 = 19; // Factory reset
-const uint8_t PUSH_02 = 18; // Reserved
+#include <esp_timer.h>
+#include <esp_wifi.h>
+
+#include "captive_dns.h"
+#include "coalescer.h"
+#include "config.h"
+#include "coro.h"
+#include "energy.h"
+#include "event_bus.h"
+#include "light.h"
+#include "local_control.h"
+#include "portal_input.h"
+#include "portal_server.h"
+#include "profile.h"
+#include "retry_policy.h"
+#include "retry_rules.h"
+#include "run_table.h"
+#include "scan_results.h"
+#include "scenes.h"
+#include "state_delta.h"
+#include "state_machine.h"
+#include "trace.h"
+#include "watchdog.h"
+
+// Pinout (fixed entries of include/config.h)
+const uint8_t LED_01 = cfgDefault<Cfg::PIN_LED_01>(); // Status LED A
+const uint8_t LED_02 = cfgDefault<Cfg::PIN_LED_02>(); // Status LED B
+const uint8_t PUSH_01 = cfgDefault<Cfg::PIN_PUSH_01>(); // Factory reset
+const uint8_t PUSH_02 = cfgDefault<Cfg::PIN_PUSH_02>(); // Lamp button
 
 // Constants
 const char* DUMMY_SSID = "DummY";
 const char* DUMMY_PASS = "dummy001";
-const uint8_t MAX_RETRIES = 5;
-const uint32_t CONNECT_TIMEOUT_MS = 10000;
 const char* AP_PASS = "modulux-setup";
-const uint32_t AP_IDLE_TIMEOUT_MS = 10601000UL; // 10 min-ish as spec
+// Retries, timeouts, blink timings: include/config.h (overridable via /config)
+const uint32_t IDLE_CHECK_MS = 1000; // how often the portal flow re-checks the idle timeout
+// true: bring the AP up at once in AP+STA and retry the station in the
+// background instead of trying it first with the portal down
+const bool CONCURRENT_BOOT = false;
+// Boot planner: station budget after consecutive failed boots (NVS "bootfail")
+const uint8_t SHORT_BOOT_RETRIES = 2;  // after 1-2 failed boots
+const uint8_t MIN_BOOT_RETRIES = 1;    // after 3 or more
+const uint8_t BOOT_FAIL_SHORT_AFTER = 1;
+const uint8_t BOOT_FAIL_MIN_AFTER = 3;
+
+// Watchdog deadlines (see include/watchdog.h). Connect attempts run as
+// coroutines, so every subsystem is serviced on each loop() pass and the
+// deadlines only cover slow driver calls (softAP start, mode switches).
+const uint32_t WDT_TIMEOUT_S = 10;
+const uint32_t WDT_NETWORK_DEADLINE_MS = 5000;
+const uint32_t WDT_HTTP_DEADLINE_MS = 5000;
+const uint32_t WDT_DNS_DEADLINE_MS = 5000;
+const uint32_t WDT_LED_DEADLINE_MS = 5000;
+const uint32_t WDT_BUTTONS_DEADLINE_MS = 5000;
+
+const uint8_t SCAN_TOP_K = 20; // strongest distinct SSIDs returned by /scan
+const uint32_t SCAN_DWELL_MS = 120; // active scan time per channel
+const uint32_t SCAN_CACHE_MS = 30000; // /scan?start=1 reuses a result younger than this
+// Progressive scan order: the common non-overlapping channels first
+const uint8_t SCAN_CHANNELS[] = {1, 6, 11, 2, 3, 4, 5, 7, 8, 9, 10, 12, 13};
+const uint8_t SCAN_CHANNEL_COUNT = sizeof(SCAN_CHANNELS) / sizeof(SCAN_CHANNELS[0]);
+
+// PUSH_02 gestures seen by loop(); click and hold act in the local control task,
+// so the timings match its own
+const uint32_t GESTURE_DEBOUNCE_MS = LOCAL_DEBOUNCE_MS;
+const uint32_t GESTURE_DOUBLE_MS = 350; // a second click within this makes a double click
+const uint32_t GESTURE_HOLD_MS = LOCAL_HOLD_MS;
+const uint16_t LIGHT_OFF_FADE_MS = 500;
+
+// Lamp commands from the network are coalesced to one output update per frame
+const uint32_t OUTPUT_FRAME_MS = 20; // 50 Hz; each update fades over one frame
 
 // Static AP config
 const IPAddress AP_IP(192,168,4,1);
@@ -84,13 +148,13 @@ Preferences prefs;
 const char* NVS_NAMESPACE = "wifi";
 
 // DNS and HTTP
-DNSServer dnsServer;
-WebServer server(80);
+CaptiveDns dnsServer; // see include/captive_dns.h
+PortalServer server(80); // keep-alive; see include/portal_server.h
+const uint8_t API_MAX_CONNS = 2; // station API; each open socket holds lwIP buffers
 const byte DNS_PORT = 53;
 
 // Runtime
-enum class RunState { CONNECTING, AP_SETUP, CONNECTED };
-volatile RunState runState = RunState::CONNECTING;
+RunState runState = RunState::CONNECTING; // written only by runFsm (loop task)
 
 String currentSsid;
 String currentPass;
@@ -111,15 +175,141 @@ enum class SetupPhase { IDLE, BLINK1_ON, BLINK1_OFF, BLINK2_ON, BLINK2_OFF, PAUS
 SetupPhase setupPhase = SetupPhase::PAUSE;
 unsigned long setupPhaseStartMs = 0;
 
-// For scheduled AP shutdown
-unsigned long apShutdownAt = 0; // 0 = no scheduled shutdown
+// Last scan, deduped by SSID and trimmed to the strongest SCAN_TOP_K
+ScanTopK<SCAN_TOP_K> scanResults;
+int8_t scanStep = -1; // index into SCAN_CHANNELS being scanned, -1 = idle
+unsigned long scanFinishedAt = 0; // 0 = no complete scan yet
+
+// Captive AP (DNS + HTTP) is up; stays up for ap_shutdown_ms after connecting
+bool apActive = false;
+// Local API on the station interface is up (the portal has closed)
+bool apiActive = false;
+
+// /status snapshot, rebuilt only when runState changes or the station gets
+// an address. The ETag is "<bootId>-<version>" so a cached tag from a
+// previous boot never matches.
+String statusJson;
+String statusEtag;
+uint32_t statusVersion = 0; // 0 = not built yet
+uint32_t statusBootId = 0;
+RunState statusBuiltFor = RunState::CONNECTING;
+bool statusStale = false; // GOT_IP: "ip" may differ with runState unchanged
+
+// Station connect outcome, classified from the driver's disconnect reason
+enum class ConnectResult { OK, WRONG_PASSWORD, NO_AP, TIMEOUT };
+uint8_t lastDisconnectReason = 0; // WIFI_REASON_*, 0 = none since last begin()
+
+// Boot plan, chosen in setup() from the persisted provisioning state
+enum class BootPlan { PORTAL, STATION_FULL, STATION_SHORT, CONCURRENT };
+BootPlan bootPlan = BootPlan::PORTAL;
+bool provisioned = false;
+uint8_t bootRetries = cfgDefault<Cfg::MAX_RETRIES>(); // station attempts this boot
+uint8_t bootFailHistory = 0;        // consecutive failed boots before this one
+uint8_t bootFailStored = 0;         // value currently in NVS
+bool bootFailRecorded = false;
+
+// Coroutine events (see include/coro.h)
+const uint32_t EV_STA_GOT_IP = 1 << 0;       // Wi-Fi event task
+const uint32_t EV_STA_DISCONNECTED = 1 << 1; // Wi-Fi event task
+const uint32_t EV_SCAN_STARTED = 1 << 2;     // a portal scan took the radio
+const uint32_t EV_SAVE = 1 << 3;             // /save deferred a request
+const uint32_t EV_STATION_DONE = 1 << 4;     // station coroutine finished
+
+// Station connect: up to maxAttempts with per-class backoff from rules,
+// using currentSsid/currentPass. Started with startStation().
+struct StationFrame : CoroFrame {
+  RetryPolicy policy{BOOT_RETRY_RULES};
+  uint8_t maxAttempts = 0;
+  uint8_t attempt = 0;
+  bool keepAp = false; // AP+STA, leave the softAP alone
+  uint8_t reason = 0;
+  FailClass cls = FailClass::CONNECT_TIMEOUT;
+  int32_t backoff = 0;
+  unsigned long deadline = 0;
+  ConnectResult result = ConnectResult::TIMEOUT; // valid once finished
+};
+StationFrame station;
+
+// What the provisioning flow is running the station coroutine for
+enum class StationJob : uint8_t { NONE, BOOT, BACKGROUND, IDLE_RETRY, SAVE };
+
+// Provisioning: boot connect -> portal -> /save or retries -> AP shutdown
+struct ProvisionFrame : CoroFrame {
+  StationJob job = StationJob::NONE;
+};
+ProvisionFrame provision;
+
+// Deferred /save request, answered by the provisioning flow
+uint32_t saveTicket = 0; // 0 = none pending
+unsigned long saveStartedMs = 0;
+
+// Connect statistics since boot, served on /metrics
+uint32_t bootLightUs = 0; // esp_timer at the restored output write (excludes ROM + bootloader)
+LampRestore bootLightFrom = LampRestore::DEFAULT_ON;
+unsigned long bootPortalMs = 0;    // millis() when the AP came up, 0 = never
+unsigned long bootConnectedMs = 0; // millis() of the first station connect, 0 = never
+uint16_t connectSuccesses = 0;
+uint16_t connectFailures[FAIL_CLASS_COUNT] = {0};
+uint8_t lastFailReason = 0;
+
+// PUSH_02 gesture state, debounced (see buttonsOnEvent / pollGesture)
+enum class Gesture : uint8_t { NONE, CLICK, DOUBLE_CLICK, HOLD };
+bool push02Down = false;
+unsigned long push02EdgeMs = 0; // last accepted edge
+uint8_t push02Clicks = 0;       // releases not yet turned into a gesture
+bool push02HoldFired = false;
+
+// Lamp attributes as apps set them; /light submits, serviceLampInput() applies
+enum class LampAttr : uint8_t { POWER, BRIGHTNESS, MIX, TRANSITION, COUNT };
+const size_t LAMP_ATTR_COUNT = (size_t)LampAttr::COUNT;
+Coalescer<LAMP_ATTR_COUNT> lampInput;
+unsigned long lampFrameMs = 0; // last output frame that applied commands
+
+// Lamp state as reported on GET /light; versions let a subscriber fetch only changes
+enum class ReportAttr : uint8_t { ON, BRIGHTNESS, MIX, SCENE, COUNT };
+const size_t REPORT_ATTR_COUNT = (size_t)ReportAttr::COUNT;
+const uint32_t LIGHT_WAIT_MS = 25000; // long-poll answered empty after this
+DeltaTracker<REPORT_ATTR_COUNT> lightReport;
+// One parked long-poll at a time: it holds one of the server's connections
+uint32_t lightWaitTicket = 0; // 0 = none
+uint32_t lightWaitSince = 0;
+unsigned long lightWaitStartMs = 0;
+// Report body sizes for /metrics, full state vs changes only
+uint32_t reportsFull = 0;
+uint32_t reportsFullBytes = 0;
+uint32_t reportsDelta = 0;
+uint32_t reportsDeltaBytes = 0;
+
+// Scene recall statistics, served on /metrics. recall*Us is lookup plus
+// output write; gestureMs is the gesture's last edge to output.
+int8_t activeScene = -1; // -1 = none since boot, or lamp changed since the recall
+LampState sceneLamp;     // the lamp as the last recall left it
+uint32_t sceneRecalls = 0;
+uint32_t recallLastUs = 0;
+uint32_t recallMaxUs = 0;
+uint32_t recallTotalUs = 0;
+uint32_t gestureMs = 0;
 
 // Forward declarations
 void loadCredentialsFromNVS();
-bool tryConnectStation(const String &ssid, const String &pass, uint8_t maxRetries, uint32_t timeoutMs);
-void startCaptiveAP();
+BootPlan planBoot();
+const char* bootPlanName(BootPlan plan);
+void recordBootFailure();
+void startStation(uint8_t maxAttempts, const RetryTable &rules, bool keepAp);
+void cancelStation();
+bool stationStep(StationFrame &f);
+bool provisionStep(ProvisionFrame &f);
+void answerSave(ConnectResult result);
+void startCaptiveAP(wifi_mode_t mode = WIFI_AP);
 void stopCaptiveAP();
+void registerControlRoutes();
+void startLocalApi();
 String last4MacHex();
+void startProgressiveScan();
+void serviceScan();
+void cancelScan();
+void foldScanResults(int n);
+String buildScanJson();
 void saveCredentialsToNVS(const String &ssid, const String &pass);
 void performFactoryReset();
 void showSetupPattern();
@@ -129,8 +319,51 @@ void handleRoot();
 void handleScan();
 void handleSave();
 void handleStatus();
+void refreshStatusSnapshot();
 void factoryResetCheck();
-bool tryConnectWhileAp(const String &ssid, const String &pass, uint8_t maxRetries, uint32_t timeoutMs);
+void recordConnectSuccess();
+void recordConnectFailure(FailClass cls, uint8_t reason);
+ConnectResult connectResultFor(FailClass cls);
+const char* connectResultName(ConnectResult r);
+void handleMetrics();
+void handleConfigGet();
+void handleConfigPost();
+#ifdef TRACE_RECORD
+void handleTrace();
+#endif
+void appendCoroStats(String &s, const char *name, const CoroFrame &f, size_t frameSize);
+RadioMode currentRadioMode();
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+void onPush01Change();
+void onPush02Change();
+Gesture pollGesture();
+void serviceSceneButton();
+bool recallScene(uint8_t i);
+void lampOff();
+void serviceLampInput();
+void handleLightGet();
+void handleLightPost();
+String buildLightJson(uint32_t mask);
+void trackLightReport();
+void trackActiveScene();
+void serviceLightWait();
+uint32_t parseReportVersion(const String &v);
+uint32_t bootId();
+void handleScenesGet();
+void handleScenesPost();
+String buildScenesJson();
+void connectionOnEvent(const Event &e);
+void httpOnEvent(const Event &e);
+void buttonsOnEvent(const Event &e);
+void onRunStateChange(RunState from, RunState to);
+const char* runStateName(RunState s);
+const char* runEventName(RunEvent e);
+
+// Event subscribers, in dispatch order (see include/event_bus.h)
+typedef EventHandlers<traceOnEvent, connectionOnEvent, httpOnEvent, buttonsOnEvent> Subscribers;
+
+// RunState transitions: see include/run_table.h
+StateMachine<RunState, RunEvent, RunTable> runFsm(runState, runStateName, runEventName, onRunStateChange);
 
 // Minimal HTML page
 const char indexPage[] PROGMEM = R"rawliteral(
@@ -158,7 +391,9 @@ const char indexPage[] PROGMEM = R"rawliteral(
 
 <script>
 function fetchStatus(){fetch('/status').then(r=>r.json()).then(j=>{document.getElementById('status').innerText='Status: '+j.state+(j.ip?(' IP: '+j.ip):'')});}
-function doScan(){fetch('/scan').then(r=>r.json()).then(list=>{const dl=document.getElementById('ssids');dl.innerHTML='';list.forEach(function(it){let opt=document.createElement('option');opt.value=it.ssid;dl.appendChild(opt);});});}
+function showNets(list){const dl=document.getElementById('ssids');dl.innerHTML='';list.forEach(function(it){let opt=document.createElement('option');opt.value=it[0];opt.label=it[3]+' ch'+it[2]+' '+it[1]+'dBm';dl.appendChild(opt);});}
+function pollScan(url){fetch(url).then(r=>r.json()).then(j=>{showNets(j.nets);if(!j.done)setTimeout(function(){pollScan('/scan');},300);});}
+function doScan(){pollScan('/scan?start=1');}
 function doSave(){const ss=document.getElementById('ssid').value;const pw=document.getElementById('pass').value;fetch('/save',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:'ssid='+encodeURIComponent(ss)+'&pass='+encodeURIComponent(pw)}).then(r=>r.text()).then(t=>{alert(t);});}
 document.getElementById('scan').addEventListener('click',doScan);
 document.getElementById('submit').addEventListener('click',doSave);
@@ -169,11 +404,18 @@ setInterval(fetchStatus,1000);
 )rawliteral";
 
 void setup() {
+  // Lamp first: a bulb has to light up when the wall switch goes on, before
+  // Serial, NVS config and Wi-Fi get their turn
+  lightBegin();
+  bootLightFrom = lightRestore();
+  bootLightUs = esp_timer_get_time();
+
   // Serial for debug (optional)
 #ifdef DEBUG
   Serial.begin(115200);
   delay(10);
   Serial.println("ModuLux setup start");
+  Serial.printf("Lamp restored from %s at %lu us\n", lampRestoreName(bootLightFrom), (unsigned long)bootLightUs);
 #endif
 
   pinMode(LED_01, OUTPUT);
@@ -182,68 +424,87 @@ void setup() {
   digitalWrite(LED_02, LOW);
   pinMode(PUSH_01, INPUT_PULLUP);
   pinMode(PUSH_02, INPUT_PULLUP);
+  localControlBegin(PUSH_02);
+
+  watchdogBegin(WDT_TIMEOUT_S);
+  watchdogRegister(Subsystem::NETWORK, WDT_NETWORK_DEADLINE_MS);
+  watchdogRegister(Subsystem::LED, WDT_LED_DEADLINE_MS);
+  watchdogRegister(Subsystem::BUTTONS, WDT_BUTTONS_DEADLINE_MS);
+#ifdef DEBUG
+  Subsystem wdtCulprit;
+  uint32_t wdtGapMs;
+  if (watchdogLastReset(&wdtCulprit, &wdtGapMs)) {
+    Serial.printf("Previous boot reset by watchdog: %s stalled %lu ms\n", subsystemName(wdtCulprit), (unsigned long)wdtGapMs);
+  }
+#endif
 
   prefs.begin(NVS_NAMESPACE, false);
+  configBegin();
+  energyBegin();
+  scenesBegin();
+#ifdef DEBUG
+  Serial.printf("Config token (POST /config): %s\n", configToken().c_str());
+#endif
+
+  WiFi.onEvent(onWiFiEvent);
+  attachInterrupt(digitalPinToInterrupt(PUSH_01), onPush01Change, CHANGE);
+  if (digitalRead(PUSH_01) == LOW) onPush01Change(); // held since power-on: no edge to catch
+  attachInterrupt(digitalPinToInterrupt(PUSH_02), onPush02Change, CHANGE);
 
   loadCredentialsFromNVS();
 
-  runState = RunState::CONNECTING;
-  showConnectingPattern();
+  bootPlan = planBoot();
+  traceBegin((uint8_t)bootPlan, bootFailHistory);
+#ifdef DEBUG
+  Serial.printf("Boot plan: %s (%u failed boots before, %u STA attempts)\n",
+                bootPlanName(bootPlan), bootFailHistory, bootRetries);
+  Serial.printf("Coroutine frames: provision %u B, station %u B\n",
+                (unsigned)sizeof(ProvisionFrame), (unsigned)sizeof(StationFrame));
+#endif
 
-  bool ok = tryConnectStation(currentSsid, currentPass, MAX_RETRIES, CONNECT_TIMEOUT_MS);
-  if (ok) {
-    runState = RunState::CONNECTED;
-    showConnected();
-    // optional services like mDNS can be started here later
-  } else {
-    // start AP provisioning
-    startCaptiveAP();
-    runState = RunState::AP_SETUP;
-  }
+  // the rest of the boot runs as the provisioning coroutine from loop()
+  coroStart(provision);
 }
 
 void loop() {
+  // Events from the Wi-Fi task and ISRs
+  eventDrain<Subscribers>();
+
   // LED patterns update
   if (runState == RunState::AP_SETUP) showSetupPattern();
   else if (runState == RunState::CONNECTING) showConnectingPattern();
   else if (runState == RunState::CONNECTED) showConnected();
-
-  // If AP is active, handle DNS + HTTP
-  if (runState == RunState::AP_SETUP) {
+  watchdogKick(Subsystem::LED);
+
+  // Lamp: scene button gestures and fades
+  serviceSceneButton();
+  serviceLampInput();
+  lightService();
+  lightPersistService();
+  trackLightReport();
+  serviceLightWait();
+
+  // If AP is active (incl. the grace period before shutdown), handle DNS + HTTP
+  if (apActive) {
     dnsServer.processNextRequest();
+    watchdogKick(Subsystem::DNS);
     server.handleClient();
-    if (millis() - lastHttpActivityMs > AP_IDLE_TIMEOUT_MS) {
-#ifdef DEBUG
-      Serial.println("AP idle timeout reached, attempting single STA retry");
-#endif
-      // Idle timeout reached, attempt a single STA retry while keeping AP up
-      lastHttpActivityMs = millis();
-      if (tryConnectWhileAp(currentSsid, currentPass, 1, CONNECT_TIMEOUT_MS)) {
-        runState = RunState::CONNECTED;
-        showConnected();
-        // Do not stop AP immediately; rely on scheduled apShutdownAt if set
-        apShutdownAt = millis() + 40000UL;
-#ifdef DEBUG
-        Serial.printf("Connected after idle retry, scheduled AP shutdown at %lu\n", apShutdownAt);
-#endif
-      } else {
-#ifdef DEBUG
-        Serial.println("Idle retry failed, remaining in AP_SETUP");
-#endif
-      }
-    }
+    watchdogKick(Subsystem::HTTP);
+    serviceScan();
+  } else if (apiActive) {
+    server.handleClient();
+    watchdogKick(Subsystem::HTTP);
   }
 
-  // If connected and AP was scheduled to shut down, perform shutdown when time reached
-  if (runState == RunState::CONNECTED && apShutdownAt != 0 && millis() >= apShutdownAt) {
-#ifdef DEBUG
-    Serial.println("AP shutdown time reached, stopping captive AP");
-#endif
-    stopCaptiveAP();
-    apShutdownAt = 0;
-  }
+  // Provisioning and station connect; each step returns at its next await
+  coroRun(provision, provisionStep);
+  coroRun(station, stationStep);
+  watchdogKick(Subsystem::NETWORK);
 
   factoryResetCheck();
+  watchdogKick(Subsystem::BUTTONS);
+
+  energyTick((uint8_t)runState, currentRadioMode());
 
   // small yield / low-power-friendly pause
   delay(20);
@@ -252,7 +513,7 @@ void loop() {
 // -- Implementation details --
 
 void loadCredentialsFromNVS() {
-  bool provisioned = prefs.getUChar("prov", 0);
+  provisioned = prefs.getUChar("prov", 0);
   if (provisioned) {
     currentSsid = prefs.getString("ssid", "");
     currentPass = prefs.getString("pass", "");
@@ -268,81 +529,406 @@ void loadCredentialsFromNVS() {
   }
 }
 
+// Pick the boot path from persisted state; sets bootRetries
+BootPlan planBoot() {
+  bootFailHistory = prefs.getUChar("bootfail", 0);
+  bootFailStored = bootFailHistory;
+  if (!provisioned) {
+    bootRetries = 0;
+    return BootPlan::PORTAL;
+  }
+  uint8_t maxRetries = cfg<Cfg::MAX_RETRIES>();
+  if (bootFailHistory >= BOOT_FAIL_MIN_AFTER) bootRetries = min(MIN_BOOT_RETRIES, maxRetries);
+  else if (bootFailHistory >= BOOT_FAIL_SHORT_AFTER) bootRetries = min(SHORT_BOOT_RETRIES, maxRetries);
+  else bootRetries = maxRetries;
+  if (CONCURRENT_BOOT) return BootPlan::CONCURRENT;
+  return bootFailHistory < BOOT_FAIL_SHORT_AFTER ? BootPlan::STATION_FULL : BootPlan::STATION_SHORT;
+}
+
+const char* bootPlanName(BootPlan plan) {
+  switch (plan) {
+    case BootPlan::PORTAL: return "PORTAL";
+    case BootPlan::STATION_FULL: return "STATION_FULL";
+    case BootPlan::STATION_SHORT: return "STATION_SHORT";
+    case BootPlan::CONCURRENT: return "CONCURRENT";
+  }
+  return "?";
+}
+
+// This boot's station budget ran out; counted once per boot
+void recordBootFailure() {
+  if (bootFailRecorded || !provisioned) return;
+  bootFailRecorded = true;
+  if (bootFailHistory < 255) {
+    bootFailStored = bootFailHistory + 1;
+    prefs.putUChar("bootfail", bootFailStored);
+  }
+}
+
 void saveCredentialsToNVS(const String &ssid, const String &pass) {
   prefs.putString("ssid", ssid);
   prefs.putString("pass", pass);
   prefs.putUChar("prov", 1);
+  provisioned = true;
+}
+
+void startStation(uint8_t maxAttempts, const RetryTable &rules, bool keepAp) {
+  station.policy = RetryPolicy(rules);
+  station.maxAttempts = maxAttempts;
+  station.keepAp = keepAp;
+  coroStart(station);
+}
+
+void cancelStation() {
+  if (!station.running) return;
+  coroStop(station);
+  WiFi.disconnect();
 }
 
-bool tryConnectStation(const String &ssid, const String &pass, uint8_t maxRetries, uint32_t timeoutMs) {
+// Station connect with retries. With keepAp the softAP stays up (AP+STA) and
+// WiFi.disconnect(true,true) is avoided since it may affect the AP.
+bool stationStep(StationFrame &f) {
+  CORO_BEGIN(f);
   // Do not print plaintext password in logs
 #ifdef DEBUG
-  Serial.printf("Attempting STA connect to '%s' (max %u retries)\n", ssid.c_str(), maxRetries);
+  Serial.printf("Attempting STA connect to '%s' (max %u attempts%s)\n",
+                currentSsid.c_str(), f.maxAttempts, f.keepAp ? ", AP kept up" : "");
 #endif
-  const uint32_t maxBackoffMs = 8000UL; // cap backoff
-  for (uint8_t attempt = 0; attempt < maxRetries; ++attempt) {
+  f.attempt = 0;
+  f.cls = FailClass::CONNECT_TIMEOUT;
+  while (f.attempt < f.maxAttempts) {
+    // a portal scan owns the radio; start the attempt once it is done
+    CORO_AWAIT(f, scanStep < 0);
+    if (f.keepAp) {
+      WiFi.mode(WIFI_AP_STA);
+    } else {
+      // disconnect fully including clearing stored configs
+      WiFi.disconnect(true, true);
+      CORO_SLEEP(f, 50);
+      WiFi.mode(WIFI_STA);
+    }
 #ifdef DEBUG
-    Serial.printf("STA attempt %u/%u\n", attempt + 1, maxRetries);
+    Serial.printf("STA attempt %u/%u\n", f.attempt + 1, f.maxAttempts);
 #endif
-    // disconnect fully including clearing stored configs
-    WiFi.disconnect(true, true);
-    delay(50);
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid.c_str(), pass.c_str());
+    lastDisconnectReason = 0;
+    coroTakeEvents(EV_STA_GOT_IP | EV_STA_DISCONNECTED | EV_SCAN_STARTED);
+    // the retry table decides when to try again; the core's own reconnect
+    // (after the first failure and on every reason >= 200) would go behind it
+    WiFi.setAutoReconnect(false);
+    WiFi.begin(currentSsid.c_str(), currentPass.c_str());
+
+    // Wait out the attempt: connected, a disconnect that counts as a
+    // failure, a scan taking the radio, or the timeout (reason 0)
+    f.deadline = millis() + cfg<Cfg::CONNECT_TIMEOUT_MS>();
+    f.reason = 0;
+    for (;;) {
+      CORO_AWAIT_EVENT(f, EV_STA_GOT_IP | EV_STA_DISCONNECTED | EV_SCAN_STARTED, f.deadline);
+      if (WiFi.status() == WL_CONNECTED || (f.events & EV_SCAN_STARTED) || f.events == 0) break;
+      if (lastDisconnectReason != 0 && classifyReason(lastDisconnectReason) != FailClass::NONE) {
+        f.reason = lastDisconnectReason;
+        break;
+      }
+    }
 
-    unsigned long start = millis();
-    while (millis() - start < timeoutMs) {
-      wl_status_t s = WiFi.status();
-      if (s == WL_CONNECTED) {
+    if (WiFi.status() == WL_CONNECTED) {
 #ifdef DEBUG
-        Serial.printf("Connected on attempt %u, IP: %s\n", attempt + 1, WiFi.localIP().toString().c_str());
+      Serial.printf("Connected on attempt %u, IP: %s\n", f.attempt + 1, WiFi.localIP().toString().c_str());
 #endif
-        return true;
-      }
-      delay(100);
+      recordConnectSuccess();
+      // a link lost from here on is the core's to bring back
+      WiFi.setAutoReconnect(true);
+      f.result = ConnectResult::OK;
+      coroPost(EV_STATION_DONE);
+      CORO_EXIT(f);
+    }
+    if (f.events & EV_SCAN_STARTED) {
+      // paused for the scan (which disconnected us); not counted
+      continue;
     }
+
+    f.cls = classifyReason(f.reason);
+    recordConnectFailure(f.cls, f.reason);
+    // per-class budget and backoff, see BOOT_RETRY_RULES / SAVE_RETRY_RULES
+    f.backoff = f.policy.onFailure(f.cls);
 #ifdef DEBUG
-    Serial.printf("STA attempt %u timed out\n", attempt + 1);
+    Serial.printf("STA attempt %u failed: %s (reason %u), next in %ld ms\n",
+                  f.attempt + 1, failClassName(f.cls), f.reason, (long)f.backoff);
 #endif
-    // capped exponential backoff before next attempt
-    uint32_t backoff = 1000UL << min<uint8_t>(attempt, 3); // 1s,2s,4s,8s
-    if (backoff > maxBackoffMs) backoff = maxBackoffMs;
-    delay(backoff);
+    f.attempt++;
+    if (f.backoff < 0 || f.attempt >= f.maxAttempts) break;
+    if (f.keepAp) WiFi.disconnect();
+    CORO_SLEEP(f, f.backoff);
   }
+  if (f.keepAp) WiFi.disconnect();
 #ifdef DEBUG
   Serial.println("Failed to connect as STA after retries");
 #endif
-  return false;
+  f.result = connectResultFor(f.cls);
+  coroPost(EV_STATION_DONE);
+  CORO_END(f);
 }
 
-// Try to connect STA without tearing down AP (use WIFI_AP_STA)
-bool tryConnectWhileAp(const String &ssid, const String &pass, uint8_t maxRetries, uint32_t timeoutMs) {
+void recordConnectSuccess() {
+  connectSuccesses++;
+  if (bootFailStored != 0) {
+    // only write NVS when there is a failure streak to clear
+    prefs.putUChar("bootfail", 0);
+    bootFailStored = 0;
+  }
+  if (bootConnectedMs == 0) {
+    bootConnectedMs = millis();
 #ifdef DEBUG
-  Serial.printf("Attempting STA connect while AP active to '%s'\n", ssid.c_str());
+    Serial.printf("Boot: connected at %lu ms\n", bootConnectedMs);
 #endif
-  // Keep AP up by selecting AP+STA mode
-  WiFi.mode(WIFI_AP_STA);
-  // Do not call WiFi.disconnect(true,true) here because that may affect AP
-  WiFi.begin(ssid.c_str(), pass.c_str());
+  }
+}
 
-  // Try for timeoutMs, optionally retrying once
-  unsigned long start = millis();
-  while (millis() - start < timeoutMs) {
-    if (WiFi.status() == WL_CONNECTED) {
+void recordConnectFailure(FailClass cls, uint8_t reason) {
+  connectFailures[(size_t)cls]++;
+  lastFailReason = reason;
+}
+
+// The provisioning flow, run from loop() for the whole boot
+bool provisionStep(ProvisionFrame &f) {
+  CORO_BEGIN(f);
+  if (bootPlan == BootPlan::STATION_FULL || bootPlan == BootPlan::STATION_SHORT) {
+    startStation(bootRetries, BOOT_RETRY_RULES, false);
+    CORO_AWAIT(f, !station.running);
+    if (station.result == ConnectResult::OK) {
+      runFsm.fire<RunEvent::STA_UP>();
+      // optional services like mDNS can be started here later
+      startLocalApi();
+      CORO_EXIT(f);
+    }
+    recordBootFailure();
+    // start AP provisioning
+    startCaptiveAP();
+  } else if (bootPlan == BootPlan::CONCURRENT) {
+    // portal first; the station is retried in the background and the AP
+    // goes away on its own once that succeeds
+    startCaptiveAP(WIFI_AP_STA);
+    startStation(bootRetries, BOOT_RETRY_RULES, true);
+    f.job = StationJob::BACKGROUND;
+  } else {
+    // never provisioned: nothing to join, go straight to setup
+    startCaptiveAP();
+  }
+
+  // Portal: wait for a /save, the background attempt, or the AP idle timeout
+  for (;;) {
+    CORO_AWAIT_EVENT(f, EV_SAVE | EV_STATION_DONE, millis() + IDLE_CHECK_MS);
+
+    if (saveTicket != 0) {
+      // the user's credentials replace any attempt with the old ones
+      cancelStation();
+      cancelScan();
+      startStation(cfg<Cfg::MAX_RETRIES>(), SAVE_RETRY_RULES, true);
+      f.job = StationJob::SAVE;
+      CORO_AWAIT(f, !station.running);
+      answerSave(station.result);
+      f.job = StationJob::NONE;
+      if (station.result == ConnectResult::OK) break;
+      continue; // stay in AP
+    }
+
+    if (f.job != StationJob::NONE && !station.running) {
+      if (station.result == ConnectResult::OK) break;
 #ifdef DEBUG
-      Serial.printf("Connected (AP+STA), IP: %s\n", WiFi.localIP().toString().c_str());
+      Serial.println(f.job == StationJob::IDLE_RETRY ? "Idle retry failed, remaining in AP_SETUP"
+                                                     : "Background connect gave up, remaining in AP_SETUP");
 #endif
-      return true;
+      // out of budget; the AP idle retry takes over from here
+      if (f.job == StationJob::BACKGROUND) recordBootFailure();
+      f.job = StationJob::NONE;
+      continue;
     }
-    delay(100);
+
+    if (f.job == StationJob::NONE && provisioned && millis() - lastHttpActivityMs > cfg<Cfg::AP_IDLE_TIMEOUT_MS>()) {
+#ifdef DEBUG
+      Serial.println("AP idle timeout reached, attempting single STA retry");
+#endif
+      // Idle timeout reached, attempt a single STA retry while keeping AP up
+      lastHttpActivityMs = millis();
+      startStation(1, SAVE_RETRY_RULES, true);
+      f.job = StationJob::IDLE_RETRY;
+    }
+  }
+
+  runFsm.fire<RunEvent::STA_UP>();
+  // Do not stop AP immediately; give the page time to show the result
+#ifdef DEBUG
+  Serial.printf("Connected, IP: %s, AP shutdown in %lu ms\n",
+                WiFi.localIP().toString().c_str(), (unsigned long)cfg<Cfg::AP_SHUTDOWN_DELAY_MS>());
+#endif
+  CORO_SLEEP(f, cfg<Cfg::AP_SHUTDOWN_DELAY_MS>());
+#ifdef DEBUG
+  Serial.println("AP shutdown time reached, stopping captive AP");
+#endif
+  stopCaptiveAP();
+  startLocalApi();
+  CORO_END(f);
+}
+
+// Reply to the deferred /save request with the outcome of its connect attempt
+void answerSave(ConnectResult result) {
+#ifdef DEBUG
+  Serial.printf("HTTP /save -> %s after %lu ms\n", connectResultName(result), millis() - saveStartedMs);
+#endif
+  if (result == ConnectResult::OK) {
+    String ip = WiFi.localIP().toString();
+    // plain text: the SSID is user input and must not be rendered as markup
+    server.respond(saveTicket, 200, "text/plain", String("Connected to ") + currentSsid + " IP: " + ip + "\n");
+  } else if (result == ConnectResult::WRONG_PASSWORD) {
+    // not 401: that is about this request's own credentials and needs a
+    // WWW-Authenticate challenge; the form was fine, the access point said no
+    server.respond(saveTicket, 422, "text/plain", "Wrong password, please try again.");
+  } else if (result == ConnectResult::NO_AP) {
+    server.respond(saveTicket, 404, "text/plain", "Network not found. Check the name or move closer.");
+  } else {
+    server.respond(saveTicket, 500, "text/plain", "Failed to connect, please check credentials and try again.");
+  }
+  saveTicket = 0;
+  lastHttpActivityMs = millis();
+}
+
+// Runs on the Wi-Fi event task: only describe what happened, the loop
+// task's subscribers act on it
+void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    eventPost(EventType::STA_DISCONNECTED, info.wifi_sta_disconnected.reason);
+  } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    eventPost(EventType::STA_GOT_IP);
+  } else if (event == ARDUINO_EVENT_WIFI_AP_STACONNECTED) {
+    eventPost(EventType::AP_CLIENT_JOINED);
+  }
+}
+
+void IRAM_ATTR onPush01Change() {
+  eventPost(EventType::BUTTON, PUSH_01, digitalRead(PUSH_01));
+}
+
+void IRAM_ATTR onPush02Change() {
+  int level = digitalRead(PUSH_02);
+  localControlEdgeFromISR(level); // the lamp first
+  eventPost(EventType::BUTTON, PUSH_02, level);
+}
+
+// Guard for STA_UP: the station link really is up
+bool staLinkUp() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+// Action for PORTAL_UP: start the setup double-blink from its first phase
+void enterSetupPattern() {
+  setupPhase = SetupPhase::BLINK1_ON;
+  setupPhaseStartMs = millis();
+}
+
+// After every state change; subscribers see it as a RUN_STATE event
+void onRunStateChange(RunState from, RunState to) {
+  eventPost(EventType::RUN_STATE, (uint8_t)to);
+}
+
+const char* runStateName(RunState s) {
+  switch (s) {
+    case RunState::CONNECTING: return "CONNECTING";
+    case RunState::AP_SETUP: return "AP_SETUP";
+    case RunState::CONNECTED: return "CONNECTED";
+  }
+  return "?";
+}
+
+const char* runEventName(RunEvent e) {
+  switch (e) {
+    case RunEvent::PORTAL_UP: return "PORTAL_UP";
+    case RunEvent::STA_UP: return "STA_UP";
+  }
+  return "?";
+}
+
+// Connection manager: disconnect reasons and wake-ups for the station coroutine
+void connectionOnEvent(const Event &e) {
+  if (e.type == EventType::STA_DISCONNECTED) {
+    lastDisconnectReason = e.code;
+    coroPost(EV_STA_DISCONNECTED);
+  } else if (e.type == EventType::STA_GOT_IP) {
+    coroPost(EV_STA_GOT_IP);
+  }
+}
+
+// HTTP layer: a phone joining the AP counts as portal activity; the /status
+// snapshot is rebuilt as soon as the state or address changes rather than on
+// the next poll
+void httpOnEvent(const Event &e) {
+  if (e.type == EventType::RUN_STATE) {
+    refreshStatusSnapshot();
+  } else if (e.type == EventType::STA_GOT_IP) {
+    // a DHCP renew or a reconnect while CONNECTED can change the address
+    statusStale = true;
+    refreshStatusSnapshot();
+  } else if (e.type == EventType::AP_CLIENT_JOINED) {
+    lastHttpActivityMs = millis();
+#ifdef DEBUG
+    Serial.printf("AP: client joined (%u connected)\n", WiFi.softAPgetStationNum());
+#endif
+  }
+}
+
+// Factory button edges from the ISR; the hold time is checked in factoryResetCheck()
+void buttonsOnEvent(const Event &e) {
+  if (e.type != EventType::BUTTON) return;
+  if (e.code == PUSH_02) {
+    // contact bounce: take a level change only GESTURE_DEBOUNCE_MS after the last one
+    bool down = e.level == LOW;
+    if (down == push02Down || e.atMs - push02EdgeMs < GESTURE_DEBOUNCE_MS) return;
+    push02Down = down;
+    push02EdgeMs = e.atMs;
+    if (down) push02HoldFired = false;
+    else if (!push02HoldFired) push02Clicks++;
+    return;
   }
+  if (e.code != PUSH_01) return;
+  if (e.level == LOW) {
+    if (!factoryBtnHeld) {
+      factoryBtnHeld = true;
+      factoryBtnPressStartMs = e.atMs;
 #ifdef DEBUG
-  Serial.println("AP+STA connect attempt timed out");
+      Serial.println("Factory button pressed");
+#endif
+    }
+  } else if (factoryBtnHeld) {
+    factoryBtnHeld = false;
+#ifdef DEBUG
+    Serial.println("Factory button released before threshold");
 #endif
-  return false;
+  }
+}
+
+// What the /save page is told for the class that ended the last attempt
+ConnectResult connectResultFor(FailClass cls) {
+  switch (cls) {
+    case FailClass::AUTH_FAIL:
+    case FailClass::HANDSHAKE_TIMEOUT:
+      return ConnectResult::WRONG_PASSWORD;
+    case FailClass::NO_AP_FOUND:
+      return ConnectResult::NO_AP;
+    default:
+      return ConnectResult::TIMEOUT;
+  }
+}
+
+const char* connectResultName(ConnectResult r) {
+  switch (r) {
+    case ConnectResult::OK: return "OK";
+    case ConnectResult::WRONG_PASSWORD: return "WRONG_PASSWORD";
+    case ConnectResult::NO_AP: return "NO_AP";
+    case ConnectResult::TIMEOUT: return "TIMEOUT";
+  }
+  return "?";
 }
 
 String last4MacHex() {
+  PROFILE_SCOPE("last4MacHex");
   String mac = WiFi.macAddress(); // format: AA:BB:CC:DD:EE:FF
   mac.replace(":", "");
   mac.toUpperCase();
@@ -350,24 +936,33 @@ String last4MacHex() {
   return mac;
 }
 
-void startCaptiveAP() {
+// mode is WIFI_AP, or WIFI_AP_STA to keep the station usable alongside the
+// portal (the AP then follows the station's channel)
+void startCaptiveAP(wifi_mode_t mode) {
   String apSsid = String("ModuLux-Setup-") + last4MacHex();
 #ifdef DEBUG
   Serial.printf("Starting AP: %s\n", apSsid.c_str());
 #endif
   // Configure static AP IP before starting softAP
-  WiFi.mode(WIFI_AP);
+  WiFi.mode(mode);
   WiFi.softAPConfig(AP_IP, AP_GW, AP_NETMASK);
   WiFi.softAP(apSsid.c_str(), AP_PASS);
 
   // DNS server -> captive
-  dnsServer.start(DNS_PORT, "*", AP_IP);
+  dnsServer.start(DNS_PORT, AP_IP);
+  watchdogRegister(Subsystem::DNS, WDT_DNS_DEADLINE_MS);
 
-  // HTTP handlers
+  // HTTP handlers; the local API may hold the server
+  if (apiActive) {
+    server.stop();
+    apiActive = false;
+  }
+  server.clearRoutes();
+  server.setMaxConns(PORTAL_MAX_CONNS);
   server.on("/", HTTP_GET, handleRoot);
   server.on("/scan", HTTP_GET, handleScan);
   server.on("/save", HTTP_POST, handleSave);
-  server.on("/status", HTTP_GET, handleStatus);
+  registerControlRoutes();
 
   // Serve index for any unknown path (helps captive-portal checks on phones)
   server.onNotFound([]() {
@@ -390,25 +985,60 @@ void startCaptiveAP() {
   });
 
   server.begin();
+  watchdogRegister(Subsystem::HTTP, WDT_HTTP_DEADLINE_MS);
   lastHttpActivityMs = millis();
+  if (bootPortalMs == 0) bootPortalMs = millis();
 #ifdef DEBUG
-  Serial.println("HTTP server started");
+  Serial.printf("HTTP server started (portal up at %lu ms)\n", millis());
 #endif
 
-  // initialize setup pattern
-  setupPhase = SetupPhase::BLINK1_ON;
-  setupPhaseStartMs = millis();
-
-  runState = RunState::AP_SETUP;
+  apActive = true;
+  runFsm.fire<RunEvent::PORTAL_UP>();
 }
 
 void stopCaptiveAP() {
 #ifdef DEBUG
   Serial.println("Stopping AP");
+  Serial.printf("HTTP: %lu connections, %lu requests served\n",
+                (unsigned long)server.connectionCount(), (unsigned long)server.requestCount());
 #endif
   server.stop();
   dnsServer.stop();
-  // Optionally set WiFi.mode(WIFI_STA) if connected
+  watchdogUnregister(Subsystem::HTTP);
+  watchdogUnregister(Subsystem::DNS);
+  apActive = false;
+  // take the softAP down too, keeping the station link if there is one
+  if (WiFi.status() == WL_CONNECTED) WiFi.mode(WIFI_STA);
+}
+
+// Routes served both by the portal and by the local API
+void registerControlRoutes() {
+  server.on("/status", HTTP_GET, handleStatus);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/config", HTTP_GET, handleConfigGet);
+  server.on("/config", HTTP_POST, handleConfigPost);
+  server.on("/scenes", HTTP_GET, handleScenesGet);
+  server.on("/scenes", HTTP_POST, handleScenesPost);
+  server.on("/light", HTTP_GET, handleLightGet);
+  server.on("/light", HTTP_POST, handleLightPost);
+#ifdef TRACE_RECORD
+  server.on("/trace", HTTP_GET, handleTrace);
+#endif
+}
+
+// Control and status on the station interface, once the portal is gone.
+// No DNS, no setup page: unknown paths get a plain 404.
+void startLocalApi() {
+  if (apActive || apiActive) return;
+  server.clearRoutes();
+  server.setMaxConns(API_MAX_CONNS);
+  registerControlRoutes();
+  server.begin();
+  watchdogRegister(Subsystem::HTTP, WDT_HTTP_DEADLINE_MS);
+  apiActive = true;
+#ifdef DEBUG
+  Serial.printf("Local API on http://%s/\n", WiFi.localIP().toString().c_str());
+#endif
 }
 
 void handleRoot() {
@@ -416,83 +1046,652 @@ void handleRoot() {
   lastHttpActivityMs = millis();
 }
 
+// GET /scan?start=1 begins a progressive scan (unless one is running or the
+// last one is fresh); GET /scan returns what has been found so far. The
+// portal polls until "done" so networks show up channel by channel.
 void handleScan() {
-  int n = WiFi.scanNetworks();
+  PROFILE_SCOPE("scan");
+  if (server.hasArg("start") && scanStep < 0 &&
+      (scanFinishedAt == 0 || millis() - scanFinishedAt > SCAN_CACHE_MS)) {
+    startProgressiveScan();
+  }
+  String json = buildScanJson();
+  server.send(200, "application/json", json);
+  lastHttpActivityMs = millis();
+}
+
+void startProgressiveScan() {
+#ifdef DEBUG
+  Serial.println("Scan: start");
+#endif
+  scanResults.clear();
+  scanStep = 0;
+  if (station.running) {
+    // a scan cannot run during a connect; the station retries after the scan
+    WiFi.disconnect();
+    coroPost(EV_SCAN_STARTED);
+  }
+  WiFi.scanNetworks(true, false, false, SCAN_DWELL_MS, SCAN_CHANNELS[0]);
+}
+
+// Called from loop(); collects a finished channel and starts the next one,
+// so DNS/HTTP keep being serviced between channel dwells.
+void serviceScan() {
+  if (scanStep < 0) return;
+  int16_t n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING) return;
+  if (n > 0) foldScanResults(n);
+  traceScanDone(SCAN_CHANNELS[scanStep], n);
+  WiFi.scanDelete();
+
+  scanStep++;
+  if (scanStep < SCAN_CHANNEL_COUNT) {
+    WiFi.scanNetworks(true, false, false, SCAN_DWELL_MS, SCAN_CHANNELS[scanStep]);
+    return;
+  }
+  scanStep = -1;
+  scanFinishedAt = millis();
+  if (scanFinishedAt == 0) scanFinishedAt = 1;
 #ifdef DEBUG
-  Serial.printf("HTTP /scan -> found %d networks\n", n);
+  Serial.printf("Scan: done, %u distinct networks\n", scanResults.size());
 #endif
-  String json = "[";
+}
+
+// Abort a progressive scan (a station connect cannot run alongside it)
+void cancelScan() {
+  if (scanStep < 0) return;
+  esp_wifi_scan_stop();
+  WiFi.scanDelete();
+  scanStep = -1;
+}
+
+// Fold the driver's n results for one channel into scanResults
+void foldScanResults(int n) {
+  PROFILE_SCOPE("scan_post");
   for (int i = 0; i < n; ++i) {
-    String ssid = WiFi.SSID(i);
-    int rssi = WiFi.RSSI(i);
-    String enc = (WiFi.encryptionType(i) == WIFI_AUTH_OPEN) ? "OPEN" : "WPA2";
-    json += "{";
-    json += String("\"ssid\":\"") + ssid + "\",";
-    json += String("\"rssi\":") + rssi + ",";
-    json += String("\"enc\":\"") + enc + "\"";
-    json += "}";
-    if (i < n - 1) json += ",";
-  }
-  json += "]";
-  server.send(200, "application/json", json);
-  lastHttpActivityMs = millis();
+    traceScan(WiFi.SSID(i), WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i));
+    scanResults.add(WiFi.SSID(i), WiFi.RSSI(i), WiFi.channel(i), WiFi.encryptionType(i));
+  }
+}
+
+// JSON body for /scan, strongest first:
+// {"done":bool,"nets":[["ssid",rssi,channel,"sec"],...]}
+String buildScanJson() {
+  PROFILE_SCOPE("scan_json");
+  uint8_t order[SCAN_TOP_K];
+  uint8_t count = scanResults.strongestFirst(order);
+  String json;
+  json.reserve(count * 48 + 32);
+  json += scanStep < 0 ? "{\"done\":true,\"nets\":[" : "{\"done\":false,\"nets\":[";
+  for (uint8_t i = 0; i < count; ++i) {
+    const ScanEntry &e = scanResults[order[i]];
+    if (i) json += ",";
+    json += "[\"";
+    appendJsonEscaped(json, e.ssid); // SSIDs are arbitrary bytes from the air
+    json += "\",";
+    json += String(e.rssi);
+    json += ",";
+    json += String(e.channel);
+    json += ",\"";
+    json += securityName(e.auth);
+    json += "\"]";
+  }
+  json += "]}";
+  return json;
 }
 
 void handleSave() {
-  String ssid = server.arg("ssid");
-  String pass = server.arg("pass");
+  unsigned long t0 = millis();
+  if (saveTicket != 0 || runState == RunState::CONNECTED) {
+    // one attempt at a time; once connected the portal is only winding down
+    server.send(409, "text/plain", saveTicket != 0 ? "Already connecting, please wait." : "Already connected.");
+    lastHttpActivityMs = millis();
+    return;
+  }
+  String ssid;
+  String pass;
+  const ScanEntry *seen;
+  const char* err;
+  {
+    // argument parsing + validation only; the connect attempt is radio time
+    PROFILE_SCOPE("save_args");
+    ssid = server.arg("ssid");
+    pass = server.arg("pass");
+    seen = scanResults.find(ssid.c_str());
+    err = credentialError(ssid, pass, seen);
+  }
 
+  if (err) {
 #ifdef DEBUG
-  Serial.printf("HTTP /save received ssid='%s' (password hidden)\n", ssid.c_str());
+    Serial.printf("HTTP /save rejected: %s\n", err);
 #endif
+    server.send(400, "text/plain", err);
+    lastHttpActivityMs = millis();
+    return;
+  }
 
-  // basic validation: SSID non-empty, password min 8
-  if (ssid.length() == 0 || pass.length() < 8) {
-    server.send(400, "text/plain", "Invalid SSID or password (min 8 chars)");
+  // Pre-flight: a recent full scan that rules the SSID out (not seen, not
+  // truncated, no hidden network) means it is out of range; answer now
+  // instead of after timeouts
+  if (scanStep < 0 && scanFinishedAt != 0 && millis() - scanFinishedAt < SCAN_CACHE_MS &&
+      scanResults.rulesOut(ssid.c_str())) {
+#ifdef DEBUG
+    Serial.printf("HTTP /save: '%s' not in last scan\n", ssid.c_str());
+#endif
+    server.send(404, "text/plain", "Network not found nearby. Check the name or move closer and scan again.");
     lastHttpActivityMs = millis();
     return;
   }
 
+#ifdef DEBUG
+  Serial.printf("HTTP /save received ssid='%s' (password hidden)\n", ssid.c_str());
+#endif
+
   // Save to NVS
   saveCredentialsToNVS(ssid, pass);
   currentSsid = ssid;
   currentPass = pass;
 
-  // Attempt to connect while keeping AP up (AP+STA)
-  bool connected = tryConnectWhileAp(ssid, pass, MAX_RETRIES, CONNECT_TIMEOUT_MS);
-  if (connected) {
-    String ip = WiFi.localIP().toString();
-    server.send(200, "text/html", String("Connected to ") + ssid + " IP: " + ip + "\n");
-    lastHttpActivityMs = millis();
-    // Schedule AP shutdown after 40s to allow device discovery
-    apShutdownAt = millis() + 40000UL;
-#ifdef DEBUG
-    Serial.printf("Scheduled AP shutdown in 40s (at %lu)\n", apShutdownAt);
-#endif
-    runState = RunState::CONNECTED;
-    showConnected();
-    return;
+  // The provisioning flow runs the connect attempt (AP+STA) and answers
+  // through answerSave(); loop() keeps serving DNS/HTTP meanwhile
+  saveTicket = server.defer();
+  saveStartedMs = t0;
+  coroPost(EV_SAVE);
+  lastHttpActivityMs = millis();
+}
+
+void handleStatus() {
+  PROFILE_SCOPE("status");
+  refreshStatusSnapshot();
+  server.sendHeader("ETag", statusEtag);
+  server.sendHeader("Cache-Control", "no-cache"); // revalidate every poll
+  if (server.header("If-None-Match").indexOf(statusEtag) >= 0) {
+    server.send(304, nullptr, "");
   } else {
-    server.send(500, "text/plain", "Failed to connect, please check credentials and try again.");
-    lastHttpActivityMs = millis();
-    runState = RunState::AP_SETUP; // stay in AP
-    return;
+    server.send(200, "application/json", statusJson);
+  }
+  lastHttpActivityMs = millis();
+}
+
+void refreshStatusSnapshot() {
+  RunState state = runState;
+  if (statusVersion != 0 && state == statusBuiltFor && !statusStale) return;
+  statusStale = false;
+
+  String json = "{";
+  if (state == RunState::AP_SETUP) json += "\"state\":\"AP_ACTIVE\"";
+  else if (state == RunState::CONNECTING) json += "\"state\":\"CONNECTING\"";
+  else if (state == RunState::CONNECTED) {
+    json += "\"state\":\"CONNECTED\"";
+    json += String(",\"ip\":\"") + WiFi.localIP().toString() + "\"";
   }
+  json += "}";
+  statusBuiltFor = state;
+  if (statusVersion != 0 && json == statusJson) return; // same body keeps its ETag
+
+  statusJson = json;
+  statusVersion++;
+  statusEtag = String("\"") + String(bootId(), HEX) + "-" + String(statusVersion) + "\"";
 }
 
-void handleStatus() {
-  String s = "{";
-  if (runState == RunState::AP_SETUP) s += "\"state\":\"AP_ACTIVE\"";
-  else if (runState == RunState::CONNECTING) s += "\"state\":\"CONNECTING\"";
-  else if (runState == RunState::CONNECTED) {
-    s += "\"state\":\"CONNECTED\"";
-    s += String(",\"ip\":\"") + WiFi.localIP().toString() + "\"";
+// Random per boot, so a version number from an earlier boot is never taken for a current one
+uint32_t bootId() {
+  if (statusBootId == 0) statusBootId = esp_random() | 1;
+  return statusBootId;
+}
+
+// Runtime counters as JSON
+void handleMetrics() {
+  String s = "{\"boot\":{\"plan\":\"";
+  s += bootPlanName(bootPlan);
+  s += "\",\"prior_failures\":";
+  s += String(bootFailHistory);
+  s += ",\"sta_attempts\":";
+  s += String(bootRetries);
+  s += ",\"portal_ms\":";
+  s += String(bootPortalMs);
+  s += ",\"connected_ms\":";
+  s += String(bootConnectedMs);
+  s += ",\"light_us\":";
+  s += String(bootLightUs);
+  s += ",\"light_from\":\"";
+  s += lampRestoreName(bootLightFrom);
+  s += "\"},\"connect\":{\"ok\":";
+  s += String(connectSuccesses);
+  s += ",\"last_reason\":";
+  s += String(lastFailReason);
+  s += ",\"fail\":{";
+  for (size_t i = (size_t)FailClass::NONE + 1; i < FAIL_CLASS_COUNT; ++i) {
+    if (i > 1) s += ",";
+    s += "\"";
+    s += failClassName((FailClass)i);
+    s += "\":";
+    s += String(connectFailures[i]);
+  }
+  s += "}},\"wdt\":{\"max_gap_ms\":{";
+  for (size_t i = 0; i < SUBSYSTEM_COUNT; ++i) {
+    if (i) s += ",";
+    s += "\"";
+    s += subsystemName((Subsystem)i);
+    s += "\":";
+    s += String(watchdogMaxGapMs((Subsystem)i));
+  }
+  s += "}";
+  Subsystem culprit;
+  uint32_t gapMs;
+  if (watchdogLastReset(&culprit, &gapMs)) {
+    s += ",\"last_reset\":{\"subsystem\":\"";
+    s += subsystemName(culprit);
+    s += "\",\"gap_ms\":";
+    s += String(gapMs);
+    s += "}";
   }
+  EventStats ev = eventStats();
+  s += "},\"events\":{\"posted\":";
+  s += String(ev.posted);
+  s += ",\"dropped\":";
+  s += String(ev.dropped);
+  s += ",\"max_depth\":";
+  s += String(ev.maxDepth);
+  s += "},\"fsm\":[";
+  for (uint8_t i = 0; i < runFsm.count(); ++i) {
+    const FsmTrace<RunState, RunEvent> &t = runFsm.trace(i);
+    if (i) s += ",";
+    s += "[";
+    s += String((unsigned long)t.atMs);
+    s += ",\"";
+    s += runStateName(t.from);
+    s += "\",\"";
+    s += runEventName(t.on);
+    s += "\",";
+    s += t.accepted ? String("\"") + runStateName(t.to) + "\"" : String("null");
+    s += "]";
+  }
+  s += "],\"coro\":{";
+  appendCoroStats(s, "provision", provision, sizeof(provision));
+  s += ",";
+  appendCoroStats(s, "station", station, sizeof(station));
+  s += "},\"energy\":";
+  s += energyJson([](uint8_t i) { return runStateName((RunState)i); }, (uint8_t)RunState::CONNECTED + 1);
+  LocalControlStats lc = localControlStats();
+  s += ",\"local_control\":{\"actions\":";
+  s += String(lc.actions);
+  s += ",\"holds\":";
+  s += String(lc.holds);
+  s += ",\"last_us\":";
+  s += String(lc.lastUs);
+  s += ",\"avg_us\":";
+  s += String(lc.avgUs);
+  s += ",\"max_us\":";
+  s += String(lc.maxUs);
+  s += ",\"over_budget\":";
+  s += String(lc.overBudget);
+  s += "}";
+  CoalescerStats in = lampInput.stats();
+  s += ",\"light_input\":{\"received\":";
+  s += String(in.received);
+  s += ",\"applied\":";
+  s += String(in.applied);
+  s += ",\"frames\":";
+  s += String(in.frames);
+  s += ",\"added_avg_us\":";
+  s += String(in.latencyAvgUs);
+  s += ",\"added_max_us\":";
+  s += String(in.latencyMaxUs);
   s += "}";
+  SceneStoreStats st = sceneStoreStats();
+  s += ",\"scenes\":{\"active\":";
+  s += String(activeScene);
+  s += ",\"recalls\":";
+  s += String(sceneRecalls);
+  s += ",\"last_us\":";
+  s += String(recallLastUs);
+  s += ",\"max_us\":";
+  s += String(recallMaxUs);
+  s += ",\"avg_us\":";
+  s += String(sceneRecalls ? recallTotalUs / sceneRecalls : 0);
+  s += ",\"gesture_ms\":";
+  s += String(gestureMs);
+  s += ",\"store\":{\"mapped\":";
+  s += st.mapped ? "true" : "false";
+  s += ",\"seq\":";
+  s += String(st.seq);
+  s += ",\"slot\":";
+  s += String(st.slot);
+  s += ",\"slots\":";
+  s += String(st.slots);
+  s += ",\"writes\":";
+  s += String(st.writes);
+  s += ",\"erases\":";
+  s += String(st.erases);
+  s += "}},\"light_report\":{\"version\":";
+  s += String(lightReport.version());
+  s += ",\"full\":";
+  s += String(reportsFull);
+  s += ",\"full_avg_bytes\":";
+  s += String(reportsFull ? reportsFullBytes / reportsFull : 0);
+  s += ",\"delta\":";
+  s += String(reportsDelta);
+  s += ",\"delta_avg_bytes\":";
+  s += String(reportsDelta ? reportsDeltaBytes / reportsDelta : 0);
+  s += ",\"waiting\":";
+  s += lightWaitTicket ? "true" : "false";
+  s += "},\"http\":{\"mode\":\"";
+  s += apActive ? "portal" : (apiActive ? "api" : "off");
+  s += "\",\"connections\":";
+  s += String(server.connectionCount());
+  s += ",\"requests\":";
+  s += String(server.requestCount());
+  s += "},\"heap\":{\"free\":";
+  s += String(ESP.getFreeHeap());
+  s += ",\"min_free\":";
+  s += String(ESP.getMinFreeHeap());
+  s += ",\"largest\":";
+  s += String(ESP.getMaxAllocHeap());
+  s += "}}";
   server.send(200, "application/json", s);
   lastHttpActivityMs = millis();
 }
 
+// What the radio is doing right now, for energy accounting
+RadioMode currentRadioMode() {
+  if (scanStep >= 0) return RadioMode::SCAN;
+  switch (WiFi.getMode()) {
+    case WIFI_STA: {
+      wifi_ps_type_t ps = WIFI_PS_NONE;
+      if (WiFi.status() == WL_CONNECTED && esp_wifi_get_ps(&ps) == ESP_OK && ps != WIFI_PS_NONE) return RadioMode::STA_SLEEP;
+      return RadioMode::STA;
+    }
+    case WIFI_AP: return RadioMode::AP;
+    case WIFI_AP_STA: return RadioMode::AP_STA;
+    default: return RadioMode::OFF;
+  }
+}
+
+// {"active":i|-1,"scenes":[{"name":..,"warm":..,"cool":..,"fade_ms":..},...]}
+String buildScenesJson() {
+  trackActiveScene();
+  String s = "{\"active\":";
+  s += String(activeScene);
+  s += ",\"scenes\":[";
+  for (uint8_t i = 0; i < sceneCount(); ++i) {
+    const Scene *sc = sceneGet(i);
+    char name[SCENE_NAME_LEN + 1];
+    memcpy(name, sc->name, SCENE_NAME_LEN);
+    name[SCENE_NAME_LEN] = '\0';
+    if (i) s += ",";
+    s += "{\"name\":\"";
+    appendJsonEscaped(s, String(name));
+    s += "\",\"warm\":";
+    s += String(sc->warm);
+    s += ",\"cool\":";
+    s += String(sc->cool);
+    s += ",\"fade_ms\":";
+    s += String(sc->fadeMs);
+    s += "}";
+  }
+  s += "]}";
+  return s;
+}
+
+void handleScenesGet() {
+  server.send(200, "application/json", buildScenesJson());
+  lastHttpActivityMs = millis();
+}
+
+// POST /scenes  recall=<index or name>  |  off=1
+//   | store=<index>&name=..&warm=..&cool=..&fade_ms=..  (config token, writes flash)
+void handleScenesPost() {
+  lastHttpActivityMs = millis();
+  if (server.hasArg("recall")) {
+    String which = server.arg("recall");
+    char *end = nullptr;
+    long i = strtol(which.c_str(), &end, 10);
+    if (which.length() == 0 || *end != '\0') i = sceneFind(which.c_str());
+    if (i < 0 || i > 255 || !recallScene((uint8_t)i)) {
+      server.send(404, "text/plain", "Unknown scene");
+      return;
+    }
+  } else if (server.hasArg("off")) {
+    lampOff();
+  } else if (server.hasArg("store")) {
+    if (!configAuthorized(server.header("Authorization"))) {
+      server.sendHeader("WWW-Authenticate", "Bearer");
+      server.send(401, "text/plain", "Missing or wrong config token");
+      return;
+    }
+    Scene sc;
+    memset(&sc, 0, sizeof(sc));
+    String name = server.arg("name");
+    if (name.length() == 0 || name.length() > SCENE_NAME_LEN) {
+      server.send(400, "text/plain", "Name must be 1-16 bytes");
+      return;
+    }
+    memcpy(sc.name, name.c_str(), name.length());
+    const char *fields[] = {"store", "warm", "cool", "fade_ms"};
+    unsigned long v[4];
+    for (size_t k = 0; k < 4; ++k) {
+      String a = server.arg(fields[k]);
+      char *end = nullptr;
+      v[k] = strtoul(a.c_str(), &end, 10);
+      if (a.length() == 0 || *end != '\0' || v[k] > 65535) {
+        server.send(400, "text/plain", String(fields[k]) + " must be 0-65535");
+        return;
+      }
+    }
+    sc.warm = v[1];
+    sc.cool = v[2];
+    sc.fadeMs = v[3];
+    const char *err = v[0] > 255 ? "Scene index out of range" : sceneStore((uint8_t)v[0], sc);
+    if (err) {
+      server.send(400, "text/plain", err);
+      return;
+    }
+  } else {
+    server.send(400, "text/plain", "Expected recall, off or store");
+    return;
+  }
+  server.send(200, "application/json", buildScenesJson());
+}
+
+// Sample what GET /light reports; each real change bumps lightReport's version
+void trackLightReport() {
+  trackActiveScene();
+  LampState lamp = lampGet();
+  lightReport.set((uint8_t)ReportAttr::ON, lamp.on);
+  lightReport.set((uint8_t)ReportAttr::BRIGHTNESS, lamp.brightness);
+  lightReport.set((uint8_t)ReportAttr::MIX, lamp.mix);
+  lightReport.set((uint8_t)ReportAttr::SCENE, (uint32_t)(int32_t)activeScene);
+}
+
+// {"v":..,"on":bool,"brightness":..,"mix":..,"scene":..,"warm":..,"cool":..};
+// warm/cool are the output now. "v" is "<boot id hex>-<version>"; the
+// attributes in mask follow. The full report (every attribute) also carries
+// the output levels.
+String buildLightJson(uint32_t mask) {
+  const char *names[REPORT_ATTR_COUNT] = {"on", "brightness", "mix", "scene"};
+  bool full = mask == lightReport.ALL;
+  String s = "{\"v\":\"";
+  s += String(bootId(), HEX);
+  s += "-";
+  s += String(lightReport.version());
+  s += "\"";
+  for (uint8_t a = 0; a < REPORT_ATTR_COUNT; ++a) {
+    if (!(mask & (1UL << a))) continue;
+    s += ",\"";
+    s += names[a];
+    s += "\":";
+    uint32_t v = lightReport.value(a);
+    if ((ReportAttr)a == ReportAttr::ON) s += v ? "true" : "false";
+    else if ((ReportAttr)a == ReportAttr::SCENE) s += String((int32_t)v);
+    else s += String(v);
+  }
+  if (full) {
+    LightLevels out = lightOutput();
+    s += ",\"warm\":";
+    s += String(out.warm);
+    s += ",\"cool\":";
+    s += String(out.cool);
+  }
+  s += "}";
+  if (full) {
+    reportsFull++;
+    reportsFullBytes += s.length();
+  } else {
+    reportsDelta++;
+    reportsDeltaBytes += s.length();
+  }
+  return s;
+}
+
+// The version a subscriber last saw, from its "v"; 0 (full report) if it is
+// missing, malformed or from another boot
+uint32_t parseReportVersion(const String &v) {
+  char *end = nullptr;
+  uint32_t boot = strtoul(v.c_str(), &end, 16);
+  if (boot != bootId() || *end != '-') return 0;
+  const char *num = end + 1;
+  uint32_t version = strtoul(num, &end, 10);
+  if (end == num || *end != '\0') return 0;
+  return version;
+}
+
+// GET /light            full state
+// GET /light?since=<v>  attributes changed after v; add wait=1 to hold the
+//                       request until one changes (up to LIGHT_WAIT_MS)
+void handleLightGet() {
+  lastHttpActivityMs = millis();
+  trackLightReport();
+  uint32_t since = parseReportVersion(server.arg("since"));
+  uint32_t mask = lightReport.changedSince(since);
+  if (mask == 0 && server.arg("wait") == "1" && lightWaitTicket == 0) {
+    lightWaitTicket = server.defer();
+    lightWaitSince = since;
+    lightWaitStartMs = millis();
+    return;
+  }
+  // a second long-poll while one is parked is answered right away
+  server.send(200, "application/json", buildLightJson(mask));
+}
+
+// Answer the parked long-poll once something changed or it has waited long enough
+void serviceLightWait() {
+  if (lightWaitTicket == 0) return;
+  uint32_t mask = lightReport.changedSince(lightWaitSince);
+  if (mask == 0 && millis() - lightWaitStartMs < LIGHT_WAIT_MS) return;
+  server.respond(lightWaitTicket, 200, "application/json", buildLightJson(mask));
+  lightWaitTicket = 0; // answered, or the client or the server has gone
+}
+
+// POST /light  any of on=0|1, brightness=0-65535, mix=0-65535, transition_ms=0-65535
+// (power and color are accepted for on and mix). All fields are checked before
+// any is taken. Applied at the next output frame, so the reply is 204 and a
+// slider can send at its own rate.
+void handleLightPost() {
+  lastHttpActivityMs = millis();
+  const char *fields[LAMP_ATTR_COUNT] = {"on", "brightness", "mix", "transition_ms"};
+  const char *aliases[LAMP_ATTR_COUNT] = {"power", nullptr, "color", nullptr};
+  const unsigned long limit[LAMP_ATTR_COUNT] = {1, 65535, 65535, 65535};
+  unsigned long v[LAMP_ATTR_COUNT];
+  bool given[LAMP_ATTR_COUNT];
+  bool any = false;
+  for (size_t a = 0; a < LAMP_ATTR_COUNT; ++a) {
+    const char *name = fields[a];
+    if (!server.hasArg(name) && aliases[a] && server.hasArg(aliases[a])) name = aliases[a];
+    given[a] = server.hasArg(name);
+    if (!given[a]) continue;
+    String arg = server.arg(name);
+    char *end = nullptr;
+    v[a] = strtoul(arg.c_str(), &end, 10);
+    if (arg.length() == 0 || *end != '\0' || v[a] > limit[a]) {
+      server.send(400, "text/plain", String(name) + " must be 0-" + String(limit[a]));
+      return;
+    }
+    any = true;
+  }
+  if (!any) {
+    server.send(400, "text/plain", "Expected on (power), brightness, mix (color) or transition_ms");
+    return;
+  }
+  for (size_t a = 0; a < LAMP_ATTR_COUNT; ++a) {
+    if (given[a]) lampInput.submit(a, v[a]);
+  }
+  server.send(204, "text/plain", "");
+}
+
+void handleConfigGet() {
+  server.send(200, "application/json", configJson());
+  lastHttpActivityMs = millis();
+}
+
+#ifdef TRACE_RECORD
+// GET /trace[?clear=1]  the input trace, binary (see include/trace.h); same token as POST /config
+void handleTrace() {
+  lastHttpActivityMs = millis();
+  if (!configAuthorized(server.header("Authorization"))) {
+    server.sendHeader("WWW-Authenticate", "Bearer");
+    server.send(401, "text/plain", "Missing or wrong config token");
+    return;
+  }
+  server.sendHeader("Content-Disposition", "attachment; filename=\"trace.bin\"");
+  server.send_P(200, "application/octet-stream", (PGM_P)traceData(), traceSize());
+  if (server.arg("clear") == "1") traceClear();
+}
+#endif
+
+// POST /config  key=<nvs key>&value=<n>  or  key=<nvs key>&reset=1
+// Needs "Authorization: Bearer <token>"; the token is printed on Serial at boot.
+void handleConfigPost() {
+  lastHttpActivityMs = millis();
+  if (!configAuthorized(server.header("Authorization"))) {
+    server.sendHeader("WWW-Authenticate", "Bearer");
+    server.send(401, "text/plain", "Missing or wrong config token");
+    return;
+  }
+  String key = server.arg("key");
+  int i = configFind(key.c_str());
+  if (i < 0) {
+    server.send(404, "text/plain", "Unknown setting");
+    return;
+  }
+  if (server.hasArg("reset")) {
+    configReset(i);
+  } else {
+    String value = server.arg("value");
+    char *end = nullptr;
+    unsigned long v = strtoul(value.c_str(), &end, 10);
+    if (value.length() == 0 || *end != '\0') {
+      server.send(400, "text/plain", "Value must be a decimal number");
+      return;
+    }
+    const char *err = configSet(i, (uint32_t)v);
+    if (err) {
+      server.send(400, "text/plain", err);
+      return;
+    }
+  }
+#ifdef DEBUG
+  Serial.printf("Config: %s = %lu%s\n", key.c_str(), (unsigned long)cfgValues[i], configIsOverridden(i) ? "" : " (default)");
+#endif
+  server.send(200, "application/json", configJson());
+}
+
+// "name":{"frame":bytes,"steps":n,"avg_ns":..,"max_ns":..}; avg_ns is
+// mostly resume-and-suspend cost since most steps find nothing to do
+void appendCoroStats(String &s, const char *name, const CoroFrame &f, size_t frameSize) {
+  s += "\"";
+  s += name;
+  s += "\":{\"frame\":";
+  s += String((unsigned long)frameSize);
+  s += ",\"steps\":";
+  s += String(f.steps);
+  s += ",\"avg_ns\":";
+  s += String(f.steps ? coroCyclesToNs(f.totalCycles / f.steps) : 0);
+  s += ",\"max_ns\":";
+  s += String(coroCyclesToNs(f.maxCycles));
+  s += "}";
+}
+
 void performFactoryReset() {
 #ifdef DEBUG
   Serial.println("Performing factory reset...");
@@ -500,6 +1699,7 @@ void performFactoryReset() {
   // wipe keys
   prefs.clear();
   prefs.putUChar("prov", 0);
+  configClear();
 
   // Rapid blink to indicate reset
   for (int i = 0; i < 8; ++i) {
@@ -513,31 +1713,108 @@ void performFactoryReset() {
 }
 
 void factoryResetCheck() {
-  int v = digitalRead(PUSH_01);
-  if (v == LOW) {
-    if (!factoryBtnHeld) {
-      factoryBtnHeld = true;
-      factoryBtnPressStartMs = millis();
-#ifdef DEBUG
-      Serial.println("Factory button pressed");
-#endif
-    } else {
-      // perform factory reset when button held for threshold (10s)
-      if ((millis() - factoryBtnPressStartMs >= 10000UL)) {
+  // perform factory reset when button held for threshold (factory_hold_ms);
+  // the pin is re-read so a dropped release event cannot wipe the device
+  if (factoryBtnHeld && millis() - factoryBtnPressStartMs >= cfg<Cfg::FACTORY_HOLD_MS>() && digitalRead(PUSH_01) == LOW) {
 #ifdef DEBUG
-        Serial.println("Factory reset threshold reached");
+    Serial.println("Factory reset threshold reached");
 #endif
-        performFactoryReset();
-      }
+    performFactoryReset();
+  }
+}
+
+// Debounced PUSH_02 gesture, if one just completed. A double click fires on
+// the second release; a single click only once GESTURE_DOUBLE_MS has passed
+// without a second one.
+Gesture pollGesture() {
+  unsigned long now = millis();
+  // an edge swallowed by the debounce can leave the state stale; the pin is the truth
+  if (now - push02EdgeMs >= GESTURE_DEBOUNCE_MS && (digitalRead(PUSH_02) == LOW) != push02Down) {
+    push02Down = !push02Down;
+    push02EdgeMs = now;
+    if (push02Down) push02HoldFired = false;
+    else if (!push02HoldFired) push02Clicks++;
+  }
+  if (push02Down) {
+    if (!push02HoldFired && now - push02EdgeMs >= GESTURE_HOLD_MS) {
+      push02HoldFired = true;
+      push02Clicks = 0;
+      return Gesture::HOLD;
     }
-  } else {
-    if (factoryBtnHeld) {
+    return Gesture::NONE;
+  }
+  if (push02Clicks >= 2) {
+    push02Clicks = 0;
+    return Gesture::DOUBLE_CLICK;
+  }
+  if (push02Clicks == 1 && now - push02EdgeMs >= GESTURE_DOUBLE_MS) {
+    push02Clicks = 0;
+    return Gesture::CLICK;
+  }
+  return Gesture::NONE;
+}
+
+void serviceSceneButton() {
+  // CLICK and HOLD were already acted on by the local control task
+  if (pollGesture() != Gesture::DOUBLE_CLICK || sceneCount() == 0) return;
+  unsigned long edgeMs = push02EdgeMs;
+  recallScene(activeScene < 0 ? 0 : (activeScene + 1) % sceneCount());
+  gestureMs = millis() - edgeMs;
+}
+
+// Scene i onto the lamp (starting its fade)
+bool recallScene(uint8_t i) {
+  uint32_t t0 = micros();
+  const Scene *sc = sceneGet(i);
+  if (sc == nullptr) return false;
+  LightLevels l = {sc->warm, sc->cool};
+  lightSet(l, sc->fadeMs);
+  uint32_t us = micros() - t0;
+  activeScene = i;
+  sceneLamp = lampGet();
+  sceneRecalls++;
+  recallLastUs = us;
+  recallTotalUs += us;
+  if (us > recallMaxUs) recallMaxUs = us;
 #ifdef DEBUG
-      Serial.println("Factory button released before threshold");
+  Serial.printf("Scene %u '%.16s' recalled in %lu us\n", i, sc->name, (unsigned long)us);
 #endif
+  return true;
+}
+
+// A scene stays active only while the lamp is as its recall left it: POST
+// /light, the PUSH_02 toggle and dim (local control task) and lampOff() all
+// end it
+void trackActiveScene() {
+  if (activeScene < 0) return;
+  LampState l = lampGet();
+  if (l.on != sceneLamp.on || l.brightness != sceneLamp.brightness || l.mix != sceneLamp.mix) activeScene = -1;
+}
+
+void lampOff() {
+  LightLevels off = {0, 0};
+  lightSet(off, LIGHT_OFF_FADE_MS); // brightness and mix stay for the next power-on
+  activeScene = -1;
+}
+
+// One output frame: the latest target per attribute since the last frame,
+// faded to over a frame (or the requested transition) so drags look smooth
+void serviceLampInput() {
+  unsigned long now = millis();
+  if (!lampInput.pending() || now - lampFrameMs < OUTPUT_FRAME_MS) return;
+  lampFrameMs = now;
+  uint16_t fadeMs = OUTPUT_FRAME_MS;
+  LampPatch p = {0, false, 0, 0};
+  lampInput.flush([&fadeMs, &p](uint8_t a, uint16_t v) {
+    switch ((LampAttr)a) {
+      case LampAttr::POWER: p.mask |= LAMP_ON; p.on = v != 0; break;
+      case LampAttr::BRIGHTNESS: p.mask |= LAMP_BRIGHTNESS; p.brightness = v; break;
+      case LampAttr::MIX: p.mask |= LAMP_MIX; p.mix = v; break;
+      case LampAttr::TRANSITION: if (v > fadeMs) fadeMs = v; break;
+      case LampAttr::COUNT: break;
     }
-    factoryBtnHeld = false;
-  }
+  });
+  lampPatch(p, fadeMs);
 }
 
 // LED patterns implementations
@@ -549,7 +1826,7 @@ void showConnected() {
 
 void showConnectingPattern() {
   unsigned long now = millis();
-  const unsigned long blinkInterval = 200;
+  const unsigned long blinkInterval = cfg<Cfg::BLINK_CONNECT_MS>();
   if (now - connectBlinkLastMs >= blinkInterval) {
     connectBlinkLastMs = now;
     connectLedState = !connectLedState;
@@ -561,9 +1838,10 @@ void showConnectingPattern() {
 void showSetupPattern() {
   unsigned long now = millis();
   // Sequence: BLINK1_ON (200ms) -> BLINK1_OFF (200ms) -> BLINK2_ON (200ms, LED_02 pulse occurs during this) -> BLINK2_OFF (200ms) -> PAUSE (1200ms)
-  const unsigned long onMs = 200;
-  const unsigned long offMs = 200;
-  const unsigned long pauseMs = 1200;
+  // (defaults; blink_on_ms / blink_off_ms / blink_pause_ms in include/config.h)
+  const unsigned long onMs = cfg<Cfg::BLINK_ON_MS>();
+  const unsigned long offMs = cfg<Cfg::BLINK_OFF_MS>();
+  const unsigned long pauseMs = cfg<Cfg::BLINK_PAUSE_MS>();
 
   switch (setupPhase) {
     case SetupPhase::BLINK1_ON:
@@ -0,0 +1,43 @@
+#include "portal_input.h"
+
+void appendJsonEscaped(String &out, const String &s) {
+  for (unsigned int i = 0; i < s.length(); ++i) {
+    char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((uint8_t)c < 0x20) {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+      out += esc;
+    } else {
+      out += c;
+    }
+  }
+}
+
+const char* credentialError(const String &ssid, const String &pass, const ScanEntry *seen) {
+  if (ssid.length() == 0 || ssid.length() > SSID_MAX_LEN) return "Invalid SSID (1-32 bytes)";
+  if (seen) {
+    if (seen->auth == WIFI_AUTH_OPEN) {
+      return pass.length() == 0 ? nullptr : "This network is open, leave the password empty";
+    }
+    if (seen->auth == WIFI_AUTH_WPA2_ENTERPRISE) return "Enterprise (802.1X) networks are not supported";
+    if (seen->auth == WIFI_AUTH_WEP) {
+      unsigned int n = pass.length();
+      return (n == 5 || n == 13 || n == 10 || n == 26) ? nullptr : "Invalid WEP key (5/13 chars or 10/26 hex)";
+    }
+  }
+  if (pass.length() < PASS_MIN_LEN || pass.length() > PASS_MAX_LEN) {
+    return "Invalid password (8-63 chars)";
+  }
+  for (unsigned int i = 0; i < pass.length(); ++i) {
+    char c = pass[i];
+    if (pass.length() == PASS_MAX_LEN) {
+      if (!isxdigit((unsigned char)c)) return "Invalid password (64-char key must be hex)";
+    } else if (c < 0x20 || c > 0x7e) {
+      return "Invalid password (printable ASCII only)";
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,486 @@
+#include "portal_server.h"
+
+#include "trace.h"
+
+static const char* statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 422: return "Unprocessable Entity";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+static bool equalsIgnoreCase(const char *a, size_t alen, const char *b) {
+  if (alen != strlen(b)) return false;
+  for (size_t i = 0; i < alen; ++i) {
+    if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+  }
+  return true;
+}
+
+static String rangeToString(const char *p, size_t len) {
+  String s;
+  s.reserve(len);
+  for (size_t i = 0; i < len; ++i) s += p[i];
+  return s;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// application/x-www-form-urlencoded value -> raw bytes
+static String urlDecode(const char *p, size_t len) {
+  String out;
+  out.reserve(len);
+  for (size_t i = 0; i < len; ++i) {
+    char c = p[i];
+    if (c == '+') {
+      out += ' ';
+    } else if (c == '%' && i + 2 < len && hexValue(p[i + 1]) >= 0 && hexValue(p[i + 2]) >= 0) {
+      out += (char)((hexValue(p[i + 1]) << 4) | hexValue(p[i + 2]));
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+PortalServer::PortalServer(uint16_t port)
+  : listener(port, PORTAL_MAX_CONNS + 1), running(false), routeCount(0), maxConns(PORTAL_MAX_CONNS), cur(nullptr),
+    reqMethod(HTTP_GET), reqHead(false), reqKeepAlive(false), responded(false),
+    pathStart(0), pathLen(0), queryStart(0), queryLen(0),
+    headersStart(0), headersLen(0), bodyStart(0), bodyLen(0),
+    nextSerial(0), statConnections(0), statRequests(0) {
+  for (uint8_t i = 0; i < PORTAL_MAX_CONNS; ++i) {
+    conns[i].inUse = false;
+    conns[i].len = 0;
+    conns[i].headerEnd = 0;
+    conns[i].requests = 0;
+    conns[i].serial = 0;
+    conns[i].parked = false;
+    conns[i].parkedKeepAlive = false;
+    conns[i].parkedHead = false;
+    conns[i].lastActivityMs = 0;
+  }
+}
+
+void PortalServer::begin() {
+  listener.begin();
+  listener.setNoDelay(true);
+  statConnections = 0;
+  statRequests = 0;
+  running = true;
+}
+
+void PortalServer::stop() {
+  for (uint8_t i = 0; i < PORTAL_MAX_CONNS; ++i) {
+    if (conns[i].inUse) closeConn(conns[i]);
+  }
+  listener.stop();
+  running = false;
+}
+
+void PortalServer::on(const char *uri, HTTPMethod method, THandlerFunction fn) {
+  // re-registering the same route replaces it (startCaptiveAP may run again)
+  for (uint8_t i = 0; i < routeCount; ++i) {
+    if (routes[i].method == method && strcmp(routes[i].uri, uri) == 0) {
+      routes[i].fn = fn;
+      return;
+    }
+  }
+  if (routeCount >= PORTAL_MAX_ROUTES) return;
+  routes[routeCount].uri = uri;
+  routes[routeCount].method = method;
+  routes[routeCount].fn = fn;
+  routeCount++;
+}
+
+void PortalServer::onNotFound(THandlerFunction fn) {
+  notFound = fn;
+}
+
+void PortalServer::clearRoutes() {
+  for (uint8_t i = 0; i < routeCount; ++i) routes[i].fn = nullptr; // release captured state
+  routeCount = 0;
+  notFound = nullptr;
+}
+
+void PortalServer::setMaxConns(uint8_t n) {
+  if (running) return;
+  maxConns = n < 1 ? 1 : (n > PORTAL_MAX_CONNS ? PORTAL_MAX_CONNS : n);
+}
+
+void PortalServer::handleClient() {
+  if (!running) return;
+  acceptNew();
+  for (uint8_t i = 0; i < PORTAL_MAX_CONNS; ++i) {
+    if (conns[i].inUse) pump(conns[i], millis());
+  }
+}
+
+void PortalServer::acceptNew() {
+  for (uint8_t n = 0; n < PORTAL_MAX_CONNS; ++n) {
+    WiFiClient client = listener.available();
+    if (!client) return;
+    statConnections++;
+
+    Conn *slot = nullptr;
+    Conn *oldest = nullptr;
+    for (uint8_t i = 0; i < maxConns; ++i) {
+      if (!conns[i].inUse) {
+        slot = &conns[i];
+        break;
+      }
+      if (conns[i].parked) continue; // owes a response
+      if (!oldest || (long)(conns[i].lastActivityMs - oldest->lastActivityMs) < 0) oldest = &conns[i];
+    }
+    if (!slot) {
+      if (!oldest) {
+        client.stop(); // every connection is parked
+        continue;
+      }
+      // pool full: drop the least recently active connection
+      closeConn(*oldest);
+      slot = oldest;
+    }
+    slot->client = client;
+    slot->client.setNoDelay(true);
+    slot->inUse = true;
+    slot->len = 0;
+    slot->headerEnd = 0;
+    slot->requests = 0;
+    if (++nextSerial == 0) nextSerial = 1;
+    slot->serial = nextSerial;
+    slot->parked = false;
+    slot->lastActivityMs = millis();
+  }
+}
+
+void PortalServer::pump(Conn &c, unsigned long now) {
+  if (c.parked) {
+    // nothing is read until respond(); only notice the client leaving
+    if (!c.client.connected()) closeConn(c);
+    return;
+  }
+
+  int avail = c.client.available();
+  while (avail > 0 && c.len < PORTAL_MAX_REQUEST_LEN) {
+    size_t room = PORTAL_MAX_REQUEST_LEN - c.len;
+    int r = c.client.read((uint8_t*)c.buf + c.len, min((size_t)avail, room));
+    if (r <= 0) break;
+    c.len += r;
+    avail -= r;
+    c.lastActivityMs = now;
+  }
+
+  // more than one request may be buffered (pipelining)
+  while (c.inUse && c.len > 0 && parseAndDispatch(c)) {
+  }
+  if (!c.inUse) return;
+
+  if (!c.client.connected() && c.client.available() == 0) {
+    closeConn(c);
+  } else if (millis() - c.lastActivityMs > PORTAL_IDLE_TIMEOUT_MS) {
+    closeConn(c);
+  }
+}
+
+// Returns true if a complete request was consumed from c.buf
+bool PortalServer::parseAndDispatch(Conn &c) {
+  cur = &c;
+  reqHead = false;
+  reqKeepAlive = false;
+  responded = false;
+  extraHeaders = "";
+
+  if (!c.headerEnd) {
+    for (uint16_t i = 3; i < c.len; ++i) {
+      if (c.buf[i - 3] == '\r' && c.buf[i - 2] == '\n' && c.buf[i - 1] == '\r' && c.buf[i] == '\n') {
+        c.headerEnd = i + 1;
+        break;
+      }
+    }
+    if (!c.headerEnd) {
+      if (c.len >= PORTAL_MAX_REQUEST_LEN) {
+        writeResponse(413, "text/plain", "", 0);
+        closeConn(c);
+      }
+      cur = nullptr;
+      return false;
+    }
+  }
+
+  // Request line: METHOD SP URI SP VERSION CRLF
+  const char *line = c.buf;
+  const char *lineEnd = (const char*)memchr(line, '\r', c.headerEnd);
+  const char *sp1 = (const char*)memchr(line, ' ', lineEnd - line);
+  const char *sp2 = sp1 ? (const char*)memchr(sp1 + 1, ' ', lineEnd - sp1 - 1) : nullptr;
+  if (!sp1 || !sp2) {
+    writeResponse(400, "text/plain", "", 0);
+    closeConn(c);
+    cur = nullptr;
+    return false;
+  }
+
+  size_t mlen = sp1 - line;
+  if (equalsIgnoreCase(line, mlen, "GET")) reqMethod = HTTP_GET;
+  else if (equalsIgnoreCase(line, mlen, "HEAD")) { reqMethod = HTTP_HEAD; reqHead = true; }
+  else if (equalsIgnoreCase(line, mlen, "POST")) reqMethod = HTTP_POST;
+  else if (equalsIgnoreCase(line, mlen, "PUT")) reqMethod = HTTP_PUT;
+  else if (equalsIgnoreCase(line, mlen, "DELETE")) reqMethod = HTTP_DELETE;
+  else if (equalsIgnoreCase(line, mlen, "OPTIONS")) reqMethod = HTTP_OPTIONS;
+  else {
+    writeResponse(501, "text/plain", "", 0);
+    closeConn(c);
+    cur = nullptr;
+    return false;
+  }
+
+  const char *target = sp1 + 1;
+  const char *q = (const char*)memchr(target, '?', sp2 - target);
+  pathStart = target - c.buf;
+  pathLen = (q ? q : sp2) - target;
+  queryStart = q ? (q + 1 - c.buf) : 0;
+  queryLen = q ? (sp2 - q - 1) : 0;
+  headersStart = lineEnd + 2 - c.buf;
+  headersLen = c.headerEnd - 2 - headersStart;
+
+  // HTTP/1.1 defaults to keep-alive, HTTP/1.0 to close
+  reqKeepAlive = (lineEnd - sp2 - 1 == 8) && memcmp(sp2 + 1, "HTTP/1.1", 8) == 0;
+  String connHdr = header("Connection");
+  if (equalsIgnoreCase(connHdr.c_str(), connHdr.length(), "close")) reqKeepAlive = false;
+  else if (equalsIgnoreCase(connHdr.c_str(), connHdr.length(), "keep-alive")) reqKeepAlive = true;
+  if (c.requests + 1 >= PORTAL_MAX_REQUESTS) reqKeepAlive = false;
+
+  long contentLength = header("Content-Length").toInt();
+  // compared this way round so a huge value cannot overflow the sum
+  if (contentLength < 0 || contentLength > PORTAL_MAX_REQUEST_LEN - c.headerEnd) {
+    reqKeepAlive = false;
+    writeResponse(413, "text/plain", "", 0);
+    closeConn(c);
+    cur = nullptr;
+    return false;
+  }
+  if (c.headerEnd + contentLength > c.len) {
+    cur = nullptr;
+    return false; // body still arriving
+  }
+  bodyStart = c.headerEnd;
+  bodyLen = (uint16_t)contentLength;
+
+  traceHttp(reqMethod, c.buf + pathStart, pathLen, c.buf + queryStart, queryLen, c.buf + bodyStart, bodyLen);
+
+  // Dispatch
+  THandlerFunction *fn = nullptr;
+  for (uint8_t i = 0; i < routeCount; ++i) {
+    const Route &r = routes[i];
+    bool methodOk = r.method == HTTP_ANY || r.method == reqMethod || (reqHead && r.method == HTTP_GET);
+    if (methodOk && strlen(r.uri) == pathLen && memcmp(r.uri, c.buf + pathStart, pathLen) == 0) {
+      fn = &routes[i].fn;
+      break;
+    }
+  }
+  if (fn) (*fn)();
+  else if (notFound) notFound();
+  if (!responded) writeResponse(notFound || fn ? 500 : 404, "text/plain", "", 0);
+
+  statRequests++;
+  if (!c.inUse) { // handler stopped the server
+    cur = nullptr;
+    return false;
+  }
+  c.requests++;
+  c.lastActivityMs = millis();
+  bool parked = c.parked;
+
+  // drop the consumed request, keep anything pipelined behind it
+  uint16_t consumed = bodyStart + bodyLen;
+  memmove(c.buf, c.buf + consumed, c.len - consumed);
+  c.len -= consumed;
+  c.headerEnd = 0;
+
+  bool keep = reqKeepAlive;
+  cur = nullptr;
+  if (parked) return false; // pipelined requests wait for respond()
+  if (!keep) {
+    closeConn(c);
+    return false;
+  }
+  return true;
+}
+
+String PortalServer::uri() const {
+  if (!cur) return String();
+  return rangeToString(cur->buf + pathStart, pathLen);
+}
+
+String PortalServer::header(const char *name) const {
+  if (!cur) return String();
+  const char *p = cur->buf + headersStart;
+  const char *end = p + headersLen;
+  while (p < end) {
+    const char *eol = (const char*)memchr(p, '\r', end - p);
+    if (!eol) eol = end;
+    const char *colon = (const char*)memchr(p, ':', eol - p);
+    if (colon && equalsIgnoreCase(p, colon - p, name)) {
+      const char *v = colon + 1;
+      while (v < eol && (*v == ' ' || *v == '\t')) ++v;
+      const char *ve = eol;
+      while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) --ve;
+      return rangeToString(v, ve - v);
+    }
+    p = eol + 2;
+  }
+  return String();
+}
+
+bool PortalServer::findParam(const char *start, uint16_t len, const char *name, String *out) const {
+  const char *p = start;
+  const char *end = start + len;
+  size_t nameLen = strlen(name);
+  while (p < end) {
+    const char *amp = (const char*)memchr(p, '&', end - p);
+    if (!amp) amp = end;
+    const char *eq = (const char*)memchr(p, '=', amp - p);
+    const char *keyEnd = eq ? eq : amp;
+    if ((size_t)(keyEnd - p) == nameLen && memcmp(p, name, nameLen) == 0) {
+      if (out) *out = eq ? urlDecode(eq + 1, amp - eq - 1) : String();
+      return true;
+    }
+    p = amp + 1;
+  }
+  return false;
+}
+
+String PortalServer::arg(const char *name) const {
+  String v;
+  if (!cur) return v;
+  if (findParam(cur->buf + queryStart, queryLen, name, &v)) return v;
+  findParam(cur->buf + bodyStart, bodyLen, name, &v);
+  return v;
+}
+
+bool PortalServer::hasArg(const char *name) const {
+  if (!cur) return false;
+  return findParam(cur->buf + queryStart, queryLen, name, nullptr) ||
+         findParam(cur->buf + bodyStart, bodyLen, name, nullptr);
+}
+
+void PortalServer::sendHeader(const char *name, const String &value) {
+  extraHeaders += name;
+  extraHeaders += ": ";
+  extraHeaders += value;
+  extraHeaders += "\r\n";
+}
+
+void PortalServer::send(int code, const char *contentType, const String &content) {
+  writeResponse(code, contentType, content.c_str(), content.length());
+}
+
+void PortalServer::send(int code, const char *contentType, const char *content) {
+  writeResponse(code, contentType, content, strlen(content));
+}
+
+void PortalServer::send_P(int code, const char *contentType, PGM_P content) {
+  // PROGMEM is memory-mapped flash on ESP32, readable in place
+  writeResponse(code, contentType, content, strlen(content));
+}
+
+void PortalServer::send_P(int code, const char *contentType, PGM_P content, size_t contentLength) {
+  writeResponse(code, contentType, content, contentLength);
+}
+
+uint32_t PortalServer::defer() {
+  if (!cur || responded) return 0;
+  responded = true;
+  cur->parked = true;
+  cur->parkedKeepAlive = reqKeepAlive;
+  cur->parkedHead = reqHead;
+  return ((uint32_t)cur->serial << 8) | (uint32_t)(cur - conns + 1);
+}
+
+// Not for use inside a handler: it borrows the current-request state
+bool PortalServer::respond(uint32_t ticket, int code, const char *contentType, const String &content) {
+  uint8_t i = (uint8_t)(ticket & 0xff);
+  if (i == 0 || i > PORTAL_MAX_CONNS) return false;
+  Conn &c = conns[i - 1];
+  if (!c.inUse || !c.parked || c.serial != (uint16_t)(ticket >> 8)) return false;
+
+  cur = &c;
+  reqKeepAlive = c.parkedKeepAlive;
+  reqHead = c.parkedHead;
+  responded = false;
+  extraHeaders = "";
+  writeResponse(code, contentType, content.c_str(), content.length());
+  cur = nullptr;
+
+  c.parked = false;
+  c.lastActivityMs = millis();
+  if (!reqKeepAlive) closeConn(c);
+  return true;
+}
+
+void PortalServer::writeResponse(int code, const char *contentType, const char *body, size_t len) {
+  if (!cur || responded) return;
+  responded = true;
+
+  String head;
+  head.reserve(128 + extraHeaders.length());
+  head += "HTTP/1.1 ";
+  head += String(code);
+  head += ' ';
+  head += statusText(code);
+  head += "\r\n";
+  if (contentType && *contentType) {
+    head += "Content-Type: ";
+    head += contentType;
+    head += "\r\n";
+  }
+  // 204 and 304 have no body, so no Content-Length either (a 304's would
+  // have to be the full 200 body's length)
+  bool bodyless = code == 204 || code == 304;
+  if (!bodyless) {
+    head += "Content-Length: ";
+    head += String((unsigned long)len);
+    head += "\r\n";
+  }
+  if (reqKeepAlive) {
+    head += "Connection: keep-alive\r\nKeep-Alive: timeout=";
+    head += String((unsigned long)(PORTAL_IDLE_TIMEOUT_MS / 1000));
+    head += ", max=";
+    head += String((unsigned long)PORTAL_MAX_REQUESTS);
+    head += "\r\n";
+  } else {
+    head += "Connection: close\r\n";
+  }
+  head += extraHeaders;
+  head += "\r\n";
+
+  cur->client.write((const uint8_t*)head.c_str(), head.length());
+  if (!reqHead && !bodyless && len) cur->client.write((const uint8_t*)body, len);
+}
+
+void PortalServer::closeConn(Conn &c) {
+  c.client.stop();
+  c.client = WiFiClient();
+  c.inUse = false;
+  c.len = 0;
+  c.headerEnd = 0;
+  c.requests = 0;
+  c.parked = false;
+}
@@ -0,0 +1,70 @@
+#include "profile.h"
+
+#ifdef PROFILE_HTTP
+
+#include <freertos/task.h>
+
+// Allocation counters fed by the linker-wrapped allocator below. Every task
+// goes through the wrappers, so they count only while the task that opened
+// the innermost scope is the caller; the Wi-Fi and lwIP tasks allocating on
+// the other core do not land in a handler's numbers. Updates are atomic:
+// the wrappers run on both cores at once.
+static uint32_t allocCount = 0;
+static uint32_t allocBytes = 0;
+static TaskHandle_t allocOwner = nullptr; // set by ProfileScope
+
+static inline void countAlloc(size_t bytes) {
+  TaskHandle_t owner = __atomic_load_n(&allocOwner, __ATOMIC_RELAXED);
+  if (!owner || xTaskGetCurrentTaskHandle() != owner) return;
+  __atomic_fetch_add(&allocCount, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&allocBytes, (uint32_t)bytes, __ATOMIC_RELAXED);
+}
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  countAlloc(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  countAlloc(n * size);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  // String growth goes through realloc; count the new block size
+  countAlloc(size);
+  return __real_realloc(ptr, size);
+}
+}
+
+AllocCounters profileAllocSnapshot() {
+  AllocCounters c;
+  c.allocs = __atomic_load_n(&allocCount, __ATOMIC_RELAXED);
+  c.bytes = __atomic_load_n(&allocBytes, __ATOMIC_RELAXED);
+  return c;
+}
+
+ProfileScope::ProfileScope(const char *name) : name(name) {
+  // scopes nest on one task; the outer owner comes back in the destructor
+  prevOwner = __atomic_exchange_n(&allocOwner, xTaskGetCurrentTaskHandle(), __ATOMIC_RELAXED);
+  startAlloc = profileAllocSnapshot();
+  startCycles = ESP.getCycleCount();
+}
+
+ProfileScope::~ProfileScope() {
+  uint32_t cycles = ESP.getCycleCount() - startCycles;
+  AllocCounters end = profileAllocSnapshot();
+  __atomic_store_n(&allocOwner, prevOwner, __ATOMIC_RELAXED);
+  uint32_t ns = (uint32_t)((uint64_t)cycles * 1000ULL / ESP.getCpuFreqMHz());
+  Serial.printf("{\"prof\":\"%s\",\"ns\":%lu,\"allocs\":%lu,\"bytes\":%lu}\n",
+                name, (unsigned long)ns,
+                (unsigned long)(end.allocs - startAlloc.allocs),
+                (unsigned long)(end.bytes - startAlloc.bytes));
+}
+
+#endif
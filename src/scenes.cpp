@@ -0,0 +1,155 @@
+#include "scenes.h"
+
+#include <esp_partition.h>
+
+const esp_partition_subtype_t SCENE_PARTITION_SUBTYPE = (esp_partition_subtype_t)0x40;
+const size_t SCENE_SECTOR_BYTES = 4096;
+
+static const SceneTable BUILTIN = {
+  SCENE_MAGIC, 0, 3, SCENE_FORMAT, 0,
+  {
+    {"reading",     52000, 40000, 300,  0},
+    {"relax",       38000, 0,     1000, 0},
+    {"night light", 9000,  0,     1500, 0},
+  }
+};
+
+static const esp_partition_t *part = nullptr;
+static const uint8_t *base = nullptr; // mapped partition, nullptr = not mapped
+static spi_flash_mmap_handle_t mapHandle;
+static uint16_t slots = 0;
+static const SceneTable *active = &BUILTIN;
+static int32_t activeSlot = -1; // -1 = built-ins
+static uint32_t maxSeq = 0;     // highest seq on flash, valid or not; new tables go above it
+static uint32_t writes = 0;
+static uint32_t erases = 0;
+
+// CRC-32 (IEEE, reflected), the same as Python's zlib.crc32
+static uint32_t crc32(const uint8_t *p, size_t n) {
+  uint32_t c = 0xFFFFFFFFUL;
+  while (n--) {
+    c ^= *p++;
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320UL & (0 - (c & 1)));
+  }
+  return ~c;
+}
+
+static const SceneTable* slotTable(uint16_t slot) {
+  return (const SceneTable *)(base + (size_t)slot * SCENE_SLOT_BYTES);
+}
+
+static bool valid(const SceneTable *t) {
+  return t->magic == SCENE_MAGIC && t->seq != 0xFFFFFFFFUL && t->format == SCENE_FORMAT &&
+         t->count <= SCENE_MAX && t->crc == crc32((const uint8_t *)t->scenes, t->count * sizeof(Scene));
+}
+
+static bool blank(uint16_t slot) {
+  const uint32_t *w = (const uint32_t *)slotTable(slot);
+  for (size_t i = 0; i < SCENE_SLOT_BYTES / 4; ++i) {
+    if (w[i] != 0xFFFFFFFFUL) return false;
+  }
+  return true;
+}
+
+void scenesBegin() {
+  part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SCENE_PARTITION_SUBTYPE, "scenes");
+  if (part == nullptr) {
+#ifdef DEBUG
+    Serial.println("Scenes: no scenes partition, using built-ins");
+#endif
+    return;
+  }
+  const void *p = nullptr;
+  if (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &p, &mapHandle) != ESP_OK) {
+#ifdef DEBUG
+    Serial.println("Scenes: mmap failed, using built-ins");
+#endif
+    part = nullptr;
+    return;
+  }
+  base = (const uint8_t *)p;
+  slots = part->size / SCENE_SLOT_BYTES;
+  // highest seq wins; only the winner's CRC is computed, falling back if it fails
+  uint32_t below = 0xFFFFFFFFUL;
+  for (;;) {
+    int32_t best = -1;
+    for (uint16_t i = 0; i < slots; ++i) {
+      const SceneTable *t = slotTable(i);
+      if (t->magic != SCENE_MAGIC || t->seq >= below) continue;
+      if (below == 0xFFFFFFFFUL && t->seq > maxSeq) maxSeq = t->seq;
+      if (best < 0 || t->seq > slotTable(best)->seq) best = i;
+    }
+    if (best < 0) break;
+    if (valid(slotTable(best))) {
+      activeSlot = best;
+      active = slotTable(best);
+      break;
+    }
+    below = slotTable(best)->seq;
+  }
+#ifdef DEBUG
+  Serial.printf("Scenes: %u slots, active slot %ld (seq %lu, %u scenes)\n",
+                slots, (long)activeSlot, (unsigned long)active->seq, active->count);
+#endif
+}
+
+uint8_t sceneCount() {
+  return active->count;
+}
+
+const Scene* sceneGet(uint8_t i) {
+  return i < active->count ? &active->scenes[i] : nullptr;
+}
+
+int sceneFind(const char *name) {
+  for (uint8_t i = 0; i < active->count; ++i) {
+    if (strncmp(active->scenes[i].name, name, SCENE_NAME_LEN) == 0) return i;
+  }
+  return -1;
+}
+
+const char* sceneStore(uint8_t i, const Scene &s) {
+  if (base == nullptr) return "No scenes partition";
+  if (i > active->count || i >= SCENE_MAX) return "Scene index out of range";
+
+  SceneTable t;
+  memcpy(&t, active, sizeof(t));
+  t.scenes[i] = s;
+  t.scenes[i].reserved = 0;
+  if (i == t.count) t.count++;
+  t.seq = maxSeq + 1;
+  t.format = SCENE_FORMAT;
+  t.crc = crc32((const uint8_t *)t.scenes, t.count * sizeof(Scene));
+
+  // next slot; a slot that is not blank (torn write) is skipped up to the next sector
+  uint16_t slot = activeSlot < 0 ? 0 : (activeSlot + 1) % slots;
+  const uint16_t perSector = SCENE_SECTOR_BYTES / SCENE_SLOT_BYTES;
+  if (slot % perSector != 0 && !blank(slot)) slot = ((slot / perSector + 1) * perSector) % slots;
+  size_t off = (size_t)slot * SCENE_SLOT_BYTES;
+  if (slot % perSector == 0) {
+    if (esp_partition_erase_range(part, off, SCENE_SECTOR_BYTES) != ESP_OK) return "Flash erase failed";
+    erases++;
+  }
+  // body first, magic last: a reset in between leaves a slot no one trusts
+  if (esp_partition_write(part, off + sizeof(t.magic), (const uint8_t *)&t + sizeof(t.magic), sizeof(t) - sizeof(t.magic)) != ESP_OK ||
+      esp_partition_write(part, off, &t.magic, sizeof(t.magic)) != ESP_OK) {
+    return "Flash write failed";
+  }
+  writes++;
+  maxSeq = t.seq;
+  if (!valid(slotTable(slot))) return "Flash verify failed";
+  activeSlot = slot;
+  active = slotTable(slot);
+  return nullptr;
+}
+
+SceneStoreStats sceneStoreStats() {
+  SceneStoreStats s;
+  s.mapped = base != nullptr;
+  s.seq = active->seq;
+  s.slot = activeSlot < 0 ? 0 : activeSlot;
+  s.slots = slots;
+  s.writes = writes;
+  s.erases = erases;
+  return s;
+}
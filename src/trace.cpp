@@ -0,0 +1,150 @@
+#include "trace.h"
+
+#ifdef TRACE_RECORD
+
+#include <esp_system.h>
+
+#include "config.h"
+
+const uint32_t TRACE_MAGIC = 0x31435254; // "TRC1"
+const uint16_t TRACE_FORMAT = 2;
+
+struct TraceHeader {
+  uint32_t magic;
+  uint16_t format;
+  uint16_t headerSize;
+  uint32_t used;
+  uint32_t dropped;
+  uint32_t resetReason;
+  uint32_t bootPlan;
+  uint32_t bootFails;
+  uint32_t startMs;
+};
+
+struct TraceRecord {
+  uint32_t atMs;
+  uint8_t kind;
+  uint8_t len;
+  uint16_t arg;
+};
+
+static_assert(sizeof(TraceHeader) == 32, "trace header layout is part of the download format");
+static_assert(sizeof(TraceRecord) == 8, "trace record layout is part of the download format");
+static_assert(TRACE_MAX_PAYLOAD <= 255, "payload length is one byte");
+
+alignas(4) static uint8_t buf[TRACE_BUFFER_BYTES];
+static TraceHeader *const header = (TraceHeader*)buf;
+
+// Reserve a record of len payload bytes; nullptr (and counted) when full
+static uint8_t* append(TraceKind kind, uint16_t arg, size_t len) {
+  if (header->magic != TRACE_MAGIC) return nullptr; // before traceBegin()
+  if (len > TRACE_MAX_PAYLOAD) len = TRACE_MAX_PAYLOAD;
+  if (header->used + sizeof(TraceRecord) + len > TRACE_BUFFER_BYTES) {
+    header->dropped++;
+    return nullptr;
+  }
+  TraceRecord r = {(uint32_t)millis(), (uint8_t)kind, (uint8_t)len, arg};
+  uint8_t *p = buf + header->used;
+  memcpy(p, &r, sizeof(r));
+  header->used += sizeof(r) + len;
+  return p + sizeof(r);
+}
+
+void traceBegin(uint8_t bootPlan, uint8_t bootFails) {
+  header->magic = TRACE_MAGIC;
+  header->format = TRACE_FORMAT;
+  header->headerSize = sizeof(TraceHeader);
+  header->used = sizeof(TraceHeader);
+  header->dropped = 0;
+  header->resetReason = esp_reset_reason();
+  header->bootPlan = bootPlan;
+  header->bootFails = bootFails;
+  header->startMs = millis();
+  // overrides from earlier boots; later ones arrive as POST /config records
+  for (size_t i = 0; i < CFG_COUNT; ++i) {
+    if (!configIsOverridden(i)) continue;
+    uint8_t *p = append(TraceKind::CONFIG, (uint16_t)i, sizeof(uint32_t));
+    if (p) memcpy(p, &cfgValues[i], sizeof(uint32_t));
+  }
+}
+
+void traceOnEvent(const Event &e) {
+  uint8_t *p = append(TraceKind::EVENT, (uint16_t)((uint8_t)e.type | e.code << 8), 1);
+  if (!p) return;
+  memcpy(p - sizeof(TraceRecord), &e.atMs, sizeof(e.atMs)); // when it happened, not when loop() got to it
+  p[0] = e.level;
+}
+
+void traceHttp(uint8_t method, const char *path, uint16_t pathLen, const char *query, uint16_t queryLen,
+               const char *body, uint16_t bodyLen) {
+  // assembled here first: the pass= redaction changes the length
+  char text[TRACE_MAX_PAYLOAD];
+  size_t n = 0;
+  auto put = [&](const char *s, size_t len) {
+    while (len-- && n < sizeof(text)) text[n++] = *s++;
+  };
+  auto putParams = [&](const char *s, uint16_t len) {
+    // key=value&...; the Wi-Fi password never goes into a downloadable trace
+    const char *end = s + len;
+    while (s < end) {
+      const char *amp = (const char*)memchr(s, '&', end - s);
+      const char *next = amp ? amp : end;
+      if (next - s >= 5 && memcmp(s, "pass=", 5) == 0) {
+        // only the length is kept: it decides how /save validates the value
+        put("pass=", 5);
+        for (const char *c = s + 5; c < next; ++c) {
+          put("*", 1);
+          if (*c == '%' && next - c >= 3) c += 2; // one character, URL-encoded
+        }
+      } else {
+        put(s, next - s);
+      }
+      if (amp) put("&", 1);
+      s = amp ? amp + 1 : end;
+    }
+  };
+  put(path, pathLen);
+  if (queryLen) {
+    put("?", 1);
+    putParams(query, queryLen);
+  }
+  if (bodyLen) {
+    put(" ", 1);
+    putParams(body, bodyLen);
+  }
+  uint8_t *p = append(TraceKind::HTTP, method, n);
+  if (p) memcpy(p, text, n);
+}
+
+void traceScan(const String &ssid, int32_t rssi, uint8_t channel, uint8_t auth) {
+  size_t len = 1 + ssid.length();
+  uint8_t *p = append(TraceKind::SCAN, (uint16_t)(channel | (uint8_t)(int8_t)rssi << 8), len);
+  if (!p) return;
+  p[0] = auth;
+  memcpy(p + 1, ssid.c_str(), (len > TRACE_MAX_PAYLOAD ? TRACE_MAX_PAYLOAD : len) - 1);
+}
+
+void traceScanDone(uint8_t channel, int16_t found) {
+  uint8_t *p = append(TraceKind::SCAN_DONE, channel, 1);
+  if (p) p[0] = found <= 0 ? 0 : found > 255 ? 255 : (uint8_t)found;
+}
+
+const uint8_t* traceData() {
+  return buf;
+}
+
+size_t traceSize() {
+  return header->magic == TRACE_MAGIC ? header->used : 0;
+}
+
+uint32_t traceDropped() {
+  return header->dropped;
+}
+
+void traceClear() {
+  if (header->magic != TRACE_MAGIC) return;
+  header->used = sizeof(TraceHeader);
+  header->dropped = 0;
+}
+
+#endif
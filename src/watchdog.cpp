@@ -0,0 +1,122 @@
+#include "watchdog.h"
+
+#include "board.h"
+
+#include <esp_task_wdt.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+const uint32_t WDT_CHECK_PERIOD_MS = 500;
+const uint32_t WDT_RECORD_MAGIC = 0x57445431; // "WDT1"
+
+struct Heartbeat {
+  volatile uint32_t deadlineMs; // 0 = not registered
+  volatile uint32_t lastKickMs;
+  volatile uint32_t maxGapMs;
+};
+
+// Survives a watchdog reset (not a power cycle); validated by magic
+struct WatchdogRecord {
+  uint32_t magic;
+  uint8_t subsystem;
+  uint32_t gapMs;
+};
+
+static Heartbeat beats[SUBSYSTEM_COUNT];
+static RTC_NOINIT_ATTR WatchdogRecord wdtRecord;
+static_assert(sizeof(WatchdogRecord) <= Board::RTC_SLOW_BYTES / 16, "WDT record should stay a small slice of RTC memory");
+static WatchdogRecord lastReset;
+static bool lastResetValid = false;
+
+static void supervisorTask(void *arg) {
+  esp_task_wdt_add(NULL);
+  bool tripped = false;
+  for (;;) {
+    // Blame the most overdue subsystem, not the first stale one: loop()
+    // kicks them in turn, so a pass stuck in one call leaves every later
+    // heartbeat stale too, and the one that stopped first is the culprit.
+    int worst = -1;
+    uint32_t worstGap = 0;
+    for (size_t i = 0; i < SUBSYSTEM_COUNT && !tripped; ++i) {
+      uint32_t deadline = beats[i].deadlineMs;
+      if (deadline == 0) continue;
+      // read the kick before the clock: a kick landing in between must not look like a huge gap
+      uint32_t last = beats[i].lastKickMs;
+      uint32_t gap = millis() - last;
+      if (gap > deadline && gap > worstGap) {
+        worst = (int)i;
+        worstGap = gap;
+      }
+    }
+    if (worst >= 0) {
+      wdtRecord.subsystem = (uint8_t)worst;
+      wdtRecord.gapMs = worstGap;
+      wdtRecord.magic = WDT_RECORD_MAGIC;
+      Serial.printf("WDT: %s missed its %lu ms deadline (%lu ms), resetting\n",
+                    subsystemName((Subsystem)worst), (unsigned long)beats[worst].deadlineMs,
+                    (unsigned long)worstGap);
+      tripped = true;
+    }
+    // once tripped, stop feeding and let the task watchdog reset the chip
+    if (!tripped) esp_task_wdt_reset();
+    vTaskDelay(pdMS_TO_TICKS(WDT_CHECK_PERIOD_MS));
+  }
+}
+
+void watchdogBegin(uint32_t twdtTimeoutS) {
+  if (wdtRecord.magic == WDT_RECORD_MAGIC && wdtRecord.subsystem < SUBSYSTEM_COUNT) {
+    lastReset = wdtRecord;
+    lastResetValid = true;
+  }
+  wdtRecord.magic = 0;
+
+  esp_task_wdt_init(twdtTimeoutS, true);
+  if (Board::CORES > 1) {
+    // on the core loop() does not run on, so a loop() spinning at a higher priority cannot starve it
+    xTaskCreatePinnedToCore(supervisorTask, "wdt_sup", 2048, nullptr, 2, nullptr, ARDUINO_RUNNING_CORE ? 0 : 1);
+  } else {
+    xTaskCreate(supervisorTask, "wdt_sup", 2048, nullptr, 2, nullptr);
+  }
+}
+
+void watchdogRegister(Subsystem s, uint32_t deadlineMs) {
+  Heartbeat &b = beats[(size_t)s];
+  b.lastKickMs = millis();
+  b.maxGapMs = 0;
+  b.deadlineMs = deadlineMs;
+}
+
+void watchdogUnregister(Subsystem s) {
+  beats[(size_t)s].deadlineMs = 0;
+}
+
+void watchdogKick(Subsystem s) {
+  Heartbeat &b = beats[(size_t)s];
+  if (b.deadlineMs == 0) return;
+  uint32_t now = millis();
+  uint32_t gap = now - b.lastKickMs;
+  if (gap > b.maxGapMs) b.maxGapMs = gap;
+  b.lastKickMs = now;
+}
+
+uint32_t watchdogMaxGapMs(Subsystem s) {
+  return beats[(size_t)s].maxGapMs;
+}
+
+bool watchdogLastReset(Subsystem *s, uint32_t *gapMs) {
+  if (!lastResetValid) return false;
+  *s = (Subsystem)lastReset.subsystem;
+  *gapMs = lastReset.gapMs;
+  return true;
+}
+
+const char* subsystemName(Subsystem s) {
+  switch (s) {
+    case Subsystem::NETWORK: return "NETWORK";
+    case Subsystem::HTTP: return "HTTP";
+    case Subsystem::DNS: return "DNS";
+    case Subsystem::LED: return "LED";
+    case Subsystem::BUTTONS: return "BUTTONS";
+    default: return "?";
+  }
+}
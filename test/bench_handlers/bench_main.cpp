@@ -0,0 +1,221 @@
+/*
+Host benchmark: the portal's HTTP handlers on the real firmware
+
+Links each file of src/ against test/fakes, boots the bulb unprovisioned
+(setup(), then loop() until the portal is up) and runs a progressive scan
+over a fixed set of fake networks. Then each case runs N times:
+
+  scan         GET /scan after the scan finished (buildScanJson)
+  status       GET /status, the portal's 1 s poll
+  save         POST /save with credentials for a scanned network
+  last4MacHex  the AP name suffix, called directly
+
+The HTTP cases time one PortalServer::handleClient() on a keep-alive
+connection: reading and parsing the request, the handler, and writing the
+reply into the fake socket. Work between runs is not timed: reconnecting
+when the server closes the connection after PORTAL_MAX_REQUESTS, and for
+save, running loop() through the connect attempt (the fake access point
+rejects the password) until the deferred reply is out and the next /save
+is accepted again.
+
+malloc/calloc/realloc and operator new are replaced to count allocations
+while a case runs. One JSON line per case on stdout:
+
+  {"handler":"scan","ns_per_op":2345,"bytes":1024,"allocs":12}
+
+bytes and allocs are per run (requested sizes, frees are not subtracted).
+Host ns are only good for comparing two builds on the same machine; the
+allocation counts carry over to the device, where
+env:esp32doit-devkit-v1-profile measures the same handlers
+(include/profile.h).
+
+  make && ./bench_handlers [runs]      (default 2000)
+*/
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "portal_server.h"
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <new>
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+static bool counting;
+static unsigned long long allocCount, allocBytes;
+
+static void count(size_t n) {
+  if (!counting) return;
+  allocCount++;
+  allocBytes += n;
+}
+
+extern "C" void *malloc(size_t n) {
+  count(n);
+  return __libc_malloc(n);
+}
+extern "C" void *calloc(size_t n, size_t size) {
+  count(n * size);
+  return __libc_calloc(n, size);
+}
+extern "C" void *realloc(void *p, size_t n) {
+  count(n);
+  return __libc_realloc(p, n);
+}
+extern "C" void free(void *p) { __libc_free(p); }
+
+void *operator new(size_t n) {
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// From src/main.cpp
+extern PortalServer server;
+void setup();
+void loop();
+String last4MacHex();
+
+struct Stats {
+  unsigned long long ns;
+  unsigned long long allocs;
+  unsigned long long bytes;
+};
+
+template <typename F> static void timed(Stats &st, F fn) {
+  allocCount = allocBytes = 0;
+  counting = true;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  fn();
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  counting = false;
+  st.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  st.allocs += allocCount;
+  st.bytes += allocBytes;
+}
+
+static void report(const char *handler, const Stats &st, unsigned runs) {
+  printf("{\"handler\":\"%s\",\"ns_per_op\":%llu,\"bytes\":%llu,\"allocs\":%llu}\n", handler, st.ns / runs,
+         st.bytes / runs, st.allocs / runs);
+}
+
+static void fail(const char *what, const std::string &reply) {
+  fprintf(stderr, "bench_handlers: %s\n%s\n", what, reply.c_str());
+  exit(1);
+}
+
+static std::shared_ptr<FakeSocket> sock;
+
+// The keep-alive connection, reopened once the server has closed it
+static std::shared_ptr<FakeSocket> client() {
+  if (!sock || !sock->open) {
+    sock = fakeConnect();
+    server.handleClient();
+  }
+  return sock;
+}
+
+static int replyCode(const std::string &out) { return out.size() > 12 ? atoi(out.c_str() + 9) : 0; }
+
+// One request; only the handleClient() that serves it is timed
+static const std::string &serve(Stats *st, const std::string &req) {
+  std::shared_ptr<FakeSocket> s = client();
+  s->fromServer.clear();
+  s->toServer = req;
+  if (st) timed(*st, [] { server.handleClient(); });
+  else server.handleClient();
+  return s->fromServer;
+}
+
+static std::string post(const char *path, const std::string &body) {
+  return std::string("POST ") + path + " HTTP/1.1\r\nHost: 192.168.4.1\r\n"
+         "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(body.size()) +
+         "\r\n\r\n" + body;
+}
+
+static std::string get(const char *path) {
+  return std::string("GET ") + path + " HTTP/1.1\r\nHost: 192.168.4.1\r\nAccept: */*\r\n\r\n";
+}
+
+static void bootPortal() {
+  // what a flat in town might show: 2.4 GHz channels only, one SSID that
+  // needs JSON escaping, one open and one WEP network
+  static const FakeNetwork nets[] = {
+      {"Office-2G", -48, 6, WIFI_AUTH_WPA2_PSK},     {"FRITZ!Box 7590 XY", -61, 1, WIFI_AUTH_WPA2_PSK},
+      {"Vodafone-4F2A", -67, 11, WIFI_AUTH_WPA_WPA2_PSK}, {"DIRECT-7B-HP M281", -70, 6, WIFI_AUTH_WPA2_PSK},
+      {"Caf\xc3\xa9 \"Guest\"", -72, 1, WIFI_AUTH_OPEN},  {"eduroam", -75, 11, WIFI_AUTH_WPA2_ENTERPRISE},
+      {"TP-Link_3A9C", -78, 3, WIFI_AUTH_WPA2_PSK},  {"Telekom-8812", -80, 9, WIFI_AUTH_WPA2_WPA3_PSK},
+      {"old-router", -84, 6, WIFI_AUTH_WEP},         {"Neighbour 5", -88, 13, WIFI_AUTH_WPA2_PSK},
+  };
+  fakeWiFi().air.assign(nets, nets + sizeof(nets) / sizeof(nets[0]));
+
+  setup();
+  for (int i = 0; i < 50 && fakeWiFi().apSsid.empty(); ++i) loop();
+  if (fakeWiFi().apSsid.empty()) fail("portal did not come up", "");
+
+  serve(nullptr, get("/scan?start=1"));
+  for (int i = 0; i < 1000; ++i) {
+    loop();
+    if (serve(nullptr, get("/scan")).find("\"done\":true") != std::string::npos) return;
+  }
+  fail("scan did not finish", sock->fromServer);
+}
+
+// Lets the deferred /save finish: the access point turns down every attempt
+static void finishSave() {
+  uint32_t begins = fakeWiFi().begins;
+  for (int i = 0; i < 10000; ++i) {
+    loop();
+    if (fakeWiFi().begins != begins) {
+      begins = fakeWiFi().begins;
+      fakeWiFiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT);
+    }
+    if (!sock->fromServer.empty()) return;
+  }
+  fail("/save was never answered", "");
+}
+
+int main(int argc, char **argv) {
+  unsigned runs = argc > 1 ? (unsigned)strtoul(argv[1], nullptr, 10) : 2000;
+  if (runs == 0) runs = 1;
+  bootPortal();
+
+  Stats scan = {}, status = {}, save = {}, mac = {};
+  const std::string scanReq = get("/scan");
+  const std::string statusReq = get("/status");
+  const std::string saveReq = post("/save", "ssid=Office-2G&pass=correct-horse-battery");
+
+  for (unsigned i = 0; i < runs; ++i) {
+    if (replyCode(serve(&scan, scanReq)) != 200) fail("GET /scan", sock->fromServer);
+  }
+  report("scan", scan, runs);
+
+  for (unsigned i = 0; i < runs; ++i) {
+    if (replyCode(serve(&status, statusReq)) != 200) fail("GET /status", sock->fromServer);
+  }
+  report("status", status, runs);
+
+  for (unsigned i = 0; i < runs; ++i) {
+    if (!serve(&save, saveReq).empty()) fail("POST /save was not deferred", sock->fromServer);
+    finishSave();
+  }
+  report("save", save, runs);
+
+  size_t sink = 0;
+  for (unsigned i = 0; i < runs; ++i) {
+    timed(mac, [&sink] { sink += last4MacHex().length(); });
+  }
+  report("last4MacHex", mac, runs);
+  return sink == 0;
+}
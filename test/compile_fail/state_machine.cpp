@@ -0,0 +1,36 @@
+// Tables and calls that include/state_machine.h must refuse to compile.
+// Built once per case by the Makefile; each must fail with its message.
+
+#include "run_table.h"
+
+bool staLinkUp() { return true; }
+void enterSetupPattern() {}
+void showConnected() {}
+
+static const char *stateName(RunState) { return ""; }
+static const char *eventName(RunEvent) { return ""; }
+
+#if defined(SHADOWED_ROW)
+// the second row can never run: the first has no guard
+typedef FsmTable<RunState, RunEvent,
+  RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED>,
+  RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::AP_SETUP>
+> Table;
+#elif defined(UNHANDLED_EVENT)
+// no row for PORTAL_UP, which main() fires below
+typedef FsmTable<RunState, RunEvent,
+  RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED, staLinkUp>
+> Table;
+#else
+typedef RunTable Table; // control: must compile
+#endif
+
+int main() {
+  RunState state = RunState::CONNECTING;
+  StateMachine<RunState, RunEvent, Table> fsm(state, stateName, eventName, nullptr);
+  fsm.fire<RunEvent::STA_UP>();
+#if !defined(SHADOWED_ROW)
+  fsm.fire<RunEvent::PORTAL_UP>();
+#endif
+  return 0;
+}
@@ -0,0 +1,238 @@
+/*
+Host stand-in for the parts of the Arduino core the firmware uses
+
+Only for [env:native] and the host programs under test/ (each puts this
+directory on the include path). String keeps the Arduino API on top of
+std::string; millis() reads a virtual clock that tests move with delay() or
+by setting fakeNowMs(), so timeouts run without sleeping. GPIO levels,
+interrupt handlers and LEDC duties live in fakePins() / fakeLedc(), and
+fakeSetPin() drives an input the way a button would. Everything is inline
+so each test suite can include the module sources it needs without a
+shared fake library.
+*/
+
+#pragma once
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#define PROGMEM
+#define PGM_P const char *
+#define F(s) (s)
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define ARDUINO_RUNNING_CORE 1
+
+#define HIGH 1
+#define LOW 0
+#define DEC 10
+#define HEX 16
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String {
+public:
+  String() {}
+  String(const char *c) : s(c ? c : "") {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int v, unsigned char base = DEC) { format(base == HEX ? "%x" : "%d", v); }
+  explicit String(unsigned int v, unsigned char base = DEC) { format(base == HEX ? "%x" : "%u", v); }
+  explicit String(long v, unsigned char base = DEC) { format(base == HEX ? "%lx" : "%ld", v); }
+  explicit String(unsigned long v, unsigned char base = DEC) { format(base == HEX ? "%lx" : "%lu", v); }
+  explicit String(float v, unsigned int decimals = 2) { format("%.*f", (int)decimals, (double)v); }
+  explicit String(double v, unsigned int decimals = 2) { format("%.*f", (int)decimals, v); }
+
+  unsigned int length() const { return s.size(); }
+  const char *c_str() const { return s.c_str(); }
+  bool reserve(unsigned int n) { s.reserve(n); return true; }
+  bool isEmpty() const { return s.empty(); }
+  void clear() { s.clear(); }
+
+  String &operator+=(const String &o) { s += o.s; return *this; }
+  String &operator+=(const char *o) { s += o; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  String &operator+=(int v) { return *this += String(v); }
+  String &operator+=(unsigned int v) { return *this += String(v); }
+  String &operator+=(long v) { return *this += String(v); }
+  String &operator+=(unsigned long v) { return *this += String(v); }
+  bool concat(const char *c, unsigned int n) { s.append(c, n); return true; }
+  bool concat(const String &o) { s += o.s; return true; }
+  bool concat(const char *c) { s += c; return true; }
+  bool concat(char c) { s += c; return true; }
+
+  friend String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+  friend String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+  friend String operator+(const String &a, char b) { String r(a); r += b; return r; }
+
+  friend String operator+(const String &a, int b) { return a + String(b); }
+  friend String operator+(const String &a, unsigned int b) { return a + String(b); }
+  friend String operator+(const String &a, long b) { return a + String(b); }
+  friend String operator+(const String &a, unsigned long b) { return a + String(b); }
+
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator==(const char *o) const { return s == o; }
+  bool operator!=(const String &o) const { return s != o.s; }
+  bool equals(const String &o) const { return s == o.s; }
+  char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+
+  int indexOf(char c) const { return find(s.find(c)); }
+  int indexOf(const String &o) const { return find(s.find(o.s)); }
+  bool startsWith(const String &o) const { return s.compare(0, o.s.size(), o.s) == 0; }
+  String substring(unsigned int from) const { return substring(from, s.size()); }
+  String substring(unsigned int from, unsigned int to) const {
+    String r;
+    if (from < to && from < s.size()) r.s = s.substr(from, to - from);
+    return r;
+  }
+  long toInt() const { return atol(s.c_str()); }
+  void replace(const char *from, const char *to) {
+    size_t n = strlen(from);
+    if (n == 0) return;
+    for (size_t p = s.find(from); p != std::string::npos; p = s.find(from, p + strlen(to))) s.replace(p, n, to);
+  }
+  void toUpperCase() {
+    for (char &c : s) c = (char)toupper((unsigned char)c);
+  }
+
+private:
+  void format(const char *fmt, ...) {
+    char b[40];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(b, sizeof(b), fmt, ap);
+    va_end(ap);
+    s = b;
+  }
+  static int find(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+  std::string s;
+};
+
+class Print {
+public:
+  size_t write(const uint8_t *, size_t n) { return n; }
+  size_t print(const char *) { return 0; }
+  size_t print(const String &) { return 0; }
+  size_t println(const char * = "") { return 0; }
+  size_t println(const String &) { return 0; }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vprintf(fmt, ap);
+    va_end(ap);
+    return n < 0 ? 0 : n;
+  }
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+};
+
+inline HardwareSerial &fakeSerial() {
+  static HardwareSerial port;
+  return port;
+}
+#define Serial fakeSerial()
+
+// Virtual clock, in ms since the test started
+inline unsigned long &fakeNowMs() {
+  static unsigned long ms = 0;
+  return ms;
+}
+inline unsigned long millis() { return fakeNowMs(); }
+inline unsigned long micros() { return fakeNowMs() * 1000UL; }
+inline void delay(unsigned long ms) { fakeNowMs() += ms; }
+inline void delayMicroseconds(unsigned int) {}
+inline void yield() {}
+
+// GPIO: levels read back what was written; an input with no driver reads
+// HIGH (the buttons are active low with pull-ups)
+struct FakePins {
+  uint8_t level[64];
+  uint8_t mode[64];
+  void (*isr[64])();
+  FakePins() {
+    memset(level, HIGH, sizeof(level));
+    memset(mode, 0, sizeof(mode));
+    memset(isr, 0, sizeof(isr));
+  }
+};
+inline FakePins &fakePins() {
+  static FakePins p;
+  return p;
+}
+inline void pinMode(uint8_t pin, uint8_t mode) { fakePins().mode[pin & 63] = mode; }
+inline void digitalWrite(uint8_t pin, uint8_t v) { fakePins().level[pin & 63] = v ? HIGH : LOW; }
+inline int digitalRead(uint8_t pin) { return fakePins().level[pin & 63]; }
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t pin, void (*isr)(), int) { fakePins().isr[pin & 63] = isr; }
+inline void detachInterrupt(uint8_t pin) { fakePins().isr[pin & 63] = nullptr; }
+// An external level change on an input: runs its CHANGE handler like the GPIO interrupt would
+inline void fakeSetPin(uint8_t pin, uint8_t v) {
+  FakePins &p = fakePins();
+  uint8_t level = v ? HIGH : LOW;
+  if (p.level[pin & 63] == level) return;
+  p.level[pin & 63] = level;
+  if (p.isr[pin & 63]) p.isr[pin & 63]();
+}
+
+// LEDC: the last duty written per channel
+struct FakeLedc {
+  uint32_t duty[16];
+  uint8_t pin[16];
+  FakeLedc() {
+    memset(duty, 0, sizeof(duty));
+    memset(pin, 0, sizeof(pin));
+  }
+};
+inline FakeLedc &fakeLedc() {
+  static FakeLedc l;
+  return l;
+}
+inline double ledcSetup(uint8_t, double freq, uint8_t) { return freq; }
+inline void ledcAttachPin(uint8_t pin, uint8_t ch) { fakeLedc().pin[ch & 15] = pin; }
+inline void ledcWrite(uint8_t ch, uint32_t duty) { fakeLedc().duty[ch & 15] = duty; }
+
+// ESP: restart() only counts (the caller carries on, so a test sees what led to it)
+class EspClass {
+public:
+  void restart() { restarts++; }
+  uint32_t getFreeHeap() { return 200000; }
+  uint32_t getMinFreeHeap() { return 150000; }
+  uint32_t getMaxAllocHeap() { return 110000; }
+  uint32_t getCpuFreqMHz() { return 240; }
+  // cycles of the virtual clock at 240 MHz
+  uint32_t getCycleCount() { return (uint32_t)(micros() * 240UL); }
+  uint32_t restarts = 0;
+};
+inline EspClass &fakeEsp() {
+  static EspClass esp;
+  return esp;
+}
+#define ESP fakeEsp()
+
+// The core pulls these in for every sketch
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
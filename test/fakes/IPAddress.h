@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+
+class IPAddress {
+public:
+  IPAddress() : b{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t c, uint8_t d, uint8_t e) : b{a, c, d, e} {}
+  uint8_t operator[](int i) const { return b[i & 3]; }
+  bool operator==(const IPAddress &o) const { return memcmp(b, o.b, 4) == 0; }
+  String toString() const {
+    char s[16];
+    snprintf(s, sizeof(s), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+    return String(s);
+  }
+
+private:
+  uint8_t b[4];
+};
@@ -0,0 +1,90 @@
+/*
+Host stand-in for Preferences (NVS): an in-memory map per namespace
+
+fakeNvs() outlives every Preferences object, like flash does, so a test can
+seed it before setup() or read back what the firmware stored. Values keep
+their bytes only; the NVS type of a key is not checked.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+
+typedef std::map<std::string, std::string> FakeNvsNamespace;
+
+inline std::map<std::string, FakeNvsNamespace> &fakeNvs() {
+  static std::map<std::string, FakeNvsNamespace> nvs;
+  return nvs;
+}
+
+class Preferences {
+public:
+  bool begin(const char *name, bool readOnly = false, const char * = nullptr) {
+    ns = &fakeNvs()[name];
+    ro = readOnly;
+    return true;
+  }
+  void end() { ns = nullptr; }
+
+  bool clear() {
+    if (!writable()) return false;
+    ns->clear();
+    return true;
+  }
+  bool remove(const char *key) { return writable() && ns->erase(key) > 0; }
+  bool isKey(const char *key) { return ns && ns->count(key) > 0; }
+
+  size_t putUChar(const char *key, uint8_t v) { return put(key, &v, sizeof(v)); }
+  size_t putUShort(const char *key, uint16_t v) { return put(key, &v, sizeof(v)); }
+  size_t putUInt(const char *key, uint32_t v) { return put(key, &v, sizeof(v)); }
+  size_t putULong(const char *key, uint32_t v) { return put(key, &v, sizeof(v)); }
+  size_t putBool(const char *key, bool v) { return putUChar(key, v); }
+  size_t putString(const char *key, const String &v) { return put(key, v.c_str(), v.length()) ? v.length() : 0; }
+  size_t putBytes(const char *key, const void *v, size_t n) { return put(key, v, n); }
+
+  uint8_t getUChar(const char *key, uint8_t def = 0) { return get(key, def); }
+  uint16_t getUShort(const char *key, uint16_t def = 0) { return get(key, def); }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { return get(key, def); }
+  uint32_t getULong(const char *key, uint32_t def = 0) { return get(key, def); }
+  bool getBool(const char *key, bool def = false) { return getUChar(key, def) != 0; }
+  String getString(const char *key, String def = String()) {
+    const std::string *v = find(key);
+    return v ? String(v->c_str()) : def;
+  }
+  size_t getBytesLength(const char *key) {
+    const std::string *v = find(key);
+    return v ? v->size() : 0;
+  }
+  size_t getBytes(const char *key, void *buf, size_t n) {
+    const std::string *v = find(key);
+    if (!v || v->size() > n) return 0;
+    memcpy(buf, v->data(), v->size());
+    return v->size();
+  }
+
+private:
+  bool writable() const { return ns && !ro; }
+  size_t put(const char *key, const void *v, size_t n) {
+    if (!writable()) return 0;
+    (*ns)[key].assign((const char *)v, n);
+    return n;
+  }
+  const std::string *find(const char *key) const {
+    if (!ns) return nullptr;
+    FakeNvsNamespace::const_iterator it = ns->find(key);
+    return it == ns->end() ? nullptr : &it->second;
+  }
+  template <typename T>
+  T get(const char *key, T def) {
+    const std::string *v = find(key);
+    if (!v || v->size() != sizeof(T)) return def;
+    T out;
+    memcpy(&out, v->data(), sizeof(T));
+    return out;
+  }
+
+  FakeNvsNamespace *ns = nullptr;
+  bool ro = false;
+};
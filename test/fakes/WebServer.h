@@ -0,0 +1,25 @@
+/*
+Host stand-in for WebServer.h: only the HTTPMethod values
+
+arduino-esp32 takes them from http_parser, so they are listed here in that
+order; tools/trace_replay.py decodes recorded methods with the same table.
+*/
+
+#pragma once
+
+#include <WiFi.h>
+
+enum http_method {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+  HTTP_CONNECT = 5,
+  HTTP_OPTIONS = 6,
+  HTTP_TRACE = 7,
+  HTTP_PATCH = 28,
+};
+
+typedef enum http_method HTTPMethod;
+#define HTTP_ANY (HTTPMethod)(255)
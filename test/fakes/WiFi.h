@@ -0,0 +1,293 @@
+/*
+Host stand-in for WiFi.h: the radio, its events, and in-memory sockets
+
+WiFiClient and WiFiServer talk over a FakeSocket a test owns. The test
+queues a socket with fakeConnect(), writes the request bytes into its
+toServer, runs handleClient() and reads the reply from fromServer. Closing
+either side clears open.
+
+WiFi (fakeWiFi()) keeps mode and status and does nothing on its own: begin()
+and disconnect() raise no events. A test plays the access point with
+fakeWiFiEvent(), which runs the handler the firmware gave onEvent(), and
+sets status to match. Scans find fakeWiFi().air on the requested channel
+once the requested dwell time has passed on the virtual clock; with
+autoScan off a scan runs until finishScan() hands it its results.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <esp_wifi.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Values as in esp_wifi_types.h (IDF 4.4)
+typedef enum {
+  WIFI_REASON_UNSPECIFIED = 1,
+  WIFI_REASON_AUTH_EXPIRE = 2,
+  WIFI_REASON_AUTH_LEAVE = 3,
+  WIFI_REASON_ASSOC_EXPIRE = 4,
+  WIFI_REASON_ASSOC_TOOMANY = 5,
+  WIFI_REASON_NOT_AUTHED = 6,
+  WIFI_REASON_NOT_ASSOCED = 7,
+  WIFI_REASON_ASSOC_LEAVE = 8,
+  WIFI_REASON_ASSOC_NOT_AUTHED = 9,
+  WIFI_REASON_DISASSOC_PWRCAP_BAD = 10,
+  WIFI_REASON_DISASSOC_SUPCHAN_BAD = 11,
+  WIFI_REASON_IE_INVALID = 13,
+  WIFI_REASON_MIC_FAILURE = 14,
+  WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+  WIFI_REASON_GROUP_KEY_UPDATE_TIMEOUT = 16,
+  WIFI_REASON_IE_IN_4WAY_DIFFERS = 17,
+  WIFI_REASON_GROUP_CIPHER_INVALID = 18,
+  WIFI_REASON_PAIRWISE_CIPHER_INVALID = 19,
+  WIFI_REASON_AKMP_INVALID = 20,
+  WIFI_REASON_UNSUPP_RSN_IE_VERSION = 21,
+  WIFI_REASON_INVALID_RSN_IE_CAP = 22,
+  WIFI_REASON_802_1X_AUTH_FAILED = 23,
+  WIFI_REASON_CIPHER_SUITE_REJECTED = 24,
+  WIFI_REASON_INVALID_PMKID = 53,
+  WIFI_REASON_BEACON_TIMEOUT = 200,
+  WIFI_REASON_NO_AP_FOUND = 201,
+  WIFI_REASON_AUTH_FAIL = 202,
+  WIFI_REASON_ASSOC_FAIL = 203,
+  WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+  WIFI_REASON_CONNECTION_FAIL = 205,
+  WIFI_REASON_AP_TSF_RESET = 206,
+  WIFI_REASON_ROAMING = 207,
+} wifi_err_reason_t;
+
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+  WIFI_AUTH_WPA_WPA2_PSK,
+  WIFI_AUTH_WPA2_ENTERPRISE,
+  WIFI_AUTH_WPA3_PSK,
+  WIFI_AUTH_WPA2_WPA3_PSK,
+  WIFI_AUTH_WAPI_PSK,
+  WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_MODE_NULL = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+// Values as in arduino-esp32 2.0.x WiFiGeneric.h
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_SCAN_DONE,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+  ARDUINO_EVENT_WIFI_AP_START,
+  ARDUINO_EVENT_WIFI_AP_STOP,
+  ARDUINO_EVENT_WIFI_AP_STACONNECTED,
+  ARDUINO_EVENT_WIFI_AP_STADISCONNECTED,
+} arduino_event_id_t;
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef void (*WiFiEventFuncCb)(WiFiEvent_t, WiFiEventInfo_t);
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+struct FakeNetwork {
+  std::string ssid;
+  int32_t rssi;
+  uint8_t channel;
+  wifi_auth_mode_t auth;
+};
+
+class WiFiClass {
+public:
+  wl_status_t status() { return st; }
+  bool mode(wifi_mode_t m) {
+    md = m;
+    return true;
+  }
+  wifi_mode_t getMode() { return md; }
+  wl_status_t begin(const char *ssid, const char *pass = nullptr, int32_t = 0, const uint8_t * = nullptr, bool = true) {
+    joinSsid = ssid ? ssid : "";
+    joinPass = pass ? pass : "";
+    begins++;
+    st = WL_DISCONNECTED;
+    return st;
+  }
+  bool disconnect(bool = false, bool = false) {
+    st = WL_DISCONNECTED;
+    return true;
+  }
+  bool setAutoReconnect(bool on) {
+    autoReconnect = on;
+    return true;
+  }
+  IPAddress localIP() { return st == WL_CONNECTED ? ip : IPAddress(); }
+  String macAddress() { return String("24:0A:C4:12:AB:CD"); }
+  bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+  bool softAP(const char *ssid, const char * = nullptr, int = 1, int = 0, int = 4) {
+    apSsid = ssid;
+    return true;
+  }
+  uint8_t softAPgetStationNum() { return apStations; }
+
+  int16_t scanNetworks(bool = false, bool = false, bool = false, uint32_t msPerChannel = 300, uint8_t channel = 0,
+                       const char * = nullptr, const uint8_t * = nullptr) {
+    scanning = true;
+    scanChannel = channel;
+    scanDueMs = millis() + msPerChannel;
+    found.clear();
+    scans++;
+    return WIFI_SCAN_RUNNING;
+  }
+  int16_t scanComplete() {
+    if (scanning && autoScan && (long)(millis() - scanDueMs) >= 0) {
+      for (const FakeNetwork &n : air) {
+        if (scanChannel == 0 || n.channel == scanChannel) found.push_back(n);
+      }
+      scanning = false;
+      hasResults = true;
+    }
+    if (scanning) return WIFI_SCAN_RUNNING;
+    return hasResults ? (int16_t)found.size() : WIFI_SCAN_FAILED;
+  }
+  void scanDelete() {
+    scanning = false;
+    hasResults = false;
+    found.clear();
+  }
+  String SSID(uint8_t i) { return i < found.size() ? String(found[i].ssid.c_str()) : String(); }
+  int32_t RSSI(uint8_t i) { return i < found.size() ? found[i].rssi : 0; }
+  int32_t channel(uint8_t i) { return i < found.size() ? found[i].channel : 0; }
+  wifi_auth_mode_t encryptionType(uint8_t i) { return i < found.size() ? found[i].auth : WIFI_AUTH_OPEN; }
+
+  void onEvent(WiFiEventFuncCb cb, WiFiEvent_t = ARDUINO_EVENT_WIFI_READY) { handler = cb; }
+
+  // Ends the running scan with these results (autoScan off)
+  void finishScan(const std::vector<FakeNetwork> &results) {
+    found = results;
+    scanning = false;
+    hasResults = true;
+  }
+
+  wl_status_t st = WL_IDLE_STATUS;
+  wifi_mode_t md = WIFI_OFF;
+  IPAddress ip = IPAddress(192, 168, 1, 57); // reported while connected
+  std::string joinSsid, joinPass, apSsid;
+  uint32_t begins = 0;
+  bool autoReconnect = true;
+  uint8_t apStations = 0;
+  WiFiEventFuncCb handler = nullptr;
+
+  std::vector<FakeNetwork> air; // what a scan finds, with autoScan
+  bool autoScan = true;
+  bool scanning = false;
+  bool hasResults = false;
+  uint8_t scanChannel = 0;
+  unsigned long scanDueMs = 0;
+  uint32_t scans = 0;
+  std::vector<FakeNetwork> found;
+};
+
+inline WiFiClass &fakeWiFi() {
+  static WiFiClass w;
+  return w;
+}
+#define WiFi fakeWiFi()
+
+// The driver reporting an event: runs the firmware's onEvent() handler
+inline void fakeWiFiEvent(WiFiEvent_t event, uint8_t reason = 0) {
+  WiFiEventInfo_t info;
+  memset(&info, 0, sizeof(info));
+  info.wifi_sta_disconnected.reason = reason;
+  if (fakeWiFi().handler) fakeWiFi().handler(event, info);
+}
+
+struct FakeSocket {
+  std::string toServer;   // written by the test, read by the firmware
+  std::string fromServer; // written by the firmware
+  bool open = true;
+};
+
+// Sockets waiting for WiFiServer::available(), oldest first
+inline std::deque<std::shared_ptr<FakeSocket>> &fakeBacklog() {
+  static std::deque<std::shared_ptr<FakeSocket>> q;
+  return q;
+}
+
+inline std::shared_ptr<FakeSocket> fakeConnect() {
+  std::shared_ptr<FakeSocket> s = std::make_shared<FakeSocket>();
+  fakeBacklog().push_back(s);
+  return s;
+}
+
+class WiFiClient : public Print {
+public:
+  int available() { return sock ? (int)sock->toServer.size() : 0; }
+  int read(uint8_t *buf, size_t n) {
+    if (!sock) return -1;
+    n = min(n, sock->toServer.size());
+    memcpy(buf, sock->toServer.data(), n);
+    sock->toServer.erase(0, n);
+    return (int)n;
+  }
+  size_t write(const uint8_t *buf, size_t n) {
+    if (!sock || !sock->open) return 0;
+    sock->fromServer.append((const char *)buf, n);
+    return n;
+  }
+  uint8_t connected() { return sock && sock->open; }
+  void stop() {
+    if (sock) sock->open = false;
+  }
+  void setNoDelay(bool) {}
+  explicit operator bool() const { return sock && sock->open; }
+
+  std::shared_ptr<FakeSocket> sock;
+};
+
+class WiFiServer {
+public:
+  WiFiServer(uint16_t = 80, uint8_t = 4) {}
+  void begin(uint16_t = 0) {}
+  void stop() {}
+  void setNoDelay(bool) {}
+  WiFiClient available() {
+    WiFiClient c;
+    if (!fakeBacklog().empty()) {
+      c.sock = fakeBacklog().front();
+      fakeBacklog().pop_front();
+    }
+    return c;
+  }
+};
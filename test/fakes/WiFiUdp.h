@@ -0,0 +1,78 @@
+/*
+Host stand-in for WiFiUdp.h: datagrams through two queues
+
+A test queues what clients send with fakeUdpSend() and reads what the
+firmware sent back from fakeUdpSent(). There is one port space: every
+WiFiUDP that has begin() receives from the same queue.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <deque>
+#include <string>
+
+struct FakeDatagram {
+  IPAddress peer;
+  uint16_t port;
+  std::string data;
+};
+
+inline std::deque<FakeDatagram> &fakeUdpSend() {
+  static std::deque<FakeDatagram> q;
+  return q;
+}
+
+inline std::deque<FakeDatagram> &fakeUdpSent() {
+  static std::deque<FakeDatagram> q;
+  return q;
+}
+
+class WiFiUDP {
+public:
+  uint8_t begin(uint16_t p) {
+    port = p;
+    return 1;
+  }
+  void stop() { port = 0; }
+
+  int parsePacket() {
+    cur.data.clear();
+    readPos = 0;
+    if (!port || fakeUdpSend().empty()) return 0;
+    cur = fakeUdpSend().front();
+    fakeUdpSend().pop_front();
+    return (int)cur.data.size();
+  }
+  int read(uint8_t *buf, size_t n) {
+    n = min(n, cur.data.size() - readPos);
+    memcpy(buf, cur.data.data() + readPos, n);
+    readPos += n;
+    return (int)n;
+  }
+  IPAddress remoteIP() { return cur.peer; }
+  uint16_t remotePort() { return cur.port; }
+
+  int beginPacket(IPAddress ip, uint16_t p) {
+    out.peer = ip;
+    out.port = p;
+    out.data.clear();
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t n) {
+    out.data.append((const char*)buf, n);
+    return n;
+  }
+  int endPacket() {
+    fakeUdpSent().push_back(out);
+    return 1;
+  }
+
+private:
+  uint16_t port = 0;
+  FakeDatagram cur;
+  size_t readPos = 0;
+  FakeDatagram out;
+};
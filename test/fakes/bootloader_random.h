@@ -0,0 +1,5 @@
+#pragma once
+
+// The host RNG needs no entropy source switched on
+inline void bootloader_random_enable() {}
+inline void bootloader_random_disable() {}
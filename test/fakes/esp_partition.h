@@ -0,0 +1,98 @@
+/*
+Host stand-in for esp_partition.h: the data partitions of partitions.csv in RAM
+
+Writes can only clear bits and erases set whole 4 KB sectors back to 0xFF,
+as on NOR flash, so the scene store's commit order is exercised for real.
+mmap hands out a pointer into the same bytes.
+*/
+
+#pragma once
+
+#include "esp_system.h"
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+typedef enum { SPI_FLASH_MMAP_DATA, SPI_FLASH_MMAP_INST } spi_flash_mmap_memory_t;
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  int subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+const uint32_t FAKE_FLASH_SECTOR = 4096;
+
+struct FakePartition {
+  esp_partition_t info;
+  std::vector<uint8_t> bytes;
+};
+
+inline std::vector<FakePartition> &fakePartitions() {
+  static std::vector<FakePartition> parts;
+  if (parts.empty()) {
+    FakePartition scenes;
+    scenes.info = {ESP_PARTITION_TYPE_DATA, 0x40, 0x3e0000, 0x10000, "scenes", false};
+    scenes.bytes.assign(scenes.info.size, 0xFF);
+    parts.push_back(scenes);
+  }
+  return parts;
+}
+
+inline FakePartition *fakePartition(const esp_partition_t *p) {
+  for (FakePartition &f : fakePartitions()) {
+    if (&f.info == p) return &f;
+  }
+  return nullptr;
+}
+
+inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                       const char *label) {
+  for (FakePartition &f : fakePartitions()) {
+    if (f.info.type != type) continue;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && f.info.subtype != (int)subtype) continue;
+    if (label && strcmp(label, f.info.label) != 0) continue;
+    return &f.info;
+  }
+  return nullptr;
+}
+
+inline esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t off, size_t n, spi_flash_mmap_memory_t,
+                                    const void **out, spi_flash_mmap_handle_t *handle) {
+  FakePartition *f = fakePartition(p);
+  if (!f || off + n > f->bytes.size()) return ESP_FAIL;
+  *out = f->bytes.data() + off;
+  *handle = 1;
+  return ESP_OK;
+}
+inline void spi_flash_munmap(spi_flash_mmap_handle_t) {}
+
+inline esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *buf, size_t n) {
+  FakePartition *f = fakePartition(p);
+  if (!f || off + n > f->bytes.size()) return ESP_FAIL;
+  memcpy(buf, f->bytes.data() + off, n);
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *buf, size_t n) {
+  FakePartition *f = fakePartition(p);
+  if (!f || off + n > f->bytes.size()) return ESP_FAIL;
+  const uint8_t *src = (const uint8_t *)buf;
+  for (size_t i = 0; i < n; ++i) f->bytes[off + i] &= src[i];
+  return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t n) {
+  FakePartition *f = fakePartition(p);
+  if (!f || off % FAKE_FLASH_SECTOR || n % FAKE_FLASH_SECTOR || off + n > f->bytes.size()) return ESP_FAIL;
+  memset(f->bytes.data() + off, 0xFF, n);
+  return ESP_OK;
+}
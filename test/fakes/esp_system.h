@@ -0,0 +1,52 @@
+/*
+Host stand-in for esp_system.h: reset reason and the RNG
+
+esp_random() is a fixed-seed xorshift, so a host run (and the boot id and
+config token it draws) is the same every time. fakeResetReason() sets what
+esp_reset_reason() reports.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t &fakeResetReason() {
+  static esp_reset_reason_t r = ESP_RST_POWERON;
+  return r;
+}
+inline esp_reset_reason_t esp_reset_reason() { return fakeResetReason(); }
+
+inline uint32_t &fakeRandomState() {
+  static uint32_t x = 0x2545F491;
+  return x;
+}
+inline uint32_t esp_random() {
+  uint32_t &x = fakeRandomState();
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+inline void esp_fill_random(void *buf, size_t len) {
+  uint8_t *p = (uint8_t *)buf;
+  for (size_t i = 0; i < len; ++i) p[i] = (uint8_t)esp_random();
+}
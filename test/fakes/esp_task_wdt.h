@@ -0,0 +1,10 @@
+#pragma once
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+
+// No task watchdog on the host; the supervisor task is never run anyway
+inline esp_err_t esp_task_wdt_init(uint32_t, bool) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(TaskHandle_t) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_delete(TaskHandle_t) { return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
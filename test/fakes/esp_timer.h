@@ -0,0 +1,6 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Microseconds on the virtual clock (see fakeNowMs())
+inline int64_t esp_timer_get_time() { return (int64_t)fakeNowMs() * 1000; }
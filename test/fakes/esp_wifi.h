@@ -0,0 +1,19 @@
+#pragma once
+
+#include "esp_system.h"
+
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+
+inline wifi_ps_type_t &fakePowerSave() {
+  static wifi_ps_type_t ps = WIFI_PS_MIN_MODEM; // the IDF default with Wi-Fi on
+  return ps;
+}
+inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t ps) {
+  fakePowerSave() = ps;
+  return ESP_OK;
+}
+inline esp_err_t esp_wifi_get_ps(wifi_ps_type_t *ps) {
+  *ps = fakePowerSave();
+  return ESP_OK;
+}
+inline esp_err_t esp_wifi_scan_stop() { return ESP_OK; }
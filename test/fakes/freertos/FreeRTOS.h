@@ -0,0 +1,79 @@
+/*
+Host stand-in for FreeRTOS: tasks, notifications, critical sections
+
+The host has one thread, loop()'s. xTaskCreate*() records the task in
+fakeTasks() but never runs it: the firmware's tasks block forever
+(ulTaskNotifyTake, vTaskDelay), which one thread cannot interleave
+deterministically. A test that needs a task's work calls what it calls.
+Notifications given to a task are counted, critical sections are no-ops.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7fffffff
+
+struct tskTaskControlBlock {
+  void (*fn)(void *);
+  const char *name;
+  void *arg;
+  uint32_t notified; // vTaskNotifyGiveFromISR() calls
+};
+typedef struct tskTaskControlBlock *TaskHandle_t;
+
+inline std::vector<TaskHandle_t> &fakeTasks() {
+  static std::vector<TaskHandle_t> tasks;
+  return tasks;
+}
+
+// The task every host call runs on
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static tskTaskControlBlock loopTask = {nullptr, "loopTask", nullptr, 0};
+  return &loopTask;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t, void *arg, UBaseType_t,
+                                          TaskHandle_t *handle, BaseType_t) {
+  TaskHandle_t t = new tskTaskControlBlock{fn, name, arg, 0};
+  fakeTasks().push_back(t);
+  if (handle) *handle = t;
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                              TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t) {}
+inline BaseType_t xPortGetCoreID() { return 1; }
+
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+inline void vTaskNotifyGiveFromISR(TaskHandle_t t, BaseType_t *woken) {
+  if (t) t->notified++;
+  if (woken) *woken = pdFALSE;
+}
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+typedef struct {
+  int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define portENTER_CRITICAL_ISR(mux) (void)(mux)
+#define portEXIT_CRITICAL_ISR(mux) (void)(mux)
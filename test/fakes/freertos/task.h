@@ -0,0 +1,8 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#include <Arduino.h>
+
+// Moves the virtual clock, as if the calling task had slept
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
@@ -0,0 +1,84 @@
+/*
+Fuzz target: credentialError() and appendJsonEscaped()
+
+Input: byte 0 picks what the last scan saw for the SSID (0 = not seen,
+else an auth mode), the rest is "ssid NUL pass". Checks that anything
+credentialError() accepts really is within the 802.11 limits for that
+auth mode, and that appendJsonEscaped() output has no raw control bytes
+and unescapes back to its input.
+*/
+
+#include "portal_input.h"
+
+#include <stdlib.h>
+
+static String bytes(const uint8_t *p, size_t n) {
+  String s;
+  s.concat((const char*)p, n);
+  return s;
+}
+
+static void checkEscaped(const String &in) {
+  String out;
+  appendJsonEscaped(out, in);
+  std::string back;
+  for (unsigned int i = 0; i < out.length(); ++i) {
+    char c = out[i];
+    if ((uint8_t)c < 0x20 || c == '"') abort(); // would end or break the JSON string
+    if (c != '\\') {
+      back += c;
+      continue;
+    }
+    if (++i >= out.length()) abort();
+    c = out[i];
+    if (c == '"' || c == '\\') {
+      back += c;
+    } else if (c == 'u' && i + 4 < out.length()) {
+      back += (char)strtol(out.substring(i + 1, i + 5).c_str(), nullptr, 16);
+      i += 4;
+    } else {
+      abort();
+    }
+  }
+  if (back.size() != in.length() || memcmp(back.data(), in.c_str(), back.size()) != 0) abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < 1) return 0;
+  ScanEntry entry = {};
+  ScanEntry *seen = nullptr;
+  if (data[0]) {
+    entry.auth = (wifi_auth_mode_t)((data[0] - 1) % WIFI_AUTH_MAX);
+    seen = &entry;
+  }
+  const uint8_t *p = data + 1;
+  size_t n = size - 1;
+  const uint8_t *nul = (const uint8_t*)memchr(p, 0, n);
+  size_t ssidLen = nul ? (size_t)(nul - p) : n;
+  String ssid = bytes(p, ssidLen);
+  String pass = nul ? bytes(nul + 1, n - ssidLen - 1) : String();
+
+  const char *err = credentialError(ssid, pass, seen);
+  if (err) {
+    if (!*err) abort();
+  } else {
+    unsigned int len = pass.length();
+    if (ssid.length() < 1 || ssid.length() > SSID_MAX_LEN) abort();
+    if (seen && seen->auth == WIFI_AUTH_WPA2_ENTERPRISE) abort();
+    if (seen && seen->auth == WIFI_AUTH_OPEN) {
+      if (len != 0) abort();
+    } else if (seen && seen->auth == WIFI_AUTH_WEP) {
+      if (len != 5 && len != 13 && len != 10 && len != 26) abort();
+    } else {
+      if (len < PASS_MIN_LEN || len > PASS_MAX_LEN) abort();
+      for (unsigned int i = 0; i < len; ++i) {
+        char c = pass[i];
+        if (len == PASS_MAX_LEN ? !isxdigit((unsigned char)c) : (c < 0x20 || c > 0x7e)) abort();
+      }
+    }
+  }
+
+  checkEscaped(ssid);
+  checkEscaped(pass);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/*
+Fuzz target: captiveDnsReply(), the captive portal's DNS parsing
+
+Input: one UDP datagram as a client on the softAP would send it to port
+53. Checks: a reply is a well-formed header with the query's id, at most
+one question (the query's, byte for byte) and at most one A record with
+the portal's address; nothing is answered for a datagram shorter than a
+header or with QR set; building the reply in the query's own buffer gives
+the same bytes; and a reply buffer one byte too small gets no reply
+rather than a write past it. ASan/UBSan catch reads past the datagram.
+*/
+
+#include "captive_dns.h"
+
+#include <stdlib.h>
+
+#include <vector>
+
+static const uint8_t PORTAL_IP[4] = {192, 168, 4, 1};
+
+static uint16_t be16(const uint8_t *p) {
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  uint8_t reply[DNS_MAX_DATAGRAM];
+  size_t n = captiveDnsReply(data, size, PORTAL_IP, reply, sizeof(reply));
+  if (size < DNS_HEADER_LEN || (data[2] & 0x80)) {
+    if (n != 0) abort();
+    return 0;
+  }
+  if (n == 0) abort(); // a query always gets an answer or an error code
+  if (n < DNS_HEADER_LEN || n > sizeof(reply)) abort();
+  if (reply[0] != data[0] || reply[1] != data[1] || !(reply[2] & 0x80)) abort();
+  if ((reply[2] & 0x78) != (data[2] & 0x78)) abort(); // opcode echoed
+  uint16_t qd = be16(reply + 4), an = be16(reply + 6);
+  if (qd > 1 || an > qd || be16(reply + 8) != 0 || be16(reply + 10) != 0) abort();
+  uint8_t rcode = reply[3] & 0x0f;
+  if (rcode != 0) {
+    if (n != DNS_HEADER_LEN || qd != 0) abort();
+  } else {
+    if (qd != 1 || be16(data + 4) != 1) abort();
+    size_t questionEnd = n - (an ? 16 : 0);
+    if (questionEnd <= DNS_HEADER_LEN + 4 || questionEnd > size) abort();
+    if (memcmp(reply + DNS_HEADER_LEN, data + DNS_HEADER_LEN, questionEnd - DNS_HEADER_LEN) != 0) abort();
+    if (an) {
+      const uint8_t *a = reply + questionEnd;
+      if (be16(a) != 0xC00C || be16(a + 2) != 1 || be16(a + 4) != 1 || be16(a + 10) != 4) abort();
+      if (memcmp(a + 12, PORTAL_IP, 4) != 0) abort();
+    }
+  }
+
+  // in place, as CaptiveDns calls it
+  if (size <= DNS_MAX_DATAGRAM) {
+    uint8_t buf[DNS_MAX_DATAGRAM];
+    memcpy(buf, data, size);
+    if (captiveDnsReply(buf, size, PORTAL_IP, buf, sizeof(buf)) != n || memcmp(buf, reply, n) != 0) abort();
+  }
+
+  // exactly one byte short, on the heap so ASan sees a write past it
+  std::vector<uint8_t> tight(n - 1);
+  if (captiveDnsReply(data, size, PORTAL_IP, tight.data(), tight.size()) != 0) abort();
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+Fuzz target: /save form and query decoding
+
+Input: "query LF body". Both go into one POST /save through PortalServer
+(the query with bytes that would end the request line replaced by '+'),
+so arg()/hasArg() decode them exactly as on the device. The handler reads
+ssid and pass the way handleSave() does and validates them. Checks that a
+decoded value is never longer than its raw bytes, that a missing argument
+reads as empty, and that exactly one response goes out.
+*/
+
+#include "portal_input.h"
+#include "portal_server.h"
+
+#include <stdlib.h>
+
+static PortalServer server(80);
+static size_t rawLen;
+static int handled;
+
+static void handleSave() {
+  handled++;
+  String ssid = server.arg("ssid");
+  String pass = server.arg("pass");
+  if (ssid.length() > rawLen || pass.length() > rawLen) abort();
+  if (!server.hasArg("ssid") && ssid.length()) abort();
+  if (!server.hasArg("pass") && pass.length()) abort();
+  if (server.arg("").length() > rawLen) abort();
+
+  ScanEntry seen = {};
+  seen.auth = WIFI_AUTH_WPA2_PSK;
+  const char *err = credentialError(ssid, pass, ssid.length() & 1 ? &seen : nullptr);
+  String json = "{\"ssid\":\"";
+  appendJsonEscaped(json, ssid);
+  json += "\"}";
+  server.send(err ? 400 : 200, "application/json", json);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static bool started = false;
+  if (!started) {
+    server.on("/save", HTTP_POST, handleSave);
+    server.begin();
+    started = true;
+  }
+
+  const uint8_t *lf = (const uint8_t*)memchr(data, '\n', size);
+  size_t queryLen = lf ? (size_t)(lf - data) : 0;
+  const uint8_t *body = lf ? lf + 1 : data;
+  size_t bodyLen = size - (body - data);
+
+  std::string req = "POST /save";
+  if (queryLen) {
+    req += '?';
+    for (size_t i = 0; i < queryLen; ++i) {
+      char c = (char)data[i];
+      req += (c == ' ' || c == '\r') ? '+' : c;
+    }
+  }
+  req += " HTTP/1.1\r\nContent-Length: ";
+  if (req.size() + 32 > PORTAL_MAX_REQUEST_LEN) return 0; // too long for a request line
+  size_t room = PORTAL_MAX_REQUEST_LEN - req.size() - 32;
+  if (bodyLen > room) bodyLen = room;
+  req += std::to_string(bodyLen);
+  req += "\r\n\r\n";
+  req.append((const char*)body, bodyLen);
+  rawLen = queryLen + bodyLen;
+
+  std::shared_ptr<FakeSocket> sock = fakeConnect();
+  sock->toServer = req;
+  handled = 0;
+  server.handleClient();
+  if (handled != 1) abort();
+  // one response, its Content-Length covering exactly the rest
+  const std::string &out = sock->fromServer;
+  size_t headEnd = out.find("\r\n\r\n");
+  size_t cl = out.find("\r\nContent-Length: ");
+  if (out.compare(0, 9, "HTTP/1.1 ") != 0 || headEnd == std::string::npos || cl > headEnd) abort();
+  if (strtoul(out.c_str() + cl + 18, nullptr, 10) != out.size() - headEnd - 4) abort();
+  sock->open = false;
+  server.handleClient(); // frees the connection slot
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+Fuzz target: PortalServer request parsing (parseAndDispatch)
+
+Input: byte 0 is the read split, the rest is what one client sends. With a
+split of 0 the bytes arrive in one read; otherwise they arrive in chunks of
+1..split bytes, with handleClient() between chunks, as a slow link or a
+client writing headers and body separately would deliver them. Every
+handler answers with an empty body, so the output must be a sequence of
+complete header blocks. Checks: each is a known status with Content-Length
+0, nothing follows a "Connection: close" reply, and every dispatched
+request got exactly one reply. ASan/UBSan catch reads past the request.
+*/
+
+#include "portal_server.h"
+
+#include <stdlib.h>
+
+static PortalServer server(80);
+static uint32_t dispatched;
+
+static void answer() {
+  dispatched++;
+  // exercise the accessors on whatever was parsed
+  String len = String(server.arg("ssid").length() + server.uri().length());
+  len += server.hasArg("pass") ? "+" : "-";
+  server.sendHeader("X-Len", len + server.header("Content-Type").length());
+  server.send(200, "text/plain", "");
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static bool started = false;
+  if (!started) {
+    server.on("/save", HTTP_POST, answer);
+    server.on("/status", HTTP_GET, answer);
+    server.onNotFound(answer);
+    server.begin();
+    started = true;
+  }
+  if (size < 1) return 0;
+
+  uint8_t split = data[0];
+  uint32_t rng = split * 2654435761u + 1;
+  std::shared_ptr<FakeSocket> sock = fakeConnect();
+  dispatched = 0;
+  size_t pos = 1;
+  while (pos < size) {
+    size_t n = size - pos;
+    if (split) {
+      rng = rng * 1103515245u + 12345u;
+      n = min(n, (size_t)(1 + (rng >> 16) % split));
+    }
+    sock->toServer.append((const char*)data + pos, n);
+    pos += n;
+    server.handleClient();
+    fakeNowMs() += 10;
+  }
+  server.handleClient();
+
+  const std::string &out = sock->fromServer;
+  size_t at = 0;
+  uint32_t replies = 0;
+  bool closed = false;
+  while (at < out.size()) {
+    if (closed) abort(); // a reply after "Connection: close"
+    size_t end = out.find("\r\n\r\n", at);
+    if (end == std::string::npos || out.compare(at, 9, "HTTP/1.1 ") != 0) abort();
+    std::string head = out.substr(at, end + 2 - at);
+    int code = atoi(head.c_str() + 9);
+    if (code != 200 && code != 400 && code != 413 && code != 501) abort();
+    if (head.find("\r\nContent-Length: 0\r\n") == std::string::npos) abort();
+    if (code == 200) replies++;
+    closed = head.find("\r\nConnection: close\r\n") != std::string::npos;
+    at = end + 4;
+  }
+  if (replies != dispatched) abort();
+  if (closed && sock->open) abort();
+
+  sock->open = false;
+  server.handleClient(); // frees the connection slot
+  return 0;
+}
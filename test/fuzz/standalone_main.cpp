@@ -0,0 +1,63 @@
+/*
+Runs a fuzz target without libFuzzer
+
+Every file named on the command line, and every file in a named directory,
+goes through LLVMFuzzerTestOneInput() once. Used for compilers without
+-fsanitize=fuzzer (g++) and by "make check" to replay the seed corpora.
+*/
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static bool runFile(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f) {
+    perror(path.c_str());
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  // a heap copy of exactly size bytes, so ASan sees reads past the end
+  uint8_t *input = new uint8_t[data.size() ? data.size() : 1];
+  if (!data.empty()) memcpy(input, data.data(), data.size());
+  LLVMFuzzerTestOneInput(input, data.size());
+  delete[] input;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  size_t runs = 0;
+  for (int i = 1; i < argc; ++i) {
+    struct stat st;
+    if (stat(argv[i], &st) != 0) {
+      perror(argv[i]);
+      return 1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+      if (!runFile(argv[i])) return 1;
+      runs++;
+      continue;
+    }
+    DIR *d = opendir(argv[i]);
+    if (!d) return 1;
+    while (struct dirent *e = readdir(d)) {
+      if (e->d_name[0] == '.') continue;
+      if (!runFile(std::string(argv[i]) + "/" + e->d_name)) return 1;
+      runs++;
+    }
+    closedir(d);
+  }
+  printf("%s: %zu inputs ok\n", argv[0], runs);
+  return 0;
+}
@@ -0,0 +1,510 @@
+/*
+Host replay of an input trace (include/trace.h) into the real firmware
+
+  ./trace_host replay trace.bin [-t ms]   feed a trace back in and check it
+  ./trace_host record trace.bin           write a trace of a scripted boot
+  make check                              record, then replay that trace in
+                                          a fresh process
+
+replay links every file of src/ (built with TRACE_RECORD) against
+test/fakes and boots it the way the traced boot began: the clock starts at
+the trace's start time, the reset reason is set, NVS gets the failed-boot
+count, a provisioned flag with placeholder credentials (unless the plan was
+PORTAL) and the config overrides from the CONFIG records. Then loop() runs
+on the virtual clock and each record goes in at its millis():
+
+  EVENT STA_GOT_IP, STA_DISCONNECTED   WiFi status set, then the firmware's
+                                       onEvent() handler runs, with the
+                                       recorded reason
+  EVENT AP_CLIENT_JOINED               the same, as a softAP join
+  EVENT BUTTON                         the pin takes the recorded level, so
+                                       its interrupt handler runs
+  HTTP                                 sent on a new connection with the
+                                       config token; a redacted pass= value
+                                       becomes as many "0"s
+  SCAN, SCAN_DONE                      the running channel scan ends with
+                                       those networks (a scan does not end
+                                       on its own here)
+  EVENT RUN_STATE                      not an input: what to check against
+
+The check: the replayed boot goes through the same RunState changes as the
+recorded one, in the same order, each within -t ms (default 100) of its
+recorded time; and the accepted transitions left in runFsm's trace ring are
+the last recorded changes. The replay's own trace supplies its RUN_STATE
+records. Exit status 0 when both hold, 1 when not, 2 for a bad trace.
+
+What a trace cannot reproduce:
+  - the lamp task (src/local_control.cpp): the fake FreeRTOS never runs
+    tasks, so PUSH_02 clicks and holds change no lamp state here; RunState
+    does not depend on them
+  - request headers: only the token is sent, so a /status poll that got 304
+    on the device gets 200 here; payloads cut at TRACE_MAX_PAYLOAD are sent
+    cut
+  - DNS queries, which are not recorded
+  - a trace that was cleared (GET /trace?clear=1) lacks the start of its
+    boot and diverges; one with dropped records is checked up to its last
+    record only
+  - the password and SSID: placeholders, the fake access point accepts
+    anything and the recorded events decide the outcome
+
+record plays a scripted world instead: a provisioned bulb whose network is
+gone, a phone that joins the portal, scans, gets the password wrong once,
+then right, and two button presses. It fails if the boot does not end up
+CONNECTED, and writes the firmware's trace to the file.
+*/
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WebServer.h>
+#include <WiFi.h>
+#include <esp_system.h>
+
+#include "config.h"
+#include "event_bus.h"
+#include "run_table.h"
+#include "trace.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// From src/main.cpp
+extern StateMachine<RunState, RunEvent, RunTable> runFsm;
+void setup();
+void loop();
+const char* runStateName(RunState s);
+const char* runEventName(RunEvent e);
+
+const uint8_t PUSH_01 = 19; // as in src/main.cpp
+const uint8_t PUSH_02 = 18;
+const char *const BOOT_PLANS[] = {"PORTAL", "STATION_FULL", "STATION_SHORT", "CONCURRENT"};
+const unsigned long LOOP_MS = 20; // the delay() at the end of loop()
+
+struct Record {
+  uint32_t ms;
+  TraceKind kind;
+  uint16_t arg;
+  std::string payload;
+};
+
+struct Trace {
+  uint32_t dropped;
+  uint32_t resetReason;
+  uint32_t bootPlan;
+  uint32_t bootFails;
+  uint32_t startMs;
+  std::vector<Record> records;
+};
+
+struct StateAt {
+  uint32_t ms;
+  RunState state;
+};
+
+static uint32_t u32At(const std::string &b, size_t at) {
+  uint32_t v;
+  memcpy(&v, b.data() + at, sizeof(v)); // little endian, as on the ESP32
+  return v;
+}
+
+// Format 2 only: format 1 has no SCAN_DONE, so its scans cannot be ended
+static bool parse(const std::string &b, Trace *t) {
+  if (b.size() < 32 || b.compare(0, 4, "TRC1") != 0) {
+    fprintf(stderr, "not a trace\n");
+    return false;
+  }
+  uint16_t format, headerSize;
+  memcpy(&format, b.data() + 4, 2);
+  memcpy(&headerSize, b.data() + 6, 2);
+  if (format != 2) {
+    fprintf(stderr, "trace format %u: replay needs format 2\n", format);
+    return false;
+  }
+  size_t end = min((size_t)u32At(b, 8), b.size());
+  t->dropped = u32At(b, 12);
+  t->resetReason = u32At(b, 16);
+  t->bootPlan = u32At(b, 20);
+  t->bootFails = u32At(b, 24);
+  t->startMs = u32At(b, 28);
+  t->records.clear();
+  for (size_t pos = headerSize; pos + 8 <= end;) {
+    Record r;
+    r.ms = u32At(b, pos);
+    r.kind = (TraceKind)(uint8_t)b[pos + 4];
+    uint8_t len = (uint8_t)b[pos + 5];
+    r.arg = (uint16_t)((uint8_t)b[pos + 6] | (uint8_t)b[pos + 7] << 8);
+    r.payload = b.substr(pos + 8, len);
+    pos += 8 + len;
+    t->records.push_back(r);
+  }
+  return true;
+}
+
+static std::vector<StateAt> runStates(const Trace &t) {
+  std::vector<StateAt> v;
+  for (const Record &r : t.records) {
+    if (r.kind == TraceKind::EVENT && (EventType)(r.arg & 0xff) == EventType::RUN_STATE) {
+      StateAt s = {r.ms, (RunState)(r.arg >> 8)};
+      v.push_back(s);
+    }
+  }
+  return v;
+}
+
+// -- what the fakes owe the firmware between loop() passes --
+
+struct Exchange {
+  std::shared_ptr<FakeSocket> sock;
+  std::string what;
+};
+
+struct ScanEnd {
+  uint32_t ms;
+  uint8_t channel;
+  std::vector<FakeNetwork> nets;
+};
+
+static std::vector<Exchange> exchanges;
+static std::deque<ScanEnd> scanEnds;
+static std::vector<FakeNetwork> scanFound;
+static bool diverged;
+static void (*world)(); // record: the scripted access point
+
+static void feedScans() {
+  if (scanEnds.empty() || !fakeWiFi().scanning || fakeNowMs() < scanEnds.front().ms) return;
+  const ScanEnd &e = scanEnds.front();
+  if (fakeWiFi().scanChannel != e.channel) {
+    printf("%10lu ms  scan: trace ends channel %u, firmware scans channel %u\n", fakeNowMs(), e.channel,
+           fakeWiFi().scanChannel);
+    diverged = true;
+  }
+  fakeWiFi().finishScan(e.nets);
+  scanEnds.pop_front();
+}
+
+static void collectReplies() {
+  for (size_t i = 0; i < exchanges.size();) {
+    FakeSocket &s = *exchanges[i].sock;
+    if (s.fromServer.find("\r\n\r\n") == std::string::npos) {
+      ++i;
+      continue;
+    }
+    printf("%10lu ms  %d  %s\n", fakeNowMs(), atoi(s.fromServer.c_str() + 9), exchanges[i].what.c_str());
+    s.open = false;
+    exchanges.erase(exchanges.begin() + i);
+  }
+}
+
+// One loop() pass
+static void step() {
+  feedScans();
+  loop();
+  if (world) world();
+  collectReplies();
+}
+
+static void runUntil(unsigned long ms) {
+  while (fakeNowMs() + LOOP_MS <= ms) step();
+  if (fakeNowMs() < ms) fakeNowMs() = ms;
+}
+
+static const char *methodName(uint16_t m) {
+  switch (m) {
+    case HTTP_DELETE: return "DELETE";
+    case HTTP_GET: return "GET";
+    case HTTP_HEAD: return "HEAD";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_OPTIONS: return "OPTIONS";
+  }
+  return "GET";
+}
+
+// "path[?query][ body]" as traceHttp() wrote it, as a request from a phone
+static std::shared_ptr<FakeSocket> send(uint16_t method, const std::string &text) {
+  std::string target = text, body;
+  size_t sp = text.find(' ');
+  if (sp != std::string::npos) {
+    target = text.substr(0, sp);
+    body = text.substr(sp + 1);
+  }
+  std::string req = std::string(methodName(method)) + " " + target + " HTTP/1.1\r\nHost: 192.168.4.1\r\n" +
+                    "Authorization: Bearer " + configToken().c_str() + "\r\n";
+  if (!body.empty()) {
+    req += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\n";
+  }
+  req += "\r\n" + body;
+  Exchange x;
+  x.sock = fakeConnect();
+  x.sock->toServer = req;
+  x.what = std::string(methodName(method)) + " " + target;
+  exchanges.push_back(x);
+  return x.sock;
+}
+
+// -- replay --
+
+static void unredact(std::string &text) {
+  for (size_t at = text.find("pass="); at != std::string::npos; at = text.find("pass=", at + 5)) {
+    for (size_t i = at + 5; i < text.size() && text[i] == '*'; ++i) text[i] = '0';
+  }
+}
+
+static void inject(const Record &r) {
+  if (r.kind == TraceKind::EVENT) {
+    EventType type = (EventType)(r.arg & 0xff);
+    uint8_t code = r.arg >> 8;
+    uint8_t level = r.payload.empty() ? 0 : (uint8_t)r.payload[0];
+    if (type == EventType::STA_GOT_IP) {
+      fakeWiFi().st = WL_CONNECTED;
+      fakeWiFiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    } else if (type == EventType::STA_DISCONNECTED) {
+      fakeWiFi().st = WL_DISCONNECTED;
+      fakeWiFiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, code);
+    } else if (type == EventType::AP_CLIENT_JOINED) {
+      fakeWiFi().apStations++;
+      fakeWiFiEvent(ARDUINO_EVENT_WIFI_AP_STACONNECTED);
+    } else if (type == EventType::BUTTON) {
+      fakeSetPin(code, level);
+    }
+  } else if (r.kind == TraceKind::HTTP) {
+    std::string text = r.payload;
+    unredact(text);
+    send(r.arg, text);
+  } else if (r.kind == TraceKind::SCAN && !r.payload.empty()) {
+    FakeNetwork n = {r.payload.substr(1), (int8_t)(r.arg >> 8), (uint8_t)r.arg, (wifi_auth_mode_t)r.payload[0]};
+    scanFound.push_back(n);
+  } else if (r.kind == TraceKind::SCAN_DONE) {
+    ScanEnd e = {r.ms, (uint8_t)r.arg, scanFound};
+    scanEnds.push_back(e);
+    scanFound.clear();
+  }
+}
+
+static bool readFile(const char *path, std::string *out) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out->append(buf, n);
+  fclose(f);
+  return true;
+}
+
+static int replay(const char *path, unsigned long tolerance) {
+  std::string data;
+  Trace t;
+  if (!readFile(path, &data) || !parse(data, &t)) return 2;
+
+  Preferences p;
+  if (t.bootPlan != 0) { // not PORTAL: there were credentials
+    p.begin("wifi", false);
+    p.putUChar("prov", 1);
+    p.putString("ssid", "replay");
+    p.putString("pass", "replay-password");
+    p.putUChar("bootfail", (uint8_t)t.bootFails);
+    p.end();
+  }
+  p.begin("cfg", false);
+  for (const Record &r : t.records) {
+    if (r.kind == TraceKind::CONFIG && r.arg < CFG_COUNT && r.payload.size() == 4) {
+      p.putULong(CFG_SPECS[r.arg].key, u32At(r.payload, 0));
+    }
+  }
+  p.end();
+  fakeResetReason() = (esp_reset_reason_t)t.resetReason;
+  fakeWiFi().autoScan = false;
+  fakeNowMs() = t.startMs;
+  setup();
+
+  Trace own;
+  if (!parse(std::string((const char*)traceData(), traceSize()), &own)) return 2;
+  printf("boot: plan %s after %lu failed boots at %lu ms, %lu records, %lu dropped\n",
+         t.bootPlan < 4 ? BOOT_PLANS[t.bootPlan] : "?", (unsigned long)t.bootFails, (unsigned long)t.startMs, (unsigned long)t.records.size(),
+         (unsigned long)t.dropped);
+  if (own.bootPlan != t.bootPlan) {
+    printf("boot plan %lu, trace has %lu\n", (unsigned long)own.bootPlan, (unsigned long)t.bootPlan);
+    return 1;
+  }
+
+  std::vector<StateAt> expected = runStates(t);
+  uint32_t lastMs = t.startMs;
+  for (const Record &r : t.records) {
+    runUntil(r.ms);
+    inject(r);
+    lastMs = r.ms;
+  }
+  runUntil(lastMs + tolerance);
+  if (t.dropped) printf("%lu records dropped at the end of the trace: checked up to %lu ms\n",
+                        (unsigned long)t.dropped, (unsigned long)lastMs);
+
+  parse(std::string((const char*)traceData(), traceSize()), &own);
+  std::vector<StateAt> got = runStates(own);
+  bool ok = !diverged && got.size() == expected.size();
+  for (size_t i = 0; i < max(got.size(), expected.size()); ++i) {
+    if (i >= expected.size()) {
+      printf("run state  %-10s at %lu ms, not in the trace\n", runStateName(got[i].state), (unsigned long)got[i].ms);
+      continue;
+    }
+    if (i >= got.size()) {
+      printf("run state  %-10s at %lu ms, not replayed\n", runStateName(expected[i].state),
+             (unsigned long)expected[i].ms);
+      continue;
+    }
+    long skew = (long)(got[i].ms - expected[i].ms);
+    bool same = got[i].state == expected[i].state && labs(skew) <= (long)tolerance;
+    if (!same) ok = false;
+    printf("run state  %-10s at %lu ms, recorded %s at %lu ms  %s\n", runStateName(got[i].state),
+           (unsigned long)got[i].ms, runStateName(expected[i].state), (unsigned long)expected[i].ms,
+           same ? "ok" : "MISMATCH");
+  }
+
+  // the ring keeps the last FSM_TRACE_LEN fires; its accepted ones are the
+  // tail of the recorded changes
+  std::vector<RunState> accepted;
+  for (uint8_t i = 0; i < runFsm.count(); ++i) {
+    const FsmTrace<RunState, RunEvent> &f = runFsm.trace(i);
+    printf("fsm  %10lu ms  %s --%s--> %s\n", (unsigned long)f.atMs, runStateName(f.from), runEventName(f.on),
+           f.accepted ? runStateName(f.to) : "rejected");
+    if (f.accepted && f.to != f.from) accepted.push_back(f.to);
+  }
+  if (accepted.size() > expected.size()) ok = false;
+  for (size_t i = 0; ok && i < accepted.size(); ++i) {
+    if (accepted[i] != expected[expected.size() - accepted.size() + i].state) ok = false;
+  }
+
+  printf("replay: %s\n", ok ? "same run states as recorded" : "differs from the trace");
+  return ok ? 0 : 1;
+}
+
+// -- record --
+
+enum class Ap { GONE, WRONG_PASSWORD, JOINS };
+static Ap ap;
+static uint32_t seenBegins;
+static bool answerPending;
+static unsigned long answerAt;
+
+// The access point answers each connect attempt a while after WiFi.begin()
+static void scriptedAp() {
+  if (fakeWiFi().begins != seenBegins) {
+    seenBegins = fakeWiFi().begins;
+    answerPending = true;
+    answerAt = millis() + (ap == Ap::GONE ? 3000 : ap == Ap::WRONG_PASSWORD ? 600 : 900);
+  }
+  if (!answerPending || (long)(millis() - answerAt) < 0) return;
+  answerPending = false;
+  if (ap == Ap::JOINS) {
+    fakeWiFi().st = WL_CONNECTED;
+    fakeWiFiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    return;
+  }
+  fakeWiFi().st = WL_DISCONNECTED;
+  fakeWiFiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+                ap == Ap::GONE ? WIFI_REASON_NO_AP_FOUND : WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT);
+}
+
+static void runFor(unsigned long ms) {
+  runUntil(fakeNowMs() + ms);
+}
+
+static void fail(const char *what) {
+  fprintf(stderr, "record: %s\n", what);
+  exit(1);
+}
+
+// A phone's request, run until it is answered; the reply as sent
+static std::string exchange(HTTPMethod method, const char *text) {
+  std::shared_ptr<FakeSocket> s = send(method, text);
+  for (int i = 0; i < 5000; ++i) {
+    if (!s->fromServer.empty() && !s->open) return s->fromServer;
+    step();
+  }
+  fail(text);
+  return "";
+}
+
+static int record(const char *path) {
+  Preferences p;
+  p.begin("wifi", false);
+  p.putUChar("prov", 1);
+  p.putString("ssid", "HomeNet");
+  p.putString("pass", "old-password");
+  p.end();
+  p.begin("cfg", false);
+  p.putULong("max_retries", 2);
+  p.putULong("ap_shutdown_ms", 5000);
+  p.end();
+  static const FakeNetwork nets[] = {
+      {"Office-2G", -48, 6, WIFI_AUTH_WPA2_PSK},
+      {"Caf\xc3\xa9 \"Guest\"", -72, 1, WIFI_AUTH_OPEN},
+      {"Neighbour 5", -88, 13, WIFI_AUTH_WPA2_PSK},
+  };
+  fakeWiFi().air.assign(nets, nets + sizeof(nets) / sizeof(nets[0]));
+  ap = Ap::GONE;
+  world = scriptedAp;
+  fakeNowMs() = 347; // bootloader and core start-up
+
+  setup();
+  for (int i = 0; i < 5000 && fakeWiFi().apSsid.empty(); ++i) step();
+  if (fakeWiFi().apSsid.empty()) fail("portal did not come up");
+
+  // a phone joins the portal, loads the page and scans
+  runFor(800);
+  fakeWiFi().apStations = 1;
+  fakeWiFiEvent(ARDUINO_EVENT_WIFI_AP_STACONNECTED);
+  runFor(1500);
+  exchange(HTTP_GET, "/");
+  exchange(HTTP_GET, "/scan?start=1");
+  for (int i = 0; exchange(HTTP_GET, "/scan").find("\"done\":true") == std::string::npos; ++i) {
+    if (i == 20) fail("scan did not finish");
+    runFor(500);
+  }
+  exchange(HTTP_GET, "/status");
+  exchange(HTTP_POST, "/config key=blink_on_ms&value=300");
+
+  // a short press on the factory button, a click on the lamp button
+  fakeSetPin(PUSH_01, LOW);
+  runFor(1200);
+  fakeSetPin(PUSH_01, HIGH);
+  runFor(400);
+  fakeSetPin(PUSH_02, LOW);
+  runFor(150);
+  fakeSetPin(PUSH_02, HIGH);
+  runFor(1000);
+
+  ap = Ap::WRONG_PASSWORD;
+  exchange(HTTP_POST, "/save ssid=Office-2G&pass=not-the-password");
+  runFor(3000);
+  ap = Ap::JOINS;
+  exchange(HTTP_POST, "/save ssid=Office-2G&pass=correct%20horse");
+  runFor(6000); // past ap_shutdown_ms: the portal closes, the local API opens
+  exchange(HTTP_GET, "/light");
+  runFor(500);
+  if (runFsm.state() != RunState::CONNECTED) fail("the boot did not end CONNECTED");
+
+  FILE *f = fopen(path, "wb");
+  if (!f || fwrite(traceData(), 1, traceSize(), f) != traceSize()) {
+    perror(path);
+    return 1;
+  }
+  fclose(f);
+  printf("%s: %lu bytes\n", path, (unsigned long)traceSize());
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 3 && strcmp(argv[1], "record") == 0) return record(argv[2]);
+  if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+    unsigned long tolerance = 100;
+    if (argc >= 5 && strcmp(argv[3], "-t") == 0) tolerance = strtoul(argv[4], nullptr, 10);
+    return replay(argv[2], tolerance);
+  }
+  fprintf(stderr, "usage: %s record|replay trace.bin [-t ms]\n", argv[0]);
+  return 2;
+}
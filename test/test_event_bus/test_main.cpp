@@ -0,0 +1,194 @@
+// MpscRing under several producer threads, and the eventPost()/eventDrain()
+// path on top of it
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <WiFi.h>
+
+#include "../../src/event_bus.cpp"
+
+struct Stamp {
+  uint32_t producer;
+  uint32_t seq;
+};
+
+const int PRODUCERS = 4;
+const uint32_t PER_PRODUCER = 200000;
+
+void setUp() {}
+void tearDown() {}
+
+// Producers retry while the ring is full, so every item must come out,
+// and in each producer's own order
+static void test_stress_no_loss_no_reorder() {
+  static MpscRing<Stamp, 64> ring;
+  std::atomic<int> ready(0);
+  std::atomic<uint32_t> full(0);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; ++p) {
+    producers.push_back(std::thread([p, &ready, &full] {
+      ready++;
+      while (ready < PRODUCERS) std::this_thread::yield();
+      for (uint32_t i = 0; i < PER_PRODUCER;) {
+        Stamp s = {(uint32_t)p, i};
+        if (ring.push(s)) {
+          ++i;
+        } else {
+          // back off so the consumer gets the CPU, even on a one-core host
+          full++;
+          std::this_thread::sleep_for(std::chrono::microseconds(1));
+        }
+      }
+    }));
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<uint32_t> next(PRODUCERS, 0);
+  uint64_t got = 0;
+  Stamp s;
+  while (got < (uint64_t)PRODUCERS * PER_PRODUCER) {
+    if (!ring.pop(s)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(1));
+      continue;
+    }
+    TEST_ASSERT_TRUE(s.producer < (uint32_t)PRODUCERS);
+    TEST_ASSERT_EQUAL_UINT32(next[s.producer], s.seq);
+    next[s.producer]++;
+    got++;
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  for (size_t i = 0; i < producers.size(); ++i) producers[i].join();
+
+  TEST_ASSERT_FALSE(ring.pop(s));
+  TEST_ASSERT_EQUAL_UINT16(0, ring.depth());
+  TEST_ASSERT_EQUAL_UINT32(full.load(), ring.droppedCount()); // each failed push counted once
+
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%d producers x %u: %.1f ns per event end to end, %u pushes found it full",
+           PRODUCERS, (unsigned)PER_PRODUCER, ns / got, (unsigned)full.load());
+  TEST_MESSAGE(msg);
+}
+
+// Producers that do not retry: what is not delivered is counted as dropped,
+// and what is delivered keeps each producer's order
+static void test_stress_drops_are_counted() {
+  static MpscRing<Stamp, 8> ring;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> accepted(0);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < PRODUCERS; ++p) {
+    producers.push_back(std::thread([p, &accepted] {
+      for (uint32_t i = 0; i < PER_PRODUCER / 4; ++i) {
+        Stamp s = {(uint32_t)p, i};
+        if (ring.push(s)) accepted++;
+      }
+    }));
+  }
+  std::thread joiner([&producers, &done] {
+    for (size_t i = 0; i < producers.size(); ++i) producers[i].join();
+    done = true;
+  });
+
+  std::vector<int64_t> last(PRODUCERS, -1);
+  uint32_t got = 0;
+  Stamp s;
+  for (;;) {
+    bool finished = done;
+    while (ring.pop(s)) {
+      TEST_ASSERT_TRUE((int64_t)s.seq > last[s.producer]);
+      last[s.producer] = s.seq;
+      got++;
+    }
+    if (finished) break;
+    std::this_thread::yield();
+  }
+  joiner.join();
+  while (ring.pop(s)) got++;
+
+  TEST_ASSERT_EQUAL_UINT32(accepted.load(), got);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)PRODUCERS * (PER_PRODUCER / 4), got + ring.droppedCount());
+}
+
+// push() on its own: one producer, the ring drained between batches
+static void test_push_cost() {
+  static MpscRing<Stamp, 1024> ring;
+  const int ROUNDS = 2000;
+  std::chrono::steady_clock::duration pushing(0);
+  Stamp s;
+  for (int r = 0; r < ROUNDS; ++r) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < 1024; ++i) ring.push(Stamp{0, i});
+    pushing += std::chrono::steady_clock::now() - t0;
+    while (ring.pop(s)) {
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, ring.droppedCount());
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%.1f ns per push(), uncontended",
+           std::chrono::duration<double, std::nano>(pushing).count() / (ROUNDS * 1024.0));
+  TEST_MESSAGE(msg);
+}
+
+static void test_full_ring_rejects_and_recovers() {
+  MpscRing<Stamp, 4> ring;
+  for (uint32_t i = 0; i < 4; ++i) TEST_ASSERT_TRUE(ring.push(Stamp{0, i}));
+  TEST_ASSERT_FALSE(ring.push(Stamp{0, 4}));
+  TEST_ASSERT_EQUAL_UINT16(4, ring.depth());
+  TEST_ASSERT_EQUAL_UINT32(1, ring.droppedCount());
+
+  Stamp s;
+  TEST_ASSERT_TRUE(ring.pop(s));
+  TEST_ASSERT_EQUAL_UINT32(0, s.seq);
+  TEST_ASSERT_TRUE(ring.push(Stamp{0, 5}));
+  for (uint32_t want : {1u, 2u, 3u, 5u}) {
+    TEST_ASSERT_TRUE(ring.pop(s));
+    TEST_ASSERT_EQUAL_UINT32(want, s.seq);
+  }
+  TEST_ASSERT_FALSE(ring.pop(s));
+}
+
+static std::vector<Event> seenA, seenB;
+static void handlerA(const Event &e) { seenA.push_back(e); }
+static void handlerB(const Event &e) { seenB.push_back(e); }
+
+static void test_drain_dispatches_to_every_subscriber_in_order() {
+  fakeNowMs() = 42;
+  TEST_ASSERT_TRUE(eventPost(EventType::BUTTON, 4, LOW));
+  TEST_ASSERT_TRUE(eventPost(EventType::STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT));
+  eventDrain<EventHandlers<handlerA, handlerB> >();
+
+  TEST_ASSERT_EQUAL(2, seenA.size());
+  TEST_ASSERT_EQUAL(2, seenB.size());
+  TEST_ASSERT_EQUAL(EventType::BUTTON, seenA[0].type);
+  TEST_ASSERT_EQUAL_UINT8(4, seenA[0].code);
+  TEST_ASSERT_EQUAL_UINT32(42, seenA[0].atMs);
+  TEST_ASSERT_EQUAL(EventType::STA_DISCONNECTED, seenB[1].type);
+  TEST_ASSERT_EQUAL_UINT8(WIFI_REASON_BEACON_TIMEOUT, seenB[1].code);
+}
+
+static void test_drain_is_bounded_per_call() {
+  seenA.clear();
+  for (int i = 0; i < EVENT_QUEUE_LEN + 3; ++i) eventPost(EventType::RUN_STATE, (uint8_t)i);
+  TEST_ASSERT_EQUAL_UINT32(3, eventStats().dropped);
+  eventDrain<EventHandlers<handlerA> >();
+  TEST_ASSERT_EQUAL(EVENT_QUEUE_LEN, seenA.size());
+  TEST_ASSERT_EQUAL_UINT16(EVENT_QUEUE_LEN, eventStats().maxDepth);
+  TEST_ASSERT_EQUAL_UINT16(0, eventDepth());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_stress_no_loss_no_reorder);
+  RUN_TEST(test_stress_drops_are_counted);
+  RUN_TEST(test_push_cost);
+  RUN_TEST(test_full_ring_rejects_and_recovers);
+  RUN_TEST(test_drain_dispatches_to_every_subscriber_in_order);
+  RUN_TEST(test_drain_is_bounded_per_call);
+  return UNITY_END();
+}
@@ -0,0 +1,293 @@
+// PortalServer request parsing and connection handling, over the in-memory
+// sockets of test/fakes/WiFi.h
+
+#include <unity.h>
+
+#include <vector>
+
+#include "../../src/portal_server.cpp"
+
+struct Reply {
+  int code;
+  std::string head; // status line and headers
+  std::string body;
+};
+
+// Splits everything a connection received into responses by Content-Length
+static std::vector<Reply> replies(const std::string &out, bool head = false) {
+  std::vector<Reply> v;
+  size_t pos = 0;
+  while (pos < out.size()) {
+    size_t end = out.find("\r\n\r\n", pos);
+    if (end == std::string::npos) break;
+    Reply r;
+    r.head = out.substr(pos, end + 2 - pos);
+    r.code = atoi(out.c_str() + pos + 9);
+    size_t cl = r.head.find("Content-Length: ");
+    size_t len = (cl == std::string::npos || head) ? 0 : strtoul(r.head.c_str() + cl + 16, nullptr, 10);
+    r.body = out.substr(end + 4, len);
+    v.push_back(r);
+    pos = end + 4 + len;
+  }
+  return v;
+}
+
+static bool hasHeader(const Reply &r, const char *line) {
+  return r.head.find(std::string("\r\n") + line + "\r\n") != std::string::npos;
+}
+
+static PortalServer server(80);
+static uint32_t ticket;
+
+void setUp() {
+  server.stop();
+  server.clearRoutes();
+  fakeBacklog().clear();
+  fakeNowMs() = 1000;
+  server.on("/status", HTTP_GET, [] { server.send(200, "application/json", String("{\"a\":1}")); });
+  server.on("/save", HTTP_POST, [] {
+    server.send(200, "text/plain", server.arg("ssid") + "|" + server.arg("pass") + "|" + server.header("x-foo"));
+  });
+  server.on("/slow", HTTP_GET, [] { ticket = server.defer(); });
+  server.on("/light", HTTP_POST, [] { server.send(204, nullptr, ""); });
+  server.on("/cached", HTTP_GET, [] {
+    server.sendHeader("ETag", "\"1-1\"");
+    server.send(304, nullptr, "");
+  });
+  server.onNotFound([] { server.send(200, "text/html", "page " + server.uri()); });
+  server.begin();
+}
+
+void tearDown() {}
+
+static void test_keep_alive_serves_requests_on_one_connection() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /status HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n";
+  server.handleClient();
+  s->toServer = "GET /status HTTP/1.1\r\n\r\n";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(2, r.size());
+  TEST_ASSERT_EQUAL(200, r[1].code);
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", r[1].body.c_str());
+  TEST_ASSERT_TRUE(hasHeader(r[0], "Connection: keep-alive"));
+  TEST_ASSERT_TRUE(s->open);
+  TEST_ASSERT_EQUAL(1, server.connectionCount());
+  TEST_ASSERT_EQUAL(2, server.requestCount());
+}
+
+static void test_pipelined_requests_are_answered_in_order() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /status HTTP/1.1\r\n\r\n"
+                "POST /save HTTP/1.1\r\nContent-Length: 9\r\n\r\nssid=Home"
+                "GET /index.html HTTP/1.1\r\n\r\n";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(3, r.size());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", r[0].body.c_str());
+  TEST_ASSERT_EQUAL_STRING("Home||", r[1].body.c_str());
+  TEST_ASSERT_EQUAL_STRING("page /index.html", r[2].body.c_str());
+}
+
+static void test_body_split_across_reads_waits_for_content_length() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "POST /save HTTP/1.1\r\nX-Foo:  bar \r\nContent-Length: 26\r\n\r\nssid=My+Net%21";
+  server.handleClient();
+  TEST_ASSERT_EQUAL(0, s->fromServer.size());
+
+  s->toServer = "&pass=a%26b";
+  server.handleClient();
+  TEST_ASSERT_EQUAL(0, s->fromServer.size());
+  s->toServer = "c";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL_STRING("My Net!|a&bc|bar", r[0].body.c_str());
+}
+
+static void test_headers_split_across_reads() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  const char *req = "GET /status HTTP/1.1\r\nHost: x\r\n\r\n";
+  for (const char *p = req; *p; ++p) {
+    s->toServer = std::string(1, *p);
+    server.handleClient();
+  }
+  TEST_ASSERT_EQUAL(1, replies(s->fromServer).size());
+}
+
+static void test_oversize_headers_get_413_and_close() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /status HTTP/1.1\r\nX-Pad: " + std::string(PORTAL_MAX_REQUEST_LEN, 'a');
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].code);
+  TEST_ASSERT_FALSE(s->open);
+}
+
+static void test_oversize_content_length_gets_413() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "POST /save HTTP/1.1\r\nContent-Length: 100000\r\n\r\nssid=x";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].code);
+  TEST_ASSERT_TRUE(hasHeader(r[0], "Connection: close"));
+  TEST_ASSERT_FALSE(s->open);
+}
+
+static void test_content_length_overflow_gets_413() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "POST /save HTTP/1.1\r\nContent-Length: 99999999999999999999\r\n\r\nssid=x";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].code);
+}
+
+static void test_malformed_request_line_and_unknown_method() {
+  std::shared_ptr<FakeSocket> a = fakeConnect();
+  a->toServer = "GARBAGE\r\n\r\n";
+  std::shared_ptr<FakeSocket> b = fakeConnect();
+  b->toServer = "BREW /pot HTTP/1.1\r\n\r\n";
+  server.handleClient();
+
+  TEST_ASSERT_EQUAL(400, replies(a->fromServer)[0].code);
+  TEST_ASSERT_EQUAL(501, replies(b->fromServer)[0].code);
+  TEST_ASSERT_FALSE(a->open);
+  TEST_ASSERT_FALSE(b->open);
+}
+
+static void test_http10_closes_after_response() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /foo?x=1 HTTP/1.0\r\n\r\n";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL_STRING("page /foo", r[0].body.c_str());
+  TEST_ASSERT_TRUE(hasHeader(r[0], "Connection: close"));
+  TEST_ASSERT_FALSE(s->open);
+}
+
+static void test_head_sends_headers_only() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "HEAD /status HTTP/1.1\r\n\r\n";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer, true);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_TRUE(hasHeader(r[0], "Content-Length: 7"));
+  TEST_ASSERT_EQUAL(r[0].head.size() + 2, s->fromServer.size());
+}
+
+static void test_204_and_304_carry_no_content_length() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "POST /light HTTP/1.1\r\n\r\nGET /cached HTTP/1.1\r\n\r\nGET /status HTTP/1.1\r\n\r\n";
+  server.handleClient();
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(3, r.size());
+  TEST_ASSERT_EQUAL(204, r[0].code);
+  TEST_ASSERT_EQUAL(304, r[1].code);
+  TEST_ASSERT_EQUAL(std::string::npos, r[0].head.find("Content-Length"));
+  TEST_ASSERT_EQUAL(std::string::npos, r[1].head.find("Content-Length"));
+  TEST_ASSERT_TRUE(hasHeader(r[1], "ETag: \"1-1\""));
+  TEST_ASSERT_TRUE(hasHeader(r[1], "Connection: keep-alive"));
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", r[2].body.c_str());
+}
+
+static void test_idle_connection_times_out() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  server.handleClient();
+  fakeNowMs() += PORTAL_IDLE_TIMEOUT_MS - 1;
+  server.handleClient();
+  TEST_ASSERT_TRUE(s->open);
+  fakeNowMs() += 2;
+  server.handleClient();
+  TEST_ASSERT_FALSE(s->open);
+}
+
+static void test_full_pool_evicts_least_recently_active() {
+  std::vector<std::shared_ptr<FakeSocket> > s;
+  for (int i = 0; i < PORTAL_MAX_CONNS; ++i) {
+    s.push_back(fakeConnect());
+    server.handleClient();
+    fakeNowMs() += 10;
+  }
+  s[0]->toServer = "GET /status HTTP/1.1\r\n\r\n"; // s[1] is now the oldest
+  server.handleClient();
+  std::shared_ptr<FakeSocket> extra = fakeConnect();
+  server.handleClient();
+
+  TEST_ASSERT_TRUE(s[0]->open);
+  TEST_ASSERT_FALSE(s[1]->open);
+  TEST_ASSERT_TRUE(extra->open);
+}
+
+static void test_deferred_request_is_parked_until_respond() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /slow HTTP/1.1\r\n\r\nGET /status HTTP/1.1\r\n\r\n";
+  server.handleClient();
+  TEST_ASSERT_NOT_EQUAL(0, ticket);
+  TEST_ASSERT_EQUAL(0, s->fromServer.size());
+
+  fakeNowMs() += PORTAL_IDLE_TIMEOUT_MS * 2; // parked: not timed out
+  server.handleClient();
+  TEST_ASSERT_TRUE(s->open);
+
+  TEST_ASSERT_TRUE(server.respond(ticket, 200, "text/plain", "done"));
+  TEST_ASSERT_FALSE(server.respond(ticket, 200, "text/plain", "again"));
+  server.handleClient(); // the pipelined request behind it
+
+  std::vector<Reply> r = replies(s->fromServer);
+  TEST_ASSERT_EQUAL(2, r.size());
+  TEST_ASSERT_EQUAL_STRING("done", r[0].body.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", r[1].body.c_str());
+}
+
+static void test_respond_to_a_closed_connection_fails() {
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /slow HTTP/1.1\r\n\r\n";
+  server.handleClient();
+  s->open = false;
+  server.handleClient();
+  TEST_ASSERT_FALSE(server.respond(ticket, 200, "text/plain", "late"));
+}
+
+static void test_unrouted_request_without_not_found_gets_404() {
+  server.stop();
+  server.clearRoutes();
+  server.begin();
+  std::shared_ptr<FakeSocket> s = fakeConnect();
+  s->toServer = "GET /nothing HTTP/1.1\r\n\r\n";
+  server.handleClient();
+  TEST_ASSERT_EQUAL(404, replies(s->fromServer)[0].code);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keep_alive_serves_requests_on_one_connection);
+  RUN_TEST(test_pipelined_requests_are_answered_in_order);
+  RUN_TEST(test_body_split_across_reads_waits_for_content_length);
+  RUN_TEST(test_headers_split_across_reads);
+  RUN_TEST(test_oversize_headers_get_413_and_close);
+  RUN_TEST(test_oversize_content_length_gets_413);
+  RUN_TEST(test_content_length_overflow_gets_413);
+  RUN_TEST(test_malformed_request_line_and_unknown_method);
+  RUN_TEST(test_http10_closes_after_response);
+  RUN_TEST(test_head_sends_headers_only);
+  RUN_TEST(test_204_and_304_carry_no_content_length);
+  RUN_TEST(test_idle_connection_times_out);
+  RUN_TEST(test_full_pool_evicts_least_recently_active);
+  RUN_TEST(test_deferred_request_is_parked_until_respond);
+  RUN_TEST(test_respond_to_a_closed_connection_fails);
+  RUN_TEST(test_unrouted_request_without_not_found_gets_404);
+  return UNITY_END();
+}
@@ -0,0 +1,126 @@
+// classifyReason() and RetryPolicy::onFailure() over every FailClass of
+// BOOT_RETRY_RULES and SAVE_RETRY_RULES
+
+#include <unity.h>
+
+#include "retry_rules.h"
+
+void setUp() {}
+void tearDown() {}
+
+static FailClass cls(size_t i) {
+  return (FailClass)i;
+}
+
+// What onFailure() must return for the n-th failure (1-based) under rule r
+static int32_t expectedDelay(const RetryRule &r, uint8_t n) {
+  if (n >= r.maxAttempts) return -1;
+  uint32_t d = (uint32_t)r.firstDelayMs << (n - 1 < 4 ? n - 1 : 4);
+  return d > r.maxDelayMs ? r.maxDelayMs : d;
+}
+
+static void test_classify_known_reasons() {
+  TEST_ASSERT_EQUAL(FailClass::CONNECT_TIMEOUT, classifyReason(0));
+  TEST_ASSERT_EQUAL(FailClass::NONE, classifyReason(WIFI_REASON_ASSOC_LEAVE));
+  TEST_ASSERT_EQUAL(FailClass::AUTH_FAIL, classifyReason(WIFI_REASON_AUTH_FAIL));
+  TEST_ASSERT_EQUAL(FailClass::AUTH_FAIL, classifyReason(WIFI_REASON_MIC_FAILURE));
+  TEST_ASSERT_EQUAL(FailClass::AUTH_FAIL, classifyReason(WIFI_REASON_802_1X_AUTH_FAILED));
+  TEST_ASSERT_EQUAL(FailClass::HANDSHAKE_TIMEOUT, classifyReason(WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT));
+  TEST_ASSERT_EQUAL(FailClass::HANDSHAKE_TIMEOUT, classifyReason(WIFI_REASON_HANDSHAKE_TIMEOUT));
+  TEST_ASSERT_EQUAL(FailClass::NO_AP_FOUND, classifyReason(WIFI_REASON_NO_AP_FOUND));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_ASSOC_FAIL));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_ASSOC_TOOMANY));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_ASSOC_EXPIRE));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_AUTH_EXPIRE));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_NOT_AUTHED));
+  TEST_ASSERT_EQUAL(FailClass::ASSOC_FAIL, classifyReason(WIFI_REASON_NOT_ASSOCED));
+  TEST_ASSERT_EQUAL(FailClass::BEACON_TIMEOUT, classifyReason(WIFI_REASON_BEACON_TIMEOUT));
+  TEST_ASSERT_EQUAL(FailClass::BEACON_TIMEOUT, classifyReason(WIFI_REASON_CONNECTION_FAIL));
+  TEST_ASSERT_EQUAL(FailClass::OTHER, classifyReason(WIFI_REASON_UNSPECIFIED));
+  TEST_ASSERT_EQUAL(FailClass::OTHER, classifyReason(WIFI_REASON_ROAMING));
+}
+
+static void test_classify_every_reason_lands_in_a_class() {
+  size_t seen[FAIL_CLASS_COUNT] = {};
+  for (unsigned r = 0; r <= 255; ++r) {
+    FailClass c = classifyReason((uint8_t)r);
+    TEST_ASSERT_TRUE((size_t)c < FAIL_CLASS_COUNT);
+    TEST_ASSERT_TRUE(strcmp(failClassName(c), "?") != 0);
+    seen[(size_t)c]++;
+  }
+  // and every class is some reason's
+  for (size_t i = 0; i < FAIL_CLASS_COUNT; ++i) TEST_ASSERT_TRUE(seen[i] > 0);
+}
+
+static void walkTable(const RetryTable &table, const char *name) {
+  for (size_t i = 0; i < FAIL_CLASS_COUNT; ++i) {
+    const RetryRule &r = table[i];
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s %s", name, failClassName(cls(i)));
+    TEST_ASSERT_TRUE_MESSAGE(r.maxAttempts >= 1, msg);
+    TEST_ASSERT_TRUE_MESSAGE(r.firstDelayMs <= r.maxDelayMs, msg);
+
+    RetryPolicy p(table);
+    for (uint8_t n = 1; n <= r.maxAttempts + 2; ++n) {
+      TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedDelay(r, n), p.onFailure(cls(i)), msg);
+      TEST_ASSERT_EQUAL_UINT8_MESSAGE(n, p.failures(cls(i)), msg);
+    }
+    // budgets are per class
+    for (size_t j = 0; j < FAIL_CLASS_COUNT; ++j) {
+      if (j != i) TEST_ASSERT_EQUAL_UINT8_MESSAGE(0, p.failures(cls(j)), msg);
+    }
+    p.reset();
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedDelay(r, 1), p.onFailure(cls(i)), msg);
+  }
+}
+
+static void test_boot_rules_every_class() {
+  walkTable(BOOT_RETRY_RULES, "boot");
+}
+
+static void test_save_rules_every_class() {
+  walkTable(SAVE_RETRY_RULES, "save");
+}
+
+static void test_boot_connect_timeout_backoff() {
+  RetryPolicy p(BOOT_RETRY_RULES);
+  TEST_ASSERT_EQUAL_INT32(1000, p.onFailure(FailClass::CONNECT_TIMEOUT));
+  TEST_ASSERT_EQUAL_INT32(2000, p.onFailure(FailClass::CONNECT_TIMEOUT));
+  TEST_ASSERT_EQUAL_INT32(4000, p.onFailure(FailClass::CONNECT_TIMEOUT));
+  TEST_ASSERT_EQUAL_INT32(8000, p.onFailure(FailClass::CONNECT_TIMEOUT));
+  TEST_ASSERT_EQUAL_INT32(-1, p.onFailure(FailClass::CONNECT_TIMEOUT));
+}
+
+static void test_save_fails_fast_on_credential_problems() {
+  const FailClass fast[] = {FailClass::AUTH_FAIL, FailClass::HANDSHAKE_TIMEOUT, FailClass::NO_AP_FOUND};
+  for (FailClass c : fast) {
+    RetryPolicy p(SAVE_RETRY_RULES);
+    TEST_ASSERT_EQUAL_INT32(-1, p.onFailure(c));
+  }
+}
+
+static void test_reasons_through_the_policy() {
+  // a wrong password at boot: one retry after 2 s, then give up
+  RetryPolicy p(BOOT_RETRY_RULES);
+  TEST_ASSERT_EQUAL_INT32(2000, p.onFailure(classifyReason(WIFI_REASON_AUTH_FAIL)));
+  TEST_ASSERT_EQUAL_INT32(-1, p.onFailure(classifyReason(WIFI_REASON_MIC_FAILURE)));
+}
+
+static void test_out_of_range_class_counts_as_other() {
+  RetryPolicy p(BOOT_RETRY_RULES);
+  p.onFailure((FailClass)200);
+  TEST_ASSERT_EQUAL_UINT8(1, p.failures(FailClass::OTHER));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_classify_known_reasons);
+  RUN_TEST(test_classify_every_reason_lands_in_a_class);
+  RUN_TEST(test_boot_rules_every_class);
+  RUN_TEST(test_save_rules_every_class);
+  RUN_TEST(test_boot_connect_timeout_backoff);
+  RUN_TEST(test_save_fails_fast_on_credential_problems);
+  RUN_TEST(test_reasons_through_the_policy);
+  RUN_TEST(test_out_of_range_class_counts_as_other);
+  return UNITY_END();
+}
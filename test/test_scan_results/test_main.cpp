@@ -0,0 +1,86 @@
+// ScanTopK: one entry per SSID, the K strongest, and when a scan may say an
+// SSID is out of range (the /save pre-flight)
+
+#include <unity.h>
+
+#include "scan_results.h"
+
+void setUp() {}
+void tearDown() {}
+
+static ScanTopK<4> results;
+
+static void add(const char *ssid, int32_t rssi) {
+  results.add(String(ssid), rssi, 6, WIFI_AUTH_WPA2_PSK);
+}
+
+static void test_keeps_strongest_bssid_per_ssid() {
+  results.clear();
+  add("mesh", -80);
+  add("mesh", -50);
+  add("mesh", -70);
+  TEST_ASSERT_EQUAL_UINT8(1, results.size());
+  TEST_ASSERT_EQUAL_INT8(-50, results.find("mesh")->rssi);
+}
+
+static void test_keeps_k_strongest_strongest_first() {
+  results.clear();
+  const char *names[] = {"a", "b", "c", "d", "e", "f"};
+  const int32_t rssi[] = {-90, -40, -70, -60, -85, -50};
+  for (int i = 0; i < 6; ++i) add(names[i], rssi[i]);
+  uint8_t order[4];
+  TEST_ASSERT_EQUAL_UINT8(4, results.strongestFirst(order));
+  TEST_ASSERT_EQUAL_STRING("b", results[order[0]].ssid);
+  TEST_ASSERT_EQUAL_STRING("f", results[order[1]].ssid);
+  TEST_ASSERT_EQUAL_STRING("d", results[order[2]].ssid);
+  TEST_ASSERT_EQUAL_STRING("c", results[order[3]].ssid);
+  TEST_ASSERT_NULL(results.find("a"));
+}
+
+static void test_complete_scan_rules_out_unseen_ssid() {
+  results.clear();
+  add("home", -60);
+  add("office", -70);
+  TEST_ASSERT_TRUE(results.rulesOut("cafe"));
+  TEST_ASSERT_FALSE(results.rulesOut("home"));
+}
+
+static void test_hidden_network_keeps_unseen_ssid_possible() {
+  results.clear();
+  add("home", -60);
+  add("", -55); // a hidden network: could be the one the user typed
+  TEST_ASSERT_EQUAL_UINT8(1, results.size());
+  TEST_ASSERT_TRUE(results.sawHidden());
+  TEST_ASSERT_FALSE(results.rulesOut("my-hidden-net"));
+
+  results.clear();
+  TEST_ASSERT_FALSE(results.sawHidden());
+  TEST_ASSERT_TRUE(results.rulesOut("my-hidden-net"));
+}
+
+static void test_truncated_scan_rules_nothing_out() {
+  results.clear();
+  add("a", -40);
+  add("b", -50);
+  add("c", -60);
+  add("d", -70);
+  TEST_ASSERT_FALSE(results.rulesOut("e"));
+}
+
+static void test_overlong_ssid_is_dropped() {
+  results.clear();
+  add("0123456789abcdef0123456789abcdefX", -40);
+  TEST_ASSERT_EQUAL_UINT8(0, results.size());
+  TEST_ASSERT_FALSE(results.sawHidden());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_keeps_strongest_bssid_per_ssid);
+  RUN_TEST(test_keeps_k_strongest_strongest_first);
+  RUN_TEST(test_complete_scan_rules_out_unseen_ssid);
+  RUN_TEST(test_hidden_network_keeps_unseen_ssid_possible);
+  RUN_TEST(test_truncated_scan_rules_nothing_out);
+  RUN_TEST(test_overlong_ssid_is_dropped);
+  return UNITY_END();
+}
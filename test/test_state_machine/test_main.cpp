@@ -0,0 +1,140 @@
+// StateMachine over the real RunTable: every RunEvent from every RunState,
+// with the guard passing and failing
+
+#include <unity.h>
+
+#include "run_table.h"
+
+static bool linkUp;
+static int setupPatterns;
+static int connectedShown;
+static int changes;
+
+bool staLinkUp() { return linkUp; }
+void enterSetupPattern() { setupPatterns++; }
+void showConnected() { connectedShown++; }
+
+static void onChange(RunState, RunState) { changes++; }
+static const char *stateName(RunState) { return ""; }
+static const char *eventName(RunEvent) { return ""; }
+
+const RunState STATES[] = {RunState::CONNECTING, RunState::AP_SETUP, RunState::CONNECTED};
+const RunEvent EVENTS[] = {RunEvent::PORTAL_UP, RunEvent::STA_UP};
+
+enum class Action { NONE, SETUP_PATTERN, SHOW_CONNECTED };
+
+struct Expect {
+  bool accepted;
+  RunState to;
+  Action action;
+};
+
+// The intended behaviour, written out independently of the table
+static Expect expected(RunState from, RunEvent on, bool guard) {
+  Expect rejected = {false, from, Action::NONE};
+  if (from == RunState::CONNECTING && on == RunEvent::PORTAL_UP)
+    return {true, RunState::AP_SETUP, Action::SETUP_PATTERN};
+  if ((from == RunState::CONNECTING || from == RunState::AP_SETUP) && on == RunEvent::STA_UP)
+    return guard ? Expect{true, RunState::CONNECTED, Action::SHOW_CONNECTED} : rejected;
+  return rejected;
+}
+
+void setUp() {
+  linkUp = false;
+  setupPatterns = 0;
+  connectedShown = 0;
+  changes = 0;
+  fakeNowMs() = 0;
+}
+void tearDown() {}
+
+static void test_every_event_from_every_state() {
+  char msg[64];
+  for (RunState from : STATES) {
+    for (RunEvent on : EVENTS) {
+      for (int guard = 0; guard < 2; guard++) {
+        setUp();
+        snprintf(msg, sizeof(msg), "state %d event %d guard %d", (int)from, (int)on, guard);
+        linkUp = guard;
+        fakeNowMs() = 1234;
+        RunState state = from;
+        StateMachine<RunState, RunEvent, RunTable> fsm(state, stateName, eventName, onChange);
+        Expect want = expected(from, on, guard);
+
+        TEST_ASSERT_EQUAL_MESSAGE(want.accepted, fsm.fire(on), msg);
+        TEST_ASSERT_EQUAL_MESSAGE((int)want.to, (int)state, msg);
+        TEST_ASSERT_EQUAL_MESSAGE((int)want.to, (int)fsm.state(), msg);
+        TEST_ASSERT_EQUAL_MESSAGE(want.action == Action::SETUP_PATTERN, setupPatterns, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(want.action == Action::SHOW_CONNECTED, connectedShown, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(want.to != from, changes, msg);
+
+        TEST_ASSERT_EQUAL_MESSAGE(1, fsm.count(), msg);
+        const FsmTrace<RunState, RunEvent> &t = fsm.trace(0);
+        TEST_ASSERT_EQUAL_MESSAGE(1234, t.atMs, msg);
+        TEST_ASSERT_EQUAL_MESSAGE((int)from, (int)t.from, msg);
+        TEST_ASSERT_EQUAL_MESSAGE((int)on, (int)t.on, msg);
+        TEST_ASSERT_EQUAL_MESSAGE((int)want.to, (int)t.to, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(want.accepted, t.accepted, msg);
+      }
+    }
+  }
+}
+
+// The compile-time form goes through the same table
+static void test_fire_template_matches_runtime_form() {
+  RunState state = RunState::CONNECTING;
+  StateMachine<RunState, RunEvent, RunTable> fsm(state, stateName, eventName, onChange);
+  TEST_ASSERT_FALSE(fsm.fire<RunEvent::STA_UP>());
+  TEST_ASSERT_TRUE(fsm.fire<RunEvent::PORTAL_UP>());
+  linkUp = true;
+  TEST_ASSERT_TRUE(fsm.fire<RunEvent::STA_UP>());
+  TEST_ASSERT_EQUAL((int)RunState::CONNECTED, (int)state);
+  TEST_ASSERT_EQUAL(1, setupPatterns);
+  TEST_ASSERT_EQUAL(1, connectedShown);
+  TEST_ASSERT_EQUAL(2, changes);
+}
+
+// Oldest entries fall out; trace(0) is the oldest kept
+static void test_trace_keeps_the_last_entries_in_order() {
+  RunState state = RunState::CONNECTED;
+  StateMachine<RunState, RunEvent, RunTable> fsm(state, stateName, eventName, onChange);
+  const uint32_t fired = FSM_TRACE_LEN + 3;
+  for (uint32_t i = 0; i < fired; i++) {
+    fakeNowMs() = i;
+    fsm.fire(RunEvent::STA_UP);
+  }
+  TEST_ASSERT_EQUAL(FSM_TRACE_LEN, fsm.count());
+  for (uint8_t i = 0; i < fsm.count(); i++) TEST_ASSERT_EQUAL(fired - FSM_TRACE_LEN + i, fsm.trace(i).atMs);
+}
+
+// What the static_asserts in state_machine.h test; test/compile_fail
+// checks that they actually stop the build
+static void test_table_checks() {
+  static_assert(RunTable::reachable(), "RunTable has a shadowed row");
+  static_assert(RunTable::handles(RunEvent::PORTAL_UP) && RunTable::handles(RunEvent::STA_UP),
+                "every RunEvent has a row");
+
+  typedef FsmTable<RunState, RunEvent,
+    RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED>,
+    RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::AP_SETUP>
+  > Duplicate;
+  typedef FsmTable<RunState, RunEvent,
+    RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED, staLinkUp>,
+    RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::AP_SETUP>
+  > GuardedFirst;
+  typedef FsmTable<RunState, RunEvent,
+    RunRow<RunState::CONNECTING, RunEvent::STA_UP, RunState::CONNECTED>
+  > NoPortalRow;
+  static_assert(!Duplicate::reachable(), "unguarded duplicate row is caught");
+  static_assert(GuardedFirst::reachable(), "a guarded row may be followed by a fallback");
+  static_assert(!NoPortalRow::handles(RunEvent::PORTAL_UP), "missing row is caught");
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_event_from_every_state);
+  RUN_TEST(test_fire_template_matches_runtime_form);
+  RUN_TEST(test_trace_keeps_the_last_entries_in_order);
+  RUN_TEST(test_table_checks);
+  return UNITY_END();
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Local API benchmark: requests/s and heap, idle vs under load.
+
+Talks to a connected bulb on its station address. Reads the heap numbers
+from /metrics while idle, then sends batched POST /light requests (power,
+brightness, color, transition_ms in one request) for --seconds and reads
+/metrics again. Reports requests/s, median / p90 latency and the change in
+free heap, so runs on different firmware builds can be compared.
+
+  tools/api_bench.py --host 192.168.1.57
+  tools/api_bench.py --host 192.168.1.57 --conns 2 --seconds 20
+  tools/api_bench.py --host 192.168.1.57 --get    # GET /light instead
+"""
+
+import argparse
+import http.client
+import json
+import random
+import statistics
+import threading
+import time
+
+
+def metrics(host):
+    conn = http.client.HTTPConnection(host, 80, timeout=10)
+    conn.request("GET", "/metrics", headers={"Connection": "close"})
+    body = json.loads(conn.getresponse().read())
+    conn.close()
+    return body
+
+
+def worker(host, deadline, use_get, latencies, errors):
+    conn = http.client.HTTPConnection(host, 80, timeout=10)
+    headers = {"Content-Type": "application/x-www-form-urlencoded"}
+    while time.perf_counter() < deadline:
+        if use_get:
+            method, body = "GET", None
+        else:
+            method = "POST"
+            body = "power=1&brightness=%d&color=%d&transition_ms=200" % (
+                random.randint(1000, 65535), random.randint(0, 65535))
+        start = time.perf_counter()
+        try:
+            conn.request(method, "/light", body=body, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+        except (http.client.HTTPException, ConnectionError, TimeoutError):
+            # evicted by another worker past the connection cap; reconnect
+            errors.append(1)
+            conn.close()
+            continue
+        if resp.status >= 300:
+            errors.append(resp.status)
+        latencies.append((time.perf_counter() - start) * 1000.0)
+    conn.close()
+
+
+def show_heap(label, m):
+    heap, http_ = m.get("heap", {}), m.get("http", {})
+    print(f"{label:6s} heap free={heap.get('free')} min_free={heap.get('min_free')} "
+          f"largest={heap.get('largest')}  http mode={http_.get('mode')} "
+          f"connections={http_.get('connections')} requests={http_.get('requests')}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--host", required=True, help="the bulb's station IP")
+    ap.add_argument("--seconds", type=float, default=10.0, help="length of the load phase")
+    ap.add_argument("--conns", type=int, default=1, help="parallel keep-alive connections")
+    ap.add_argument("--get", action="store_true", help="GET /light instead of batched POSTs")
+    args = ap.parse_args()
+
+    idle = metrics(args.host)
+    show_heap("idle", idle)
+
+    latencies, errors = [], []
+    deadline = time.perf_counter() + args.seconds
+    threads = [threading.Thread(target=worker, args=(args.host, deadline, args.get, latencies, errors))
+               for _ in range(args.conns)]
+    start = time.perf_counter()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.perf_counter() - start
+
+    loaded = metrics(args.host)
+    show_heap("load", loaded)
+
+    if not latencies:
+        print("no request completed")
+        return
+    p90 = sorted(latencies)[max(0, int(len(latencies) * 0.9) - 1)]
+    print(f"requests: {len(latencies)}  errors: {len(errors)}  {len(latencies) / elapsed:.1f} req/s")
+    print(f"latency median={statistics.median(latencies):.1f} ms  p90={p90:.1f} ms")
+    print(f"free heap after load vs idle: {loaded['heap']['free'] - idle['heap']['free']} bytes")
+    li = loaded.get("light_input", {})
+    print(f"light_input received={li.get('received')} applied={li.get('applied')}")
+
+
+if __name__ == "__main__":
+    main()
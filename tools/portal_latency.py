@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Scripted portal client: TCP handshakes and request latency.
+
+Replays what the portal page does (GET /, GET /scan, then /status once per
+poll) against a device and reports how many TCP connections were opened and
+the median / p90 request latency. Run it from a laptop joined to the
+ModuLux-Setup-XXXX AP, once per firmware build, to compare results.
+
+  tools/portal_latency.py --polls 30
+  tools/portal_latency.py --polls 30 --close   # force one connection per request
+"""
+
+import argparse
+import http.client
+import statistics
+import time
+
+
+class CountingConnection(http.client.HTTPConnection):
+    handshakes = 0
+
+    def connect(self):
+        CountingConnection.handshakes += 1
+        super().connect()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--host", default="192.168.4.1")
+    ap.add_argument("--polls", type=int, default=20, help="number of /status polls")
+    ap.add_argument("--interval", type=float, default=1.0, help="seconds between polls")
+    ap.add_argument("--no-scan", action="store_true", help="skip GET /scan")
+    ap.add_argument("--close", action="store_true", help="send Connection: close on every request")
+    args = ap.parse_args()
+
+    conn = CountingConnection(args.host, 80, timeout=15)
+    headers = {"Connection": "close"} if args.close else {}
+    paths = ["/"] + ([] if args.no_scan else ["/scan"]) + ["/status"] * args.polls
+    latencies = {}
+
+    for i, path in enumerate(paths):
+        if path == "/status" and i > 0:
+            time.sleep(args.interval)
+        start = time.perf_counter()
+        try:
+            conn.request("GET", path, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+        except (http.client.HTTPException, ConnectionError):
+            # server closed an idle/evicted connection; retry once on a new one
+            conn.close()
+            conn.request("GET", path, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+        latencies.setdefault(path, []).append((time.perf_counter() - start) * 1000.0)
+        if resp.getheader("Connection", "").lower() == "close":
+            conn.close()
+
+    total = sum(len(v) for v in latencies.values())
+    print(f"requests: {total}  tcp handshakes: {CountingConnection.handshakes}")
+    for path, ms in latencies.items():
+        p90 = sorted(ms)[max(0, int(len(ms) * 0.9) - 1)]
+        print(f"{path:8s} n={len(ms):3d}  median={statistics.median(ms):7.1f} ms  p90={p90:7.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
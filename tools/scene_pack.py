@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Pack a scene list into an image of the "scenes" flash partition.
+
+Reads a JSON list of scenes and writes a partition-sized binary in the
+layout of include/scenes.h: one SceneTable (seq 1) in slot 0, the rest of
+the partition erased (0xFF). Flash it at the partition offset from
+partitions.csv:
+
+  tools/scene_pack.py tools/scenes.json -o scenes.bin
+  esptool.py --chip esp32 write_flash 0x3e0000 scenes.bin
+
+  [{"name": "reading", "warm": 52000, "cool": 40000, "fade_ms": 300}, ...]
+
+Levels are 0..65535 (see include/light.h). --dump prints the tables found
+in an image read back with `esptool.py read_flash 0x3e0000 0x10000 f.bin`.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+SCENE_MAX = 16
+NAME_LEN = 16
+FORMAT = 1
+MAGIC = 0x314E4353  # "SCN1"
+SLOT_BYTES = 512
+PARTITION_BYTES = 0x10000
+SCENE = struct.Struct("<16sHHHH")  # name, warm, cool, fade_ms, reserved
+HEADER = struct.Struct("<IIHHI")   # magic, seq, count, format, crc
+
+
+def pack_scene(s):
+    name = s["name"].encode("utf-8")
+    if len(name) > NAME_LEN:
+        raise ValueError("scene name longer than %d bytes: %r" % (NAME_LEN, s["name"]))
+    vals = [int(s.get(k, 0)) for k in ("warm", "cool", "fade_ms")]
+    for k, v in zip(("warm", "cool", "fade_ms"), vals):
+        if not 0 <= v <= 0xFFFF:
+            raise ValueError("%s of %r out of range 0..65535" % (k, s["name"]))
+    return SCENE.pack(name.ljust(NAME_LEN, b"\0"), vals[0], vals[1], vals[2], 0)
+
+
+def pack_table(scenes, seq=1):
+    if len(scenes) > SCENE_MAX:
+        raise ValueError("at most %d scenes" % SCENE_MAX)
+    body = b"".join(pack_scene(s) for s in scenes)
+    crc = zlib.crc32(body) & 0xFFFFFFFF
+    # unused entries are left erased; the CRC covers only the first count
+    table = HEADER.pack(MAGIC, seq, len(scenes), FORMAT, crc) + body
+    table += b"\xff" * (HEADER.size + SCENE_MAX * SCENE.size - len(table))
+    return table.ljust(SLOT_BYTES, b"\xff")
+
+
+def dump(image):
+    for slot in range(len(image) // SLOT_BYTES):
+        raw = image[slot * SLOT_BYTES:(slot + 1) * SLOT_BYTES]
+        magic, seq, count, fmt, crc = HEADER.unpack_from(raw)
+        if magic != MAGIC:
+            continue
+        body = raw[HEADER.size:HEADER.size + min(count, SCENE_MAX) * SCENE.size]
+        ok = fmt == FORMAT and count <= SCENE_MAX and zlib.crc32(body) & 0xFFFFFFFF == crc
+        print("slot %3d  seq %-6d %2d scenes  %s" % (slot, seq, count, "ok" if ok else "BAD"))
+        for i in range(min(count, SCENE_MAX)):
+            name, warm, cool, fade, _ = SCENE.unpack_from(body, i * SCENE.size)
+            print("    %2d %-16s warm %5d cool %5d fade %5d ms" % (i, name.rstrip(b"\0").decode("utf-8", "replace"), warm, cool, fade))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("input", help="scene list (.json), or an image with --dump")
+    ap.add_argument("-o", "--output", default="scenes.bin")
+    ap.add_argument("--dump", action="store_true", help="list the tables in a partition image")
+    args = ap.parse_args()
+
+    if args.dump:
+        with open(args.input, "rb") as f:
+            dump(f.read())
+        return 0
+
+    with open(args.input) as f:
+        scenes = json.load(f)
+    try:
+        image = pack_table(scenes).ljust(PARTITION_BYTES, b"\xff")
+    except ValueError as e:
+        print("scene_pack: %s" % e, file=sys.stderr)
+        return 1
+    with open(args.output, "wb") as f:
+        f.write(image)
+    print("wrote %s: %d scenes, %d bytes" % (args.output, len(scenes), len(image)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""Per-component RAM/flash budget from the linker map.
+
+Parses the GNU ld map of the firmware and attributes every input section
+to a component and a memory class:
+
+  component: app:<source file>, indexPage, WebServer, Preferences, WiFi,
+             arduino-core, idf:<lib>, toolchain:<lib>
+  class:     text (.flash.text), rodata (.flash.rodata), data (.dram0.data),
+             bss (.dram0.bss / noinit), iram (.iram0.*), rtc (.rtc.*)
+
+Writes size_report.json and size_report.md next to the map. If a baseline
+exists at tools/size_baseline/<env>.json, the markdown gets per-component
+deltas and the changes are printed; if it does not, the build says so and
+the markdown is marked as having nothing to compare against. Baselines
+come from a real build of each env, so they are committed from a machine
+with the toolchain, never written by hand.
+
+As a PlatformIO extra script (see platformio.ini) the map is produced
+during linking and the report is generated after every firmware build. Set
+SIZE_REPORT_UPDATE_BASELINE=1 to store the current report as the new
+baseline.
+
+Standalone:
+  tools/size_report.py .pio/build/esp32doit-devkit-v1/firmware.map \
+      [--baseline tools/size_baseline/esp32doit-devkit-v1.json]
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+
+CLASSES = ["text", "rodata", "data", "bss", "iram", "rtc"]
+ARDUINO_LIBS = {"WebServer", "Preferences", "WiFi", "FS", "Update", "ESPmDNS"}
+
+
+def memory_class(out_section):
+    if out_section.startswith(".iram0"):
+        return "iram"
+    if out_section.startswith(".dram0.data"):
+        return "data"
+    if out_section.startswith(".dram0.bss") or out_section.startswith(".noinit") or out_section.startswith(".dram0.noinit"):
+        return "bss"
+    if out_section.startswith(".flash.text"):
+        return "text"
+    if out_section.startswith(".flash.rodata") or out_section.startswith(".flash.appdesc"):
+        return "rodata"
+    if out_section.startswith(".rtc"):
+        return "rtc"
+    return None
+
+
+def component(path, section):
+    if "indexPage" in section:
+        return "indexPage"
+    norm = path.replace("\\", "/")
+    m = re.search(r"lib([^/()]+)\.a\(", norm)
+    if m:
+        lib = m.group(1)
+        if lib == "FrameworkArduino":
+            return "arduino-core"
+        if lib in ARDUINO_LIBS:
+            return lib
+        if "toolchain" in norm:
+            return "toolchain:" + lib
+        if "framework-arduinoespressif32" in norm or "/sdk/" in norm:
+            return "idf:" + lib
+        return lib
+    m = re.search(r"/src/(.+?)\.(?:c|cpp|S)\.o$", norm)
+    if m:
+        return "app:" + m.group(1)
+    if "/lib" in norm and ".pio/build" in norm:
+        # project library built from lib/<name>/
+        m = re.search(r"/lib[0-9a-f]*/([^/]+)/", norm)
+        if m:
+            return m.group(1)
+    return "other"
+
+
+def parse_map(path):
+    sizes = {}
+    with open(path, "r", errors="replace") as f:
+        lines = f.read().splitlines()
+
+    try:
+        start = next(i for i, l in enumerate(lines) if l.startswith("Linker script and memory map"))
+    except StopIteration:
+        start = 0
+
+    out_section = None
+    pending = None  # input section name whose address/size is on the next line
+
+    def add(section, size, obj):
+        cls = memory_class(out_section or "")
+        if cls is None or size == 0:
+            return
+        comp = component(obj, section)
+        entry = sizes.setdefault(comp, {c: 0 for c in CLASSES})
+        entry[cls] += size
+
+    for line in lines[start:]:
+        if not line.strip():
+            continue
+        if not line.startswith(" "):
+            out_section = line.split()[0]
+            pending = None
+            continue
+        tokens = line.split()
+        if line.startswith(" ") and not line.startswith("  "):
+            name = tokens[0]
+            if name.startswith("*") or name.startswith("0x"):
+                pending = None
+                continue
+            if len(tokens) == 1:
+                pending = name
+                continue
+            if len(tokens) >= 4 and tokens[1].startswith("0x") and tokens[2].startswith("0x"):
+                add(name, int(tokens[2], 16), " ".join(tokens[3:]))
+            pending = None
+        elif pending and len(tokens) >= 3 and tokens[0].startswith("0x") and tokens[1].startswith("0x"):
+            add(pending, int(tokens[1], 16), " ".join(tokens[2:]))
+            pending = None
+    return sizes
+
+
+def summarize(sizes):
+    totals = {c: sum(v[c] for v in sizes.values()) for c in CLASSES}
+    return {"components": sizes, "totals": totals}
+
+
+def flash_of(v):
+    return v["text"] + v["rodata"] + v["data"] + v["iram"]
+
+
+def ram_of(v):
+    return v["data"] + v["bss"]
+
+
+def markdown(report, baseline, baseline_path=None):
+    base = baseline["components"] if baseline else {}
+    rows = sorted(report["components"].items(), key=lambda kv: flash_of(kv[1]), reverse=True)
+    head = "| component | .text | .rodata | .data | .bss | IRAM | RTC | flash | DRAM |"
+    sep = "|---|---:|---:|---:|---:|---:|---:|---:|---:|"
+    if baseline:
+        head += " Δflash | ΔDRAM |"
+        sep += "---:|---:|"
+    out = [head, sep]
+
+    def row(name, v, b):
+        cells = [name] + [str(v[c]) for c in CLASSES] + [str(flash_of(v)), str(ram_of(v))]
+        if baseline:
+            zero = {c: 0 for c in CLASSES}
+            b = b or zero
+            cells += ["%+d" % (flash_of(v) - flash_of(b)), "%+d" % (ram_of(v) - ram_of(b))]
+        return "| " + " | ".join(cells) + " |"
+
+    for name, v in rows:
+        out.append(row(name, v, base.get(name)))
+    for name in sorted(set(base) - set(report["components"])):
+        gone = {c: 0 for c in CLASSES}
+        out.append(row(name + " (removed)", gone, base[name]))
+    out.append(row("**total**", report["totals"], baseline["totals"] if baseline else None))
+    if not baseline:
+        out += ["", "No baseline%s: no deltas." % (" at " + baseline_path if baseline_path else "")]
+    return "\n".join(out) + "\n"
+
+
+def print_deltas(report, baseline):
+    base = baseline["components"]
+    names = set(base) | set(report["components"])
+    zero = {c: 0 for c in CLASSES}
+    changed = []
+    for name in sorted(names):
+        v = report["components"].get(name, zero)
+        b = base.get(name, zero)
+        df, dr = flash_of(v) - flash_of(b), ram_of(v) - ram_of(b)
+        if df or dr:
+            changed.append((name, df, dr))
+    if not changed:
+        print("size_report: no change against baseline")
+        return
+    print("size_report: changes against baseline (flash / DRAM bytes)")
+    for name, df, dr in sorted(changed, key=lambda t: -abs(t[1]) - abs(t[2])):
+        print("  %-28s %+8d %+8d" % (name, df, dr))
+
+
+def run(map_path, baseline_path, update_baseline=False):
+    report = summarize(parse_map(map_path))
+    out_dir = os.path.dirname(os.path.abspath(map_path))
+    json_path = os.path.join(out_dir, "size_report.json")
+    md_path = os.path.join(out_dir, "size_report.md")
+
+    baseline = None
+    if baseline_path and os.path.exists(baseline_path):
+        with open(baseline_path) as f:
+            baseline = json.load(f)
+    elif baseline_path and not update_baseline:
+        print("size_report: no baseline at %s, nothing to compare against; build with "
+              "SIZE_REPORT_UPDATE_BASELINE=1 and commit it" % baseline_path)
+
+    with open(json_path, "w") as f:
+        json.dump(report, f, indent=1, sort_keys=True)
+    with open(md_path, "w") as f:
+        f.write(markdown(report, baseline, baseline_path))
+
+    t = report["totals"]
+    print("size_report: flash %d (text %d, rodata %d, data %d, iram %d), DRAM %d (data %d, bss %d) -> %s"
+          % (flash_of(t), t["text"], t["rodata"], t["data"], t["iram"], ram_of(t), t["data"], t["bss"], md_path))
+    if baseline:
+        print_deltas(report, baseline)
+    if update_baseline and baseline_path:
+        os.makedirs(os.path.dirname(baseline_path), exist_ok=True)
+        shutil.copyfile(json_path, baseline_path)
+        print("size_report: baseline updated: %s" % baseline_path)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Per-component RAM/flash report from a linker map")
+    ap.add_argument("map")
+    ap.add_argument("--baseline", help="baseline JSON to diff against")
+    ap.add_argument("--update-baseline", action="store_true", help="write this report as the baseline")
+    args = ap.parse_args()
+    run(args.map, args.baseline, args.update_baseline)
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+except NameError:
+    env = None
+
+if env is not None:
+    project_dir = env.subst("$PROJECT_DIR")
+    map_file = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+    baseline_file = os.path.join(project_dir, "tools", "size_baseline", env.subst("$PIOENV") + ".json")
+    env.Append(LINKFLAGS=["-Wl,-Map=" + map_file])
+
+    def _after_build(source, target, env):
+        run(map_file, baseline_file, os.environ.get("SIZE_REPORT_UPDATE_BASELINE") == "1")
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", _after_build)
+elif __name__ == "__main__":
+    main()
@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Record + HTTP replay: fetch, print and replay traces from a TRACE_RECORD build.
+
+The trace (format in include/trace.h) holds the boot's reset reason,
+plan and failed-boot count, then the config overrides and every bus
+event, HTTP request, scan result and end of a channel's scan with its
+millis() timestamp. Printed, it is the timeline the firmware saw. Replayed, its HTTP
+requests are sent to a bulb on the recorded clock (optionally sped up), so
+a field sequence of app requests can be run again at a desk. Wi-Fi events,
+button edges and scan results are inputs of the device itself and are only
+printed; drive those by hand in the same order, or replay the whole trace
+into the firmware on the host with test/replay/. Requests that need the
+config token (POST /config, POST /scenes with store=) are sent with it when
+--token is given, and otherwise come back 401.
+
+  tools/trace_replay.py fetch --host 192.168.1.57 --token <config token> -o trace.bin
+  tools/trace_replay.py show trace.bin
+  tools/trace_replay.py show trace.bin --json          # one JSON object per record
+  tools/trace_replay.py replay trace.bin --host 192.168.1.57 --token <config token> --speed 2
+"""
+
+import argparse
+import http.client
+import json
+import struct
+import sys
+import time
+
+HEADER = struct.Struct("<4sHHIIII")
+HEADER_2 = struct.Struct("<II")  # format 2 appends: failed boots, millis() at traceBegin()
+RECORD = struct.Struct("<IBBH")
+
+EVENT_TYPES = ["STA_GOT_IP", "STA_DISCONNECTED", "AP_CLIENT_JOINED", "BUTTON", "RUN_STATE"]
+BOOT_PLANS = ["PORTAL", "STATION_FULL", "STATION_SHORT", "CONCURRENT"]
+RESET_REASONS = ["UNKNOWN", "POWERON", "EXT", "SW", "PANIC", "INT_WDT", "TASK_WDT", "WDT",
+                 "DEEPSLEEP", "BROWNOUT", "SDIO"]
+HTTP_METHODS = {0: "DELETE", 1: "GET", 2: "HEAD", 3: "POST", 4: "PUT", 6: "OPTIONS"}  # http_parser values
+CONFIG_KEYS = ["max_retries", "connect_ms", "ap_idle_ms", "ap_shutdown_ms", "factory_hold_ms", "blink_conn_ms",
+               "blink_on_ms", "blink_off_ms", "blink_pause_ms", "i_base_ma", "i_sta_ma", "i_sta_sleep_ma", "i_ap_ma",
+               "i_ap_sta_ma", "i_scan_ma", "supply_mv"]  # include/config.h order
+NEVER_REPLAYED = ("/save", "/trace")  # credentials are redacted; the trace itself is not an input
+
+
+def name(table, i):
+    return table[i] if 0 <= i < len(table) else str(i)
+
+
+def parse(data):
+    magic, fmt, header_size, used, dropped, reason, plan = HEADER.unpack_from(data)
+    if magic != b"TRC1" or fmt not in (1, 2):
+        sys.exit("not a format 1 or 2 trace")
+    fails, start_ms = HEADER_2.unpack_from(data, HEADER.size) if fmt >= 2 else (None, None)
+    info = {"used": used, "dropped": dropped, "reset": name(RESET_REASONS, reason), "plan": name(BOOT_PLANS, plan),
+            "boot_fails": fails, "start_ms": start_ms}
+    records = []
+    pos = header_size
+    end = min(used, len(data))
+    while pos + RECORD.size <= end:
+        at_ms, kind, length, arg = RECORD.unpack_from(data, pos)
+        payload = data[pos + RECORD.size:pos + RECORD.size + length]
+        pos += RECORD.size + length
+        r = {"ms": at_ms}
+        if kind == 1:
+            r.update(kind="event", type=name(EVENT_TYPES, arg & 0xff), code=arg >> 8, level=payload[0] if payload else 0)
+        elif kind == 2:
+            text = payload.decode("utf-8", "replace")
+            target, _, body = text.partition(" ")
+            r.update(kind="http", method=HTTP_METHODS.get(arg, str(arg)), target=target, body=body)
+        elif kind == 3:
+            rssi = (arg >> 8) - 256 if arg >> 8 >= 128 else arg >> 8
+            r.update(kind="scan", channel=arg & 0xff, rssi=rssi, auth=payload[0] if payload else 0,
+                     ssid=payload[1:].decode("utf-8", "replace"))
+        elif kind == 4:
+            value = struct.unpack_from("<I", payload)[0] if len(payload) >= 4 else 0
+            r.update(kind="config", key=name(CONFIG_KEYS, arg), value=value)
+        elif kind == 5:
+            r.update(kind="scan_done", channel=arg & 0xff, found=payload[0] if payload else 0)
+        else:
+            r.update(kind=str(kind))
+        records.append(r)
+    return info, records
+
+
+def describe(r):
+    if r["kind"] == "event":
+        return f"event {r['type']} code={r['code']} level={r['level']}"
+    if r["kind"] == "http":
+        return f"http  {r['method']} {r['target']}" + (f"  body: {r['body']}" if r["body"] else "")
+    if r["kind"] == "scan":
+        return f"scan  ch{r['channel']:<2d} {r['rssi']:4d} dBm auth={r['auth']} {r['ssid']!r}"
+    if r["kind"] == "scan_done":
+        return f"scan  ch{r['channel']:<2d} done, {r['found']} found"
+    if r["kind"] == "config":
+        return f"config {r['key']}={r['value']}"
+    return f"kind {r['kind']}"
+
+
+def cmd_fetch(args):
+    conn = http.client.HTTPConnection(args.host, 80, timeout=15)
+    path = "/trace?clear=1" if args.clear else "/trace"
+    conn.request("GET", path, headers={"Authorization": "Bearer " + args.token, "Connection": "close"})
+    resp = conn.getresponse()
+    data = resp.read()
+    if resp.status != 200:
+        sys.exit(f"GET /trace: {resp.status} {data.decode(errors='replace')}")
+    with open(args.output, "wb") as f:
+        f.write(data)
+    info, records = parse(data)
+    print(f"{args.output}: {len(data)} bytes, {len(records)} records, {info['dropped']} dropped")
+
+
+def cmd_show(args):
+    with open(args.trace, "rb") as f:
+        info, records = parse(f.read())
+    if args.json:
+        print(json.dumps(info))
+        for r in records:
+            print(json.dumps(r))
+        return
+    fails = "" if info["boot_fails"] is None else f" after {info['boot_fails']} failed boots, at {info['start_ms']} ms"
+    print(f"boot: reset={info['reset']} plan={info['plan']}{fails}  {len(records)} records, {info['dropped']} dropped")
+    for r in records:
+        print(f"{r['ms']:10d} ms  {describe(r)}")
+
+
+def cmd_replay(args):
+    with open(args.trace, "rb") as f:
+        _, records = parse(f.read())
+    requests = [r for r in records if r["kind"] == "http" and not r["target"].startswith(NEVER_REPLAYED)]
+    if not requests:
+        print("no requests to replay")
+        return
+    conn = http.client.HTTPConnection(args.host, 80, timeout=15)
+    origin_ms = requests[0]["ms"]
+    start = time.perf_counter()
+    for r in requests:
+        # virtual clock: the recorded offset, divided by --speed
+        due = start + (r["ms"] - origin_ms) / 1000.0 / args.speed
+        delay = due - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        headers = {"Content-Type": "application/x-www-form-urlencoded"} if r["body"] else {}
+        if args.token:
+            headers["Authorization"] = "Bearer " + args.token
+        sent = time.perf_counter()
+        try:
+            conn.request(r["method"], r["target"], body=r["body"] or None, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+        except (http.client.HTTPException, ConnectionError):
+            conn.close()
+            conn.request(r["method"], r["target"], body=r["body"] or None, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+        late = (sent - due) * 1000.0
+        print(f"{r['ms'] - origin_ms:10d} ms  {resp.status}  {r['method']} {r['target']}  (sent {late:+.1f} ms)")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("fetch", help="download GET /trace")
+    p.add_argument("--host", required=True)
+    p.add_argument("--token", required=True, help="config token, printed on Serial at boot")
+    p.add_argument("-o", "--output", default="trace.bin")
+    p.add_argument("--clear", action="store_true", help="start a new trace on the device afterwards")
+    p.set_defaults(fn=cmd_fetch)
+
+    p = sub.add_parser("show", help="print a trace as a timeline")
+    p.add_argument("trace")
+    p.add_argument("--json", action="store_true")
+    p.set_defaults(fn=cmd_show)
+
+    p = sub.add_parser("replay", help="send a trace's HTTP requests on the recorded clock")
+    p.add_argument("trace")
+    p.add_argument("--host", required=True)
+    p.add_argument("--token", help="config token, for the requests that need it")
+    p.add_argument("--speed", type=float, default=1.0, help="clock multiplier, 2 = twice as fast")
+    p.set_defaults(fn=cmd_replay)
+
+    args = ap.parse_args()
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()